@@ -0,0 +1,161 @@
+import csv
+import io
+import logging
+import os
+import threading
+import time
+from collections import deque
+import numpy as np
+import cv2
+from frame_archive import FrameArchiveWriter
+
+
+class AsyncLogger(threading.Thread):
+    """
+    Writes the csv rows and images of the evaluated frames on a background thread, so the control loop does not wait
+    for the SD card.
+
+    The rows are appended to the csv file in batches (one open per batch). The images are queued until they are
+    encoded and written; the queue is bounded: when it is full the image of a row is skipped (and counted in
+    dropped_images) instead of stalling the control loop. A batch of rows that can not be written (eg. a full SD card)
+    is kept and written again after retry_delay seconds; it is only dropped (and counted in dropped_rows) when it still
+    fails after max_retries retries, so a broken card can not stall flush() and close() forever. The first error is
+    logged through the logging module, later ones are counted in errors.
+
+    With the 'archive' image format the images are appended to one raw frame archive next to the csv file (the csv
+    path with a .wva extension) together with their metadata, instead of one file per image.
+    """
+    IMAGE_FORMATS = ('png', 'raw', 'archive')
+
+    def __init__(self, logfile, image_dir='images', image_format='png', max_pending_images=8, png_compression=1,
+                 max_retries=3, retry_delay=1.0):
+        """
+        Args:
+            logfile: csv file path, the rows are appended
+            image_dir: folder for the images, named by the timestamp of their row
+            image_format: 'png', 'raw' (numpy .npy file, no encoding at all) or 'archive' (raw frame archive, see
+                          frame_archive.py)
+            max_pending_images: maximum number of images that wait to be written
+            png_compression: zlib level of the png images (0-9), 1 is fast and still about as small as the default
+            max_retries: number of times a batch of rows that could not be written is tried again
+            retry_delay: seconds between the tries
+        """
+        super().__init__(daemon=True)
+        if image_format not in self.IMAGE_FORMATS:
+            raise ValueError("image_format must be one of {}".format(self.IMAGE_FORMATS))
+        self.logfile = logfile
+        self.image_dir = image_dir
+        self.image_format = image_format
+        self.max_pending_images = max_pending_images
+        self.png_compression = png_compression
+        self.archive_path = os.path.splitext(logfile)[0] + '.wva'
+        self.archive = None  # created with the size of the first image
+        self.max_retries = max_retries
+        self.retry_delay = retry_delay
+        self.dropped_images = 0
+        self.dropped_rows = 0
+        self.errors = 0
+        self.condition = threading.Condition()
+        self.rows = deque()
+        self.images = deque()
+        self.busy = False  # a batch is being written
+        self.stopped = False
+        self.start()
+
+    def log(self, row, timestamp, img=None, meta=None):
+        """ Queue a csv row and the image of its frame, never blocks
+
+        Args:
+            row: list of csv values
+            timestamp: timestamp string of the row, used as image file name
+            img: 2d grayscale matrix or None. It is copied, so the frame (eg. a frame ring slot) is not held while it
+                 waits to be written.
+            meta: keyword arguments of FrameArchiveWriter.write() besides the image (timestamp, setpoint, target,
+                  offset, offset_mm, passed), only used by the 'archive' image format
+        """
+        with self.condition:
+            self.rows.append(row)
+            if img is not None:
+                if len(self.images) < self.max_pending_images:
+                    self.images.append((timestamp, np.array(img, copy=True), meta))
+                else:
+                    self.dropped_images += 1
+            self.condition.notify_all()
+
+    def flush(self):
+        """ Wait until everything that was queued is written """
+        with self.condition:
+            while self.rows or self.images or self.busy:
+                self.condition.wait()
+
+    def close(self):
+        """ Write everything that was queued and stop the thread """
+        with self.condition:
+            self.stopped = True
+            self.condition.notify_all()
+        self.join()
+        if self.archive is not None:
+            self.archive.close()
+
+    def run(self):
+        failures = 0  # failed tries of the oldest rows
+        while True:
+            with self.condition:
+                while not self.rows and not self.images and not self.stopped:
+                    self.condition.wait()
+                if not self.rows and not self.images:
+                    return
+                rows = list(self.rows)
+                self.rows.clear()
+                image = self.images.popleft() if self.images else None
+                self.busy = True
+            # rows first, then one image so new rows are not held back by a queue of images
+            # a full SD card must not stop the controller, so the errors are only reported
+            if rows:
+                try:
+                    # one write for the batch, so a failed try does not leave half of it in the file
+                    text = io.StringIO()
+                    csv.writer(text, delimiter=',').writerows(rows)
+                    with open(self.logfile, 'a+') as f:
+                        f.write(text.getvalue())
+                    failures = 0
+                except Exception as e:
+                    self.report_error('csv rows', e)
+                    failures += 1
+                    if failures <= self.max_retries:
+                        with self.condition:
+                            self.rows.extendleft(reversed(rows))
+                        time.sleep(self.retry_delay)
+                    else:
+                        self.dropped_rows += len(rows)
+                        logging.getLogger(__name__).warning("dropped %d csv rows after %d retries", len(rows),
+                                                            self.max_retries)
+                        failures = 0
+            if image is not None:
+                try:
+                    self.write_image(*image)
+                except Exception as e:
+                    self.report_error('image', e)
+                    self.dropped_images += 1
+            with self.condition:
+                self.busy = False
+                self.condition.notify_all()
+
+    def report_error(self, what, error):
+        self.errors += 1
+        if self.errors == 1:
+            logging.getLogger(__name__).error("could not write the %s to %s: %s", what, self.logfile, error,
+                                              exc_info=error)
+
+    def write_image(self, timestamp, img, meta=None):
+        if self.image_format == 'archive':
+            if self.archive is None:
+                self.archive = FrameArchiveWriter(self.archive_path, img.shape[1], img.shape[0])
+            self.archive.write(img, **(meta or {'timestamp': 0}))
+            self.archive.flush()
+            return
+        path = os.path.join(self.image_dir, timestamp)
+        if self.image_format == 'png':
+            cv2.imwrite(path + '.png', img, [cv2.IMWRITE_PNG_COMPRESSION, self.png_compression])
+        else:
+            np.save(path + '.npy', img)
@@ -1,20 +1,48 @@
+import io
 import numpy as np
 from PyQt5.QtCore import QThread, pyqtSignal, pyqtSlot
 from picamera import PiCamera
 from picamera.array import PiRGBArray
 import time
+import wormvision
+
+
+class PiYPlaneArray(io.BytesIO):
+    """ Output for raw yuv420 captures, array is the grayscale Y plane without any conversion.
+    picamera pads the rows to a multiple of 32 pixels and the Y plane to a multiple of 16 rows, array is a
+    rows x cols view of a snapshot of the capture (wormvision reads the padded rows directly).
+    """
+    def __init__(self, size):
+        super().__init__()
+        self.size = size
+
+    def truncate(self, size=None):
+        # also rewind so the next capture overwrites the buffer
+        size = super().truncate(size)
+        self.seek(size)
+        return size
+
+    @property
+    def array(self):
+        cols, rows = self.size
+        stride = (cols + 31) & ~31
+        height = (rows + 15) & ~15
+        return np.frombuffer(self.getvalue(), np.uint8, stride * height).reshape(height, stride)[:rows, :cols]
+
 
 
 class PiVideoStream(QThread):
     sig_msg = pyqtSignal(str)  # logging message signal
     ready = pyqtSignal(np.ndarray)  # image signal as numpy array
+    RING_SLOTS = 4  # frame ring slots: written, newest, evaluated by the controller and one spare
     def __init__(self, resolution=(640, 480), framerate=24, imgformat='bgr', effect='none', use_video_port=False):
         """
 
         Args:
             resolution: frame resolution
             framerate: frames per second
-            imgformat: image format (defaults to bgr for opencv compatibility)
+            imgformat: image format (defaults to bgr for opencv compatibility), 'yuv' emits the grayscale Y plane of
+                       raw yuv captures, see PiYPlaneArray
             effect: camera effect
             use_video_port: ???
         """
@@ -23,6 +51,8 @@ class PiVideoStream(QThread):
         self.frame = None
         self.rawCapture = None
         self.stream = None
+        self.ring = None  # grayscale frames for the controller, see wormvision.FrameRing
+        self.ring_format = None
         self.init_camera(resolution, framerate, imgformat, effect, use_video_port)
         self.pause = False
         self.sig_msg.emit(self.__class__.__name__ + ": opened.")
@@ -39,6 +69,8 @@ class PiVideoStream(QThread):
                     break   # return from thread is needed
                 else:
                     self.frame = f.array  # grab the frame from the stream
+                    # converted to grayscale straight into a free ring slot, the controller takes the newest frame
+                    self.ring.push(self.frame, self.ring_format)
                     self.ready.emit(self.frame)
         except Exception as err:
             self.sig_msg.emit(self.__class__.__name__ + ": error running thread. " + str(err))
@@ -51,8 +83,14 @@ class PiVideoStream(QThread):
         self.camera.image_effect = effect
         self.camera.iso = 60
         self.camera.framerate = framerate
-        self.rawCapture = PiRGBArray(self.camera, size=self.camera.resolution)
+        if imgformat == 'yuv':
+            self.rawCapture = PiYPlaneArray(self.camera.resolution)
+        else:
+            self.rawCapture = PiRGBArray(self.camera, size=self.camera.resolution)
         self.stream = self.camera.capture_continuous(self.rawCapture, imgformat, use_video_port)
+        # a new ring per resolution, frames of the old ring stay valid until they are released
+        self.ring = wormvision.FrameRing(resolution[0], resolution[1], self.RING_SLOTS)
+        self.ring_format = 'gray' if imgformat == 'yuv' else imgformat
         self.frame = None
         time.sleep(2)
 
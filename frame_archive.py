@@ -0,0 +1,81 @@
+import os
+import struct
+import numpy as np
+
+# File layout of wormvision c extension/framearchive.h, little endian
+MAGIC = 0x41465657  # "WVFA"
+VERSION = 1
+HEADER_SIZE = 64
+META_SIZE = 64
+ALIGN = 64
+IMGTYPE_BASIC = 0  # eImageType of the grayscale frames
+HEADER = struct.Struct('<IIiiiII36x')
+META = struct.Struct('<dffiiffffI20x')
+
+
+class FrameArchiveWriter:
+    """
+    Appends the frames of a run to a raw frame archive: one header with the frame size, then one fixed size record
+    per frame with its metadata (timestamp, setpoint, target, offsets) and the raw pixels. Nothing is encoded, so
+    writing a frame costs about as much as copying it, and the archive is read back without a copy through a memory
+    map (wormvision.FrameArchive, parselogs.load_frames() and the benchmark).
+
+    An existing archive is appended to if its frames have the same size. A partly written record at its end (eg. the
+    controller was powered off) is overwritten by the next record, so the records stay aligned. The file is never
+    truncated: a reader (wormvision.FrameArchive) that has it mapped would crash on a read of the cut off tail.
+    """
+
+    def __init__(self, path, cols, rows):
+        """
+        Args:
+            path: archive file path, created if it does not exist
+            cols: frame width in pixels
+            rows: frame height in pixels
+        """
+        self.path = path
+        self.cols = cols
+        self.rows = rows
+        self.frame_size = cols * rows
+        self.record_size = (META_SIZE + self.frame_size + ALIGN - 1) // ALIGN * ALIGN
+        self.padding = bytes(self.record_size - META_SIZE - self.frame_size)
+        size = os.path.getsize(path) if os.path.exists(path) else 0
+        if size >= HEADER_SIZE:
+            with open(path, 'rb') as f:
+                header = HEADER.unpack(f.read(HEADER.size))
+            if header != (MAGIC, VERSION, cols, rows, IMGTYPE_BASIC, self.frame_size, self.record_size):
+                raise ValueError("{} is not an archive of {}x{} frames".format(path, cols, rows))
+            self.file = open(path, 'r+b')
+            self.file.seek(HEADER_SIZE + (size - HEADER_SIZE) // self.record_size * self.record_size)
+        else:
+            self.file = open(path, 'wb')
+            self.file.write(HEADER.pack(MAGIC, VERSION, cols, rows, IMGTYPE_BASIC, self.frame_size,
+                                        self.record_size))
+        self.nof_frames = (self.file.tell() - HEADER_SIZE) // self.record_size
+
+    def write(self, img, timestamp, setpoint=(0, 0), target=(0, 0), offset=(0, 0), offset_mm=(0, 0), passed=False):
+        """ Append a frame and its metadata
+
+        Args:
+            img: 2d grayscale matrix of the archive's size
+            timestamp: seconds since the epoch
+            setpoint: (x, y) setpoint in mm
+            target: (x, y) target in pixel coordinates
+            offset: (x, y) total weighted offset in pixels
+            offset_mm: (x, y) total weighted offset in mm
+            passed: True if the offset was within the maximum offset
+        """
+        img = np.asarray(img)
+        if img.shape != (self.rows, self.cols):
+            raise ValueError("frame size {} does not match the archive ({}, {})".format(img.shape, self.rows,
+                                                                                      self.cols))
+        # one write per record, so a power failure leaves at most one partial record
+        self.file.write(META.pack(timestamp, setpoint[0], setpoint[1], int(target[0]), int(target[1]), offset[0],
+                                  offset[1], offset_mm[0], offset_mm[1], 1 if passed else 0)
+                        + np.ascontiguousarray(img, dtype=np.uint8).tobytes() + self.padding)
+        self.nof_frames += 1
+
+    def flush(self):
+        self.file.flush()
+
+    def close(self):
+        self.file.close()
@@ -1,7 +1,12 @@
 import time
+import threading
 from PyQt5.QtCore import QObject, pyqtSignal, pyqtSlot
 import pigpio
 
+# The waves of the ramps are global to the pigpio daemon (wave_clear deletes all of them), so the ramps of motors that
+# move at the same time are generated one by one. The constant speed part of the moves (PWM) overlaps.
+_wave_lock = threading.Lock()
+
 
 class Stepper(QObject):
     # A4988 Stepper Motor Driver Carriers
@@ -154,6 +159,10 @@ class Stepper(QObject):
         """Generate ramp wave forms.
         ramp:  List of [Frequency, Steps]
         """
+        with _wave_lock:
+            self._generate_ramp(ramp)
+
+    def _generate_ramp(self, ramp):
         self.pio.wave_clear()  # clear existing waves
         length = len(ramp)  # number of ramp levels
         wid = [-1] * length
@@ -29,6 +29,7 @@ class Headers(Enum):
 
 class WPCLogParser():
     def __init__(self, logfile):
+        self.logfile = logfile
         # Load log contents
         with open(logfile, 'r') as f:
             r = csv.reader(f, delimiter=',')
@@ -227,6 +228,68 @@ class WPCLogParser():
                 well_counter += 1
 
 
+    def load_frames(self, image_dir='images'):
+        """Load the logged images of the rows (png or npy, see AsyncLogger) as one frames x rows x cols array.
+        Rows without an image are skipped. If the log has a raw frame archive (the 'archive' image format) the frames
+        are read from it instead, see load_archive.
+
+        Returns: (row indices, frames) tuple"""
+        if os.path.isfile(os.path.splitext(self.logfile)[0] + '.wva'):
+            return self.load_archive()
+        indices = []
+        frames = []
+        for i, row in enumerate(self.log_rows):
+            path = os.path.join(image_dir, row[self.std_col_map[Headers.TIMESTAMP]].strftime(TIMESTAMPFORMAT))
+            if os.path.isfile(path + '.npy'):
+                frames.append(np.load(path + '.npy'))
+            elif os.path.isfile(path + '.png'):
+                frames.append(imageio.imread(path + '.png'))
+            else:
+                continue
+            indices.append(i)
+        if not frames:
+            return indices, np.empty((0, 0, 0), dtype=np.uint8)
+        return indices, np.stack(frames)
+
+    def load_archive(self, path=None):
+        """Map the raw frame archive of the log (the csv path with a .wva extension by default) without copying the
+        frames. The records are matched to the rows in order by their timestamp, so rows of which the image was
+        dropped are skipped.
+
+        Returns: (row indices, frames) tuple, frames is a read only frames x rows x cols view of the archive that is
+                 also accepted by wormvision.evaluate_batch directly"""
+        import wormvision
+        archive = wormvision.FrameArchive(path or os.path.splitext(self.logfile)[0] + '.wva')
+        indices = []
+        record = 0
+        for i, row in enumerate(self.log_rows):
+            if record == len(archive):
+                break
+            timestamp = datetime.fromtimestamp(archive.meta(record)[0]).strftime(TIMESTAMPFORMAT)
+            if timestamp == row[self.std_col_map[Headers.TIMESTAMP]].strftime(TIMESTAMPFORMAT):
+                indices.append(i)
+                record += 1
+        return indices, np.asarray(archive)[:len(indices)]
+
+    def sweep_parameters(self, evaluator, thresholds=None, gammas=None, area_thresholds=None, image_dir='images'):
+        """Evaluate the logged images again with every combination of the given parameter values, see
+        WellBottomFeaturesEvaluator.evaluate_batch. The rows are evaluated with their own target.
+
+        Returns: (row indices, offsets, found) tuple, offsets and found have the shapes of evaluate_batch with one
+                 frame for each row index"""
+        indices, frames = self.load_frames(image_dir)
+        shape = tuple(1 if values is None else len(values) for values in (thresholds, gammas, area_thresholds))
+        offsets = np.zeros(shape + (len(indices), 2), dtype=np.int32)
+        found = np.zeros(shape + (len(indices),), dtype=bool)
+        targets = [tuple(self.log_rows[i][self.std_col_map[Headers.TARGET]]) for i in indices]
+        for target in set(targets):
+            selected = [j for j, t in enumerate(targets) if t == target]
+            o, f = evaluator.evaluate_batch(frames[selected], target, thresholds, gammas, area_thresholds)
+            offsets[..., selected, :] = o
+            found[..., selected] = f
+        return indices, offsets, found
+
+
 def generate_mp4(image_dir, output_filename, fps=12):
     """Used to convert the images outputted by rename_correct_image to a mp4
     output_filename should end in .mp4"""
@@ -51,13 +51,22 @@ MAX_ALLOWED_ERROR_MM = (0.2, 0.2)
 
 # enable logging data to csv file
 ENABLE_LOGGING = True
+# logged image format: 'png', 'raw' (numpy .npy files, no encoding) or 'archive' (one raw frame archive per log file)
+LOG_IMAGE_FORMAT = 'png'
 
 # enables using _offsets setpoint files
 ENABLE_OFFSETS = False
 
-# global reference to motor classes, to stop them after a sigint
+# move the x and y motors at the same time
+ENABLE_PIPELINED_MOTION = True
+
+# search the well near its expected position in the correction iterations after the first one
+ENABLE_TRACKING = True
+
+# global reference to motor classes and the controller, to stop them after a sigint
 motor_x = None
 motor_y = None
+wpc = None
 
 # SETPOINTS_FILE = "setpoints/debug_mode_test.csv"
 SETPOINTS_FILE = "setpoints/48.csv"
@@ -70,6 +79,8 @@ def catch_sigint(sig, frame):
     print("stopping motors and quitting")
     motor_x.stop()
     motor_y.stop()
+    if wpc is not None and wpc.logger is not None:
+        wpc.logger.close()  # write the queued log rows and images
     sys.exit(0)
 
 
@@ -108,7 +119,10 @@ if __name__ == '__main__':
                                  logging=ENABLE_LOGGING,
                                  debug_mode_max_error_mm=DEBUG_MODE_MAX_ERROR_MM,
                                  debug_mode_min_error_mm=DEBUG_MODE_MIN_ERROR_MM,
-                                 enable_offsets=ENABLE_OFFSETS)
+                                 enable_offsets=ENABLE_OFFSETS,
+                                 pipelined=ENABLE_PIPELINED_MOTION,
+                                 log_image_format=LOG_IMAGE_FORMAT,
+                                 tracking=ENABLE_TRACKING)
 
     wpc.start()
 
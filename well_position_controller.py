@@ -3,9 +3,12 @@ import csv
 import os
 from time import sleep
 from datetime import datetime
-from PyQt5.QtCore import QThread, pyqtSlot, pyqtSignal
+from PyQt5.QtCore import QThread, pyqtSignal
 import cv2
+import wormvision
 from random import randint
+from concurrent.futures import ThreadPoolExecutor
+from async_logger import AsyncLogger
 
 
 class WellPositionController(QThread):
@@ -22,7 +25,8 @@ class WellPositionController(QThread):
     
     def __init__(self, setpoints_csv, max_offset_mm, motor_x, motor_y, mm_per_pixel, pio, vs, *evaluators,
                  target_coordinates=None, debug=False, logging=False, debug_mode_max_error_mm=5,
-                 debug_mode_min_error_mm=0, enable_offsets=True):
+                 debug_mode_min_error_mm=0, enable_offsets=True, parallel_evaluation=False, pipelined=False,
+                 log_image_format='png', tracking=False):
         """
         Args:
             setpoints_csv: csv file path that contains one x,y setpoint per column.
@@ -37,10 +41,18 @@ class WellPositionController(QThread):
             *evaluators: List of tuples, each tuple of the format (WellPositionEvaluator, score_weight)
             debug: If set to True a random error will be added to each setpoint. Max error in each direction given by DEBUG_MODE_MAX_ERROR
                    The control loop will also require user input every iteration so that image processing results may be inspected
-            logging: Set to True to log data to csv file
+            logging: Set to True to log data to csv file. The rows and images are written on a background thread,
+                     see AsyncLogger
             debug_mode_max_error_mm: The maximum random error in mm while in debug mode
             debug_mode_min_error_mm: The minimum random error in mm while in debug mode
             enable_offsets: Enable/disable reading from a _offsets.csv file to adjust setpoints pre emptively.
+            parallel_evaluation: Set to True to run the evaluators in parallel threads. The c implementation (wormvision)
+                                 and opencv release the GIL while they process a frame.
+            pipelined: Set to True to move the x and y motors at the same time.
+            log_image_format: format of the logged images, 'png', 'raw' (numpy .npy files, no encoding) or 'archive'
+                (one raw frame archive next to the csv file with the metadata of every frame, see frame_archive.py)
+            tracking: Set to True to have the evaluators that support it (tracking attribute) search the well of the
+                      previous frame near its expected position after a correction, instead of the whole frame
         """
         super().__init__()
         self.setpoints_csv_filename = setpoints_csv
@@ -52,16 +64,31 @@ class WellPositionController(QThread):
         self.motor_x = motor_x
         self.motor_y = motor_y
         self.mm_per_pixel = mm_per_pixel
-        self.camera_started = False
-        self.request_new_image = False  # Used by get_new_image and img_update to update self.img with a new frame from the pivideostream class
+        self.vs = vs  # frames are taken from the frame ring of the pivideostream class
         self.img = None  # New image frames are stored here after calling self.get_new_image
         self.debug = debug
         self.logging = logging
         self.debug_mode_max_error_um = debug_mode_max_error_mm * 1000
         self.debug_mode_min_error_um = debug_mode_min_error_mm * 1000
         self.enable_offsets = enable_offsets
-        # connect pivideostream frame emitter to the image update slot
-        vs.ready.connect(self.img_update)
+        # one worker per evaluator, an evaluator is only ever used by one worker at a time
+        self.executor = None
+        if parallel_evaluation and len(evaluators) > 1:
+            self.executor = ThreadPoolExecutor(max_workers=len(evaluators))
+        # pipelined mode: one worker per motor
+        self.motion_executor = ThreadPoolExecutor(max_workers=2) if pipelined else None
+        self.log_image_format = log_image_format
+        self.logger = None
+        # (frame ring, sequence number) of the first frame that is captured after the last move, see get_new_image
+        self.motion_end = None
+        # preprocessing results of the evaluated frame, shared by the evaluators that support it (frame_cache attribute)
+        # so early stages with the same parameters are only computed once per frame; (re)created for the frame size
+        self.frame_cache = None
+        self.frame_cache_size = None
+        if tracking:
+            for evaluator, weight in self.evaluators:
+                if hasattr(evaluator, 'tracking'):
+                    evaluator.tracking = True
 
         if self.logging:
             self.setup_log()
@@ -84,7 +111,14 @@ class WellPositionController(QThread):
             csv_headers.append('Total weighted offset (pixels)')
             csv_headers.append('Total weighted offset (mm)')
             csv_headers.append('Pass 1/Fail 0 (max offset in mm (x, y): {})'.format(self.max_offset_mm))
+            # stage timings of the evaluators that support them, after the pass column so parselogs.py still works
+            for evaluator, weight in self.evaluators:
+                if hasattr(evaluator, 'timing_stages'):
+                    evaluator.timings = {}
+                    for stage in evaluator.timing_stages + ('total',):
+                        csv_headers.append('{} {} time (ms)'.format(evaluator.__class__.__name__, stage))
             csv_writer.writerow(csv_headers)
+        self.logger = AsyncLogger(self.logfile, 'images', self.log_image_format)
 
     def load_setpoints_from_csv(self, filename):
         """Load setpoints from csv file, the setpoint format should be as generated by the script /setpoints/generate_setpoints.py
@@ -118,6 +152,45 @@ class WellPositionController(QThread):
         # calculate the average centroid
         self.target = tuple(np.average(centroids, 0, weights).astype(int))
 
+    def track_move(self, move_mm):
+        """
+        Tells the tracking evaluators where to expect the well after a correction.
+        The correction cancels the offset of the well, so the well moves by minus the move in the frame.
+
+        Args:
+            move_mm: (x, y) correction that was sent to move_motors
+        """
+        shift = tuple(int(round(-v / self.mm_per_pixel)) for v in move_mm)
+        for evaluator, weight in self.evaluators:
+            if hasattr(evaluator, 'track_move'):
+                evaluator.track_move(shift)
+
+    def track_reset(self):
+        """
+        Makes the tracking evaluators search the whole frame again, eg. after moving to the next well
+        """
+        for evaluator, weight in self.evaluators:
+            if hasattr(evaluator, 'track_reset'):
+                evaluator.track_reset()
+
+    def update_frame_cache(self, img):
+        """
+        Invalidates the shared preprocessing results for a new frame and hands the cache to the evaluators.
+
+        Args:
+            img: 2d grayscale matrix that is evaluated next
+        """
+        if len(self.evaluators) < 2:
+            return
+        size = (img.shape[1], img.shape[0])
+        if size != self.frame_cache_size:
+            self.frame_cache = wormvision.FrameCache(*size)
+            self.frame_cache_size = size
+            for evaluator, weight in self.evaluators:
+                if hasattr(evaluator, 'frame_cache'):
+                    evaluator.frame_cache = self.frame_cache
+        self.frame_cache.new_frame()
+
     def evaluate_position(self, img, setpoint):
         """
         Evaluates position based on all evaluator classes and their output weights.
@@ -131,8 +204,12 @@ class WellPositionController(QThread):
         """
         offsets = []
         weights = []
-        for evaluator, weight in self.evaluators:
-            offset = evaluator.evaluate(img, self.target)
+        self.update_frame_cache(img)
+        if self.executor is not None:
+            results = list(self.executor.map(lambda e: e[0].evaluate(img, self.target), self.evaluators))
+        else:
+            results = [evaluator.evaluate(img, self.target) for evaluator, weight in self.evaluators]
+        for (evaluator, weight), offset in zip(self.evaluators, results):
             if offset is not None:
                 offsets.append(offset)
                 weights.append(weight)
@@ -146,66 +223,65 @@ class WellPositionController(QThread):
             result = offset_mm
 
         if self.logging:
-            # Log data to csv
-            with open(self.logfile, 'a+') as f:
-                csv_writer = csv.writer(f, delimiter=',')
-                csv_data = []
-                timestamp = datetime.now().strftime('%Y%m%d%H%M%S')
-                csv_data.append(timestamp)  # Timestamp
-                csv_data.append(self.target)  # Target (pixel coordinates)
-                csv_data.append(setpoint)  # Setpoint (mm)
-                for i in range(len(self.evaluators)):
-                    # Write offset x and offset y in pixels and mm for each evaluator
-                    csv_data.append(offsets[i][0])
-                    csv_data.append(offsets[i][1])
-                    csv_data.append("{0:.5f}".format(offsets[i][0] * self.mm_per_pixel))
-                    csv_data.append("{0:.5f}".format(offsets[i][1] * self.mm_per_pixel))
-                csv_data.append(offset)  # Total weighted offset in pixels
-                csv_data.append("({0:.5f}, {0:.5f})".format(offset_mm[0], offset_mm[1]))  # Total weighted offset in mm
-                if result is True:
-                    csv_data.append(1)  # 1 = Pass, 0 = Fail
-                else:
-                    csv_data.append(0)
-                csv_writer.writerow(csv_data)
-                # Save image with the timestamp corresponding to the current row in the csv.
-                cv2.imwrite('images/{}.png'.format(timestamp), img)
+            # Log data to csv, the row and image are written on the logger thread
+            csv_data = []
+            now = datetime.now()
+            timestamp = now.strftime('%Y%m%d%H%M%S')
+            csv_data.append(timestamp)  # Timestamp
+            csv_data.append(self.target)  # Target (pixel coordinates)
+            csv_data.append(setpoint)  # Setpoint (mm)
+            for i in range(len(self.evaluators)):
+                # Write offset x and offset y in pixels and mm for each evaluator
+                csv_data.append(offsets[i][0])
+                csv_data.append(offsets[i][1])
+                csv_data.append("{0:.5f}".format(offsets[i][0] * self.mm_per_pixel))
+                csv_data.append("{0:.5f}".format(offsets[i][1] * self.mm_per_pixel))
+            csv_data.append(offset)  # Total weighted offset in pixels
+            csv_data.append("({0:.5f}, {0:.5f})".format(offset_mm[0], offset_mm[1]))  # Total weighted offset in mm
+            if result is True:
+                csv_data.append(1)  # 1 = Pass, 0 = Fail
+            else:
+                csv_data.append(0)
+            for evaluator, weight in self.evaluators:
+                if hasattr(evaluator, 'timing_stages'):
+                    for stage in evaluator.timing_stages + ('total',):
+                        csv_data.append("{0:.3f}".format(evaluator.timings.get(stage, 0)))
+            # Save image with the timestamp corresponding to the current row in the csv.
+            meta = {'timestamp': now.timestamp(), 'setpoint': setpoint, 'target': self.target, 'offset': offset,
+                    'offset_mm': offset_mm, 'passed': result is True}
+            self.logger.log(csv_data, timestamp, img, meta)
 
         return result
 
-    @pyqtSlot(np.ndarray)
-    def img_update(self, image=None):
-        """ Store the latest image frame from PiVideoStream in self.img
-        Only overwrite self.img if a new frame has been requested by calling get_new_image
+    def get_new_image(self, timeout=1.0):
+        """ Store a grayscale frame that is captured after this call in self.img, or the first frame that is captured
+        after the last move of the motors ended if that is older (so a frame is only taken while the motors stand
+        still, without waiting longer than needed)
+        The frame is read in place from its slot in the frame ring of PiVideoStream (the camera keeps capturing into
+        the other slots), the slot is released when self.img is replaced.
 
         Args:
-            image: bgr image matrix (opencv compatible)
+            timeout: seconds to wait for the frame
+        Returns:
+            True on success, None if no frame arrived in time (the camera is not yet started)
         """
-        self.camera_started = True
-        try:
-            if not self.request_new_image:
-                self.sig_msg.emit(self.__class__.__name__ + ": no new image needed, frame dropped.")
-            else:
-                self.img = image.copy()
-                # convert to grayscale
-                self.img = cv2.cvtColor(self.img, cv2.COLOR_BGR2GRAY)
-                self.request_new_image = False
-        except Exception as err:
-            self.sig_msg.emit(self.__class__.__name__, ": exception in img_update " + str(err))
-
-    def get_new_image(self):
-        if not self.camera_started:
-            # Return None if the camera is not yet started -> cannot obtain a new frame yet
-            return None
+        # release the slot of the previous frame
         self.img = None
-        # Request new image frame from PiVideoStream
-        self.request_new_image = True
-        while self.request_new_image:
-            # Wait for new image frame
-            sleep(0.01)
+        ring = self.vs.ring
+        if self.motion_end is not None and self.motion_end[0] is ring:
+            after = self.motion_end[1]
+        else:
+            after = ring.seq()
+        frame = ring.latest(after, timeout)
+        if frame is None:
+            return None
+        self.motion_end = None
+        self.img = np.asarray(frame)
         return True  # Return True on success
 
     def move_motors(self, delta_x_mm, delta_y_mm):
-        """Move the well plate in two dimensions.
+        """Move the well plate in two dimensions. Blocks until the movement is completed.
+        In pipelined mode both motors move at the same time.
 
         Args:
             delta_x_mm: delta x given in mm, negative number moves counterclockwise
@@ -220,9 +296,18 @@ class WellPositionController(QThread):
             clockwise_y = True
         else:
             clockwise_y = False
-        # Move motors 1 by 1
-        self.motor_x.go_once(mm=abs(delta_x_mm), clockwise=clockwise_x)
-        self.motor_y.go_once(mm=abs(delta_y_mm), clockwise=clockwise_y)
+        if self.motion_executor is None:
+            # Move motors 1 by 1
+            self.motor_x.go_once(mm=abs(delta_x_mm), clockwise=clockwise_x)
+            self.motor_y.go_once(mm=abs(delta_y_mm), clockwise=clockwise_y)
+        else:
+            moves = [self.motion_executor.submit(self.motor_x.go_once, mm=abs(delta_x_mm), clockwise=clockwise_x),
+                     self.motion_executor.submit(self.motor_y.go_once, mm=abs(delta_y_mm), clockwise=clockwise_y)]
+            for move in moves:
+                move.result()  # raises the exception of a failed move
+        # the frame that is being captured now started during the move, take the next one
+        ring = self.vs.ring
+        self.motion_end = (ring, ring.seq() + 1)
 
     def control_loop(self):
         """
@@ -287,6 +372,7 @@ class WellPositionController(QThread):
 
             total_error = [0, 0]  # Keep track of the total error so that we can save the new offset for the next run
             passed = False
+            self.track_reset()
             while not passed:
                 # Use camera feedback to improve position until it passes
                 # Get new image frame
@@ -305,7 +391,14 @@ class WellPositionController(QThread):
                     total_error = list(np.add(total_error, result))
                     # basically feedforward by result[0] in x and result[1] in y directions
                     self.move_motors(result[0], result[1])
+                    # the next frame shows the same well, moved by the correction
+                    self.track_move(result)
 
+        # wait for the log of the last frame
+        if self.logger is not None:
+            self.logger.flush()
+            if self.logger.dropped_images:
+                print("{} images were not logged, the log queue was full".format(self.logger.dropped_images))
         # write new offsets to _offsets.csv file (unless in debug mode)
         if not self.debug and self.enable_offsets:
             with open(offsets_csv_path, 'w') as f:
@@ -70,14 +70,31 @@ class HoughTransformEvaluator(WellPositionEvaluator):
         self.min_distance *= self.img_width / 410
         self.param1 = 25  # = higher threshold passed to canny, lower threshold is half of this
         self.param2 = 50  # = accumulator threshold -> smaller might result in more (and smaller) circles
+        self.blur_separable = True  # separable fixed point blur in the c implementation
+
+        # wormvision.FrameCache of the current frame, the c implementation shares the blur, stretch and gamma with the
+        # other evaluators of the frame that use the same parameters, None turns sharing off
+        self.frame_cache = None
 
     def evaluate(self, img, target):
         """ Finds the position error by using the Hough transform function in opencv
+        If self.debug = False, the c library is used instead of opencv
 
         Args:
             img: 2d grayscale image list
             target: target coordinates (topleft pixel is 0,0)
         """
+        if not self.debug:
+            # use custom vision library, same cv2.HOUGH_GRADIENT method
+            data = np.asarray(img, dtype=np.uint8)
+            if data.ndim != 2 or data.strides[1] != 1:
+                data = np.ascontiguousarray(data)
+            return wormvision.HT_evaluate(data, data.shape[1], data.shape[0], tuple(target),
+                                          int(self.blur_kernelsize[0]) | 1, self.blur_sigma, self.c, self.gamma,
+                                          int(self.min_radius), int(self.max_radius), int(self.min_distance),
+                                          self.param1, self.param2, separable=self.blur_separable,
+                                          cache=self.frame_cache)
+
         if self.debug:
             # make a copy when debug mode is on, so that we can overlay the results on the original image
             original = img.copy()
@@ -145,6 +162,7 @@ class WellBottomFeaturesEvaluator(WellPositionEvaluator):
         # blur
         self.blur_kernelsize = (25, 25)  # Has to be a square (for c implementation)
         self.blur_sigma = 1
+        self.blur_separable = True  # separable fixed point blur in the c implementation, within +-1 of the 2D blur
 
         # manual threshold
         self.threshold = 20
@@ -156,8 +174,36 @@ class WellBottomFeaturesEvaluator(WellPositionEvaluator):
         # morphology
         self.open_kernelsize = (10, 10)  # Has to be a square (for c implementation)
         self.close_kernelsize = (10, 10)
+        # apply the elliptical opening with close_kernelsize after the threshold in the c implementation as well
+        # (close_kernelsize has to be a square for this), the opencv implementation always applies it
+        self.c_open = False
         # classification
         self.area_threshold = 5000
+
+        # region of interest: only the part of the frame within this many pixels of the target is evaluated by the c
+        # implementation, None evaluates the whole frame
+        self.search_radius = None
+
+        # coarse to fine search in the c implementation: the blobs are searched in the frame downsampled this many
+        # times (0 to 2) and only a window around each candidate is evaluated at full resolution, 0 turns it off
+        self.pyramid_levels = 0
+
+        # tracking in the c implementation: the blob of the previous frame is searched near its expected position
+        # (see track_move) first, the whole frame is only searched if it is not found there
+        self.tracking = False
+
+        # per stage timing of the c implementation: set to a dict to have evaluate store the time in ms of each
+        # stage in wormvision.WBFE_STAGES (and "total") of the last evaluated frame in it, None turns timing off
+        self.timings = None
+        self.timing_stages = wormvision.WBFE_STAGES
+
+        # wormvision.FrameCache of the current frame, the c implementation shares the blur with the other evaluators
+        # of the frame that use the same blur parameters, None turns sharing off
+        self.frame_cache = None
+
+        # c library evaluator, (re)created by get_c_evaluator when the resolution or parameters change
+        self.c_evaluator = None
+        self.c_evaluator_key = None
         
         if qtui is not None:
             # Set up signal-slot connections
@@ -167,6 +213,72 @@ class WellBottomFeaturesEvaluator(WellPositionEvaluator):
             self.update_scores.connect(qtui.update_scores)
             self.update_result.connect(qtui.update_result)
 
+    def get_c_evaluator(self, cols, rows):
+        """ Returns the wormvision.Evaluator for the given resolution and the current parameters.
+        A new evaluator is only created when the resolution or one of the parameters changed since the last call,
+        so the working images, gaussian kernel and gamma look up table are reused between frames.
+
+        Args:
+            cols: image width
+            rows: image height
+
+        Returns: wormvision.Evaluator instance
+        """
+        key = (cols, rows, self.blur_kernelsize[0], self.blur_sigma, self.c, self.gamma, self.threshold,
+               self.area_threshold, self.blur_separable, self.close_kernelsize[0] if self.c_open else 0,
+               self.pyramid_levels)
+        if key != self.c_evaluator_key:
+            self.c_evaluator = wormvision.Evaluator(*key)
+            self.c_evaluator_key = key
+        return self.c_evaluator
+
+    def track_move(self, shift):
+        """ Adds the expected move of the tracked blob in pixels since the last evaluation, see tracking
+
+        Args:
+            shift: (x, y) tuple of ints
+        """
+        if self.c_evaluator is not None:
+            self.c_evaluator.track_move(shift)
+
+    def track_reset(self):
+        """ Forgets the tracked blob, the next evaluation searches the whole frame """
+        if self.c_evaluator is not None:
+            self.c_evaluator.track_reset()
+
+    def evaluate_batch(self, frames, target=(0, 0), thresholds=None, gammas=None, area_thresholds=None):
+        """ Evaluates a stack of frames with every combination of the given parameter values in the c implementation,
+        eg. to tune the parameters on logged frames. The other parameters are the current ones. The frames are
+        evaluated on the wormvision thread pool and the blur of a frame is shared by all combinations.
+
+        Args:
+            frames: frames x rows x cols grayscale array, a list of 2d grayscale images of the same size, or a
+                    wormvision.FrameArchive (the frames are read from the mapped file without a copy)
+            target: target coordinates of all frames (topleft pixel is 0,0)
+            thresholds: threshold values to try, None uses self.threshold
+            gammas: gamma values to try, None uses self.gamma
+            area_thresholds: area threshold values to try, None uses self.area_threshold
+
+        Returns: (offsets, found) tuple
+                 offsets: int32 array of shape (thresholds, gammas, area_thresholds, frames, 2) with the (x, y)
+                          position errors, (0, 0) if no blob was found
+                 found: bool array of shape (thresholds, gammas, area_thresholds, frames)
+        """
+        data = np.asarray(frames, dtype=np.uint8)
+        if data.ndim != 3 or data.strides[2] != 1:
+            data = np.ascontiguousarray(data)
+        offsets, found = wormvision.evaluate_batch(data, tuple(target), self.blur_kernelsize[0], self.blur_sigma,
+                                                   self.c, self.gamma, self.threshold, self.area_threshold,
+                                                   separable=self.blur_separable,
+                                                   search_radius=self.search_radius or 0,
+                                                   open_kernelsize=self.close_kernelsize[0] if self.c_open else 0,
+                                                   pyramid_levels=self.pyramid_levels, thresholds=thresholds,
+                                                   gammas=gammas, area_thresholds=area_thresholds)
+        shape = tuple(1 if values is None else len(values) for values in (thresholds, gammas, area_thresholds))
+        shape += (data.shape[0],)
+        return (np.frombuffer(offsets, dtype=np.int32).reshape(shape + (2,)),
+                np.frombuffer(found, dtype=np.uint8).reshape(shape).astype(bool))
+
     def evaluate(self, img, target=(0, 0)):
         """ Finds the position error by finding the well bottom centroid.
         If self.debug = True, opencv is used instead of the c library
@@ -179,12 +291,16 @@ class WellBottomFeaturesEvaluator(WellPositionEvaluator):
         """
         if not self.debug:
             # use custom vision library
-            # convert img to 1d list
+            # the frame is passed through the buffer protocol, so it only has to be 8-bit data with adjacent
+            # pixels in a row, padded rows (eg. a slice of the camera buffer) are read without a copy
             cols = img.shape[1]
             rows = img.shape[0]
-            data = list(img.flat)
-            return wormvision.WBFE_evaluate(data, cols, rows, target, self.blur_kernelsize[0], self.blur_sigma, self.c, self.gamma,
-                                            self.threshold, self.area_threshold)
+            data = np.asarray(img, dtype=np.uint8)
+            if data.ndim != 2 or data.strides[1] != 1:
+                data = np.ascontiguousarray(data)
+            return self.get_c_evaluator(cols, rows).evaluate(data, tuple(target), search_radius=self.search_radius or 0,
+                                                              timings=self.timings, cache=self.frame_cache,
+                                                              track=self.tracking)
         else:
             # use opencv library and show live images
             if self.debug:
@@ -286,12 +402,15 @@ def test_wellbottomfeaturesevaluator():
         runtimes_opencv = []
 
         x = WellBottomFeaturesEvaluator((410, 308), False)
-        for _ in range(10):
-            start = timeit.default_timer()
-            print(x.evaluate(cv2.imread(imgpath, cv2.CV_8UC1), (227, 144)))
-            stop = timeit.default_timer()
-            print('Time C ({}): {}'.format(_+1, stop-start))
-            runtimes_c.append(stop - start)
+        # the c implementation evaluates the frames as one batch on the wormvision thread pool
+        frames = np.stack([cv2.imread(imgpath, cv2.CV_8UC1)] * 10)
+        start = timeit.default_timer()
+        offsets, found = x.evaluate_batch(frames, (227, 144))
+        stop = timeit.default_timer()
+        for _ in range(len(frames)):
+            print(tuple(offsets[0, 0, 0, _]) if found[0, 0, 0, _] else None)
+        print('Time C (batch of {}): {}'.format(len(frames), stop - start))
+        runtimes_c.append((stop - start) / len(frames))
 
         x.debug = True
         for _ in range(10):
@@ -0,0 +1,605 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Native benchmark of the operator library and the well bottom
+ *              features pipeline, without going through python
+ *
+ *              Every operator is run repeatedly on each image and the median
+ *              and 99th percentile latency and the throughput in megapixels
+ *              per second are reported. The binary and labeled operators run
+ *              on the thresholded image of the pipeline, so the blobs are
+ *              realistic.
+ *
+ *              build (libpng is needed to load the images):
+ *                gcc -O2 -pthread -o benchmark benchmark.c evaluators.c operators*.c threads.c morphology.c watershed.c hough.c prepcache.c framearchive.c -lpng -lm
+ *              add -DWORMVISION_NEON on a raspberry pi, see setup.py
+ *
+ *              A raw frame archive of a logged run (.wva, see framearchive.h)
+ *              is replayed instead: every frame is evaluated once by the well
+ *              bottom features pipeline with its logged target, straight from
+ *              the mapped file.
+ *
+ *              usage: ./benchmark [-n runs] [-t seconds] [-j threads] [png files, directories or archives]
+ *                -n maximum number of runs per operator (default 50)
+ *                -t time budget per operator, at least 3 runs are done (default 2)
+ *                -j threads of the neighbourhood operators (default 1)
+ *                images default to ../images
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <png.h>
+#include "operators.h"
+#include "operators_basic.h"
+#include "evaluators.h"
+#include "threads.h"
+#include "morphology.h"
+#include "watershed.h"
+#include "framearchive.h"
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+// Well bottom features parameters, see WellBottomFeaturesEvaluator in
+// well_position_evaluators.py
+#define BLUR_KERNEL_SIZE 25
+#define BLUR_SIGMA       1.0
+#define GAMMA_C          0.5f
+#define GAMMA_G          8.0f
+#define THRESHOLD        20
+#define AREA_THRESHOLD   5000
+#define OPEN_SIZE        10
+#define SPLIT_DISTANCE   5    // seed distance of splitBlobs()
+
+// Hough transform parameters, see HoughTransformEvaluator in
+// well_position_evaluators.py, the sizes are for an image width of
+// HT_COLS pixels
+#define HT_COLS          410
+#define HT_KERNEL_SIZE   25
+#define HT_BLUR_SIGMA    100.0
+#define HT_GAMMA_C       1.0f
+#define HT_GAMMA_G       5.0f
+#define HT_MIN_RADIUS    50
+#define HT_MAX_RADIUS    100
+#define HT_MIN_DISTANCE  50
+#define HT_PARAM1        25
+#define HT_PARAM2        50
+
+#define MIN_RUNS         3
+
+// Images and workspaces shared by the benchmarked operators
+typedef struct bench_data_t
+{
+    image_t *gray;      // loaded image
+    image_t *blurred;   // blurred gray image
+    pixelstats_t blur_stats;  // statistics of blurred
+    image_t *binary;    // thresholded and inverted pipeline intermediate
+    image_t *packed;    // binary as an IMGTYPE_BINARY image
+    image_t *packed_dst;  // IMGTYPE_BINARY output image
+    image_t *labels;    // int16 labels of binary
+    image_t *dst;       // basic output image
+    image_t *tmp;       // int16 image for the separable blur
+    image_t *dst16;     // int16 output image
+    image_t *kernel2d;  // float gaussian kernel
+    image_t *kernel7;   // 7x7 float gaussian kernel
+    image_t *kernel1d;  // int16 gaussian kernel
+    image_t *morph;     // 5x5 structuring element
+    image_t *ellipse;   // OPEN_SIZE x OPEN_SIZE elliptical structuring element
+    image_t *rgb;       // gray as an RGB888 image
+    image_t *half;      // gray downsampled by pyramidDown()
+    morphworkspace_t *morph_ws;  // ellipse
+    image_t *dist;      // float distance transform of binary
+    watershedworkspace_t *wshed_ws;
+    basic_pixel_t lut[256];
+    uint16_t hist[256];
+    uint32_t *queue;
+    labelworkspace_t *ws;
+    blobstats_t *stats;
+    uint32_t nof_blobs;
+    wbfe_context_t *wbfe;
+    wbfe_context_t *wbfe_separable;
+    wbfe_context_t *wbfe_pyramid;  // separable blur, two pyramid levels
+    ht_context_t *ht;   // separable blur, ht->work holds the preprocessed gray
+
+}bench_data_t;
+
+// A benchmarked operator
+// prepare is called before each run and is not timed, it can be NULL
+typedef struct bench_op_t
+{
+    const char *name;
+    void (*prepare)(bench_data_t *b);
+    void (*run)(bench_data_t *b);
+
+}bench_op_t;
+
+// ----------------------------------------------------------------------------
+// Operators
+// ----------------------------------------------------------------------------
+static void copyGrayToDst(bench_data_t *b) { copy(b->gray, b->dst); }
+static void copyBinaryToDst(bench_data_t *b) { copy(b->binary, b->dst); }
+
+static void run_copy(bench_data_t *b) { copy(b->gray, b->dst); }
+static void run_erase(bench_data_t *b) { erase(b->dst); }
+static void run_rgb888ToGray(bench_data_t *b) { rgb888ToGray(b->rgb, b->dst, 1, GRAY_BT601); }
+static void run_rotate180(bench_data_t *b) { rotate180(b->dst); }
+static void run_contrastStretch(bench_data_t *b) { contrastStretch(b->gray, b->dst, 0, 255); }
+static void run_contrastStretchFast(bench_data_t *b) { contrastStretchFast(b->gray, b->dst); }
+static void run_threshold(bench_data_t *b) { threshold(b->gray, b->dst, 0, THRESHOLD); }
+static void run_threshold2Means(bench_data_t *b) { threshold2Means(b->gray, b->dst, DARK); }
+static void run_thresholdOtsu(bench_data_t *b) { thresholdOtsu(b->gray, b->dst, DARK); }
+static void run_threshold2MeansStats(bench_data_t *b) { threshold2MeansStats(b->blurred, b->dst, DARK, &b->blur_stats); }
+static void run_thresholdOtsuStats(bench_data_t *b) { thresholdOtsuStats(b->blurred, b->dst, DARK, &b->blur_stats); }
+static void run_setSelectedToValue(bench_data_t *b) { setSelectedToValue(b->gray, b->dst, 0, 255); }
+static void run_histogram(bench_data_t *b) { histogram(b->gray, b->hist); }
+static void run_invert(bench_data_t *b) { invert(b->binary, b->dst); }
+static void run_gamma(bench_data_t *b) { gamma_evdk(b->gray, b->dst, GAMMA_C, GAMMA_G); }
+static void run_applyLUT(bench_data_t *b) { applyLUT(b->gray, b->dst, b->lut); }
+static void run_stretchLUTThreshold(bench_data_t *b) { stretchLUTThreshold(b->gray, b->dst, b->lut, THRESHOLD + 1, 255); }
+static void run_stretchLUTThresholdPacked(bench_data_t *b) { stretchLUTThreshold(b->gray, b->packed_dst, b->lut, THRESHOLD + 1, 255); }
+static void run_stretchLUTThresholdStats(bench_data_t *b)
+{
+    stretchLUTThresholdStats(b->blurred, b->dst, b->lut, THRESHOLD + 1, 255, &b->blur_stats);
+}
+static void run_median3(bench_data_t *b) { nonlinearFilter(b->gray, b->dst, MEDIAN, 3); }
+static void run_min3(bench_data_t *b) { nonlinearFilter(b->gray, b->dst, MIN, 3); }
+static void run_harmonic5(bench_data_t *b) { nonlinearFilter(b->gray, b->dst, HARMONIC, 5); }
+static void run_gaussianBlur(bench_data_t *b) { gaussianBlur(b->gray, b->dst, BLUR_KERNEL_SIZE, BLUR_SIGMA); }
+static void run_convolution(bench_data_t *b) { convolution(b->gray, b->dst, b->kernel2d); }
+static void run_convolution7(bench_data_t *b) { convolution(b->gray, b->dst, b->kernel7); }
+static void run_gaussianBlurSeparable(bench_data_t *b) { gaussianBlurSeparable(b->gray, b->dst, BLUR_KERNEL_SIZE, BLUR_SIGMA); }
+static void run_separableConvolution(bench_data_t *b) { separableConvolution(b->gray, b->dst, b->tmp, b->kernel1d); }
+static void run_pyramidDown(bench_data_t *b) { pyramidDown(b->gray, b->half, b->tmp); }
+static void run_separableConvolutionStats(bench_data_t *b)
+{
+    pixelstats_t stats;
+    separableConvolutionStats(b->gray, b->dst, b->tmp, b->kernel1d, &stats);
+}
+static void run_erode(bench_data_t *b) { morph_erode(b->binary, b->dst, b->morph); }
+static void run_dilate(bench_data_t *b) { morph_dilate(b->binary, b->dst, b->morph); }
+static void run_open(bench_data_t *b) { morph_open(b->binary, b->dst, b->morph); }
+static void run_openEllipse(bench_data_t *b) { open_basic(b->binary, b->dst, b->ellipse); }
+static void run_morphOpenFast(bench_data_t *b) { morphOpenFast(b->binary, b->dst, b->morph_ws); }
+static void run_morphOpenFastPacked(bench_data_t *b) { morphOpenFast(b->packed, b->packed_dst, b->morph_ws); }
+static void run_packBinary(bench_data_t *b) { packBinary(b->binary, b->packed_dst); }
+static void run_unpackBinary(bench_data_t *b) { unpackBinary(b->packed, b->dst); }
+static void run_thresholdPacked(bench_data_t *b) { threshold(b->gray, b->packed_dst, 0, THRESHOLD); }
+static void run_invertPacked(bench_data_t *b) { invert(b->packed, b->packed_dst); }
+static void run_sumPacked(bench_data_t *b) { sum(b->packed); }
+static void run_removeBorderBlobs(bench_data_t *b) { removeBorderBlobs(b->dst, b->dst, EIGHT); }
+static void run_fillHoles(bench_data_t *b) { fillHoles(b->binary, b->dst, EIGHT); }
+static void run_fillHolesFast(bench_data_t *b) { fillHolesFast(b->binary, b->dst, EIGHT, b->queue); }
+static void run_distanceTransform(bench_data_t *b) { distanceTransform(b->binary, b->dist, b->wshed_ws); }
+static void run_waterShed(bench_data_t *b) { waterShed(b->blurred, b->dst, EIGHT, THRESHOLD, 254); }
+static void run_waterShedFast(bench_data_t *b) { waterShedFast(b->blurred, b->labels, EIGHT, THRESHOLD, 254, b->wshed_ws); }
+static void run_splitBlobs(bench_data_t *b) { splitBlobs(b->binary, b->labels, EIGHT, SPLIT_DISTANCE, b->wshed_ws); }
+static void run_labelBlobs(bench_data_t *b) { labelBlobs(b->dst, b->dst, EIGHT); }
+static void run_labelBlobsFast(bench_data_t *b) { labelBlobsFast(b->binary, b->dst16, EIGHT, b->ws); }
+static void run_binaryEdgeDetect(bench_data_t *b) { binaryEdgeDetect(b->binary, b->dst, EIGHT); }
+static void run_binaryEdgeDetectFour(bench_data_t *b) { binaryEdgeDetect(b->binary, b->dst, FOUR); }
+static void run_blobAnalyse(bench_data_t *b) { blobinfo_t info; blobAnalyse(b->labels, 1, &info); }
+static void run_centroid(bench_data_t *b) { int32_t cc, rc; centroid(b->labels, 1, &cc, &rc); }
+static void run_normalizedCentralMoments(bench_data_t *b) { normalizedCentralMoments(b->labels, 1, 2, 0); }
+static void run_blobStatistics(bench_data_t *b) { blobStatistics(b->labels, b->stats, b->nof_blobs); }
+
+static void run_wbfe(bench_data_t *b)
+{
+    int32_t target[2] = {b->gray->cols / 2, b->gray->rows / 2};
+    int32_t offset[2];
+    WBFE_evaluateContext(b->wbfe, b->gray, target, offset);
+}
+
+static void run_wbfeSeparable(bench_data_t *b)
+{
+    int32_t target[2] = {b->gray->cols / 2, b->gray->rows / 2};
+    int32_t offset[2];
+    WBFE_evaluateContext(b->wbfe_separable, b->gray, target, offset);
+}
+
+static void run_wbfePyramid(bench_data_t *b)
+{
+    int32_t target[2] = {b->gray->cols / 2, b->gray->rows / 2};
+    int32_t offset[2];
+    WBFE_evaluateContext(b->wbfe_pyramid, b->gray, target, offset);
+}
+
+static void run_houghCircles(bench_data_t *b)
+{
+    houghcircle_t circle;
+    houghCircles(b->ht->work, b->ht->hough_ws, &b->ht->params.hough, &circle, 1);
+}
+
+static void run_ht(bench_data_t *b)
+{
+    int32_t target[2] = {b->gray->cols / 2, b->gray->rows / 2};
+    float offset[2];
+    HT_evaluateContext(b->ht, b->gray, target, offset);
+}
+
+static const bench_op_t ops[] =
+{
+    {"copy",                     NULL,            run_copy},
+    {"erase",                    NULL,            run_erase},
+    {"rgb888ToGray",             NULL,            run_rgb888ToGray},
+    {"rotate180",                copyGrayToDst,   run_rotate180},
+    {"contrastStretch",          NULL,            run_contrastStretch},
+    {"contrastStretchFast",      NULL,            run_contrastStretchFast},
+    {"threshold",                NULL,            run_threshold},
+    {"threshold2Means",          NULL,            run_threshold2Means},
+    {"thresholdOtsu",            NULL,            run_thresholdOtsu},
+    {"threshold2MeansStats",     NULL,            run_threshold2MeansStats},
+    {"thresholdOtsuStats",       NULL,            run_thresholdOtsuStats},
+    {"setSelectedToValue",       NULL,            run_setSelectedToValue},
+    {"histogram",                NULL,            run_histogram},
+    {"invert",                   NULL,            run_invert},
+    {"gamma_evdk",               NULL,            run_gamma},
+    {"applyLUT",                 NULL,            run_applyLUT},
+    {"stretchLUTThreshold",      NULL,            run_stretchLUTThreshold},
+    {"stretchLUTThreshold binary", NULL,          run_stretchLUTThresholdPacked},
+    {"stretchLUTThresholdStats", NULL,            run_stretchLUTThresholdStats},
+    {"nonlinearFilter median 3", NULL,            run_median3},
+    {"nonlinearFilter min 3",    NULL,            run_min3},
+    {"nonlinearFilter harmonic 5", NULL,          run_harmonic5},
+    {"gaussianBlur",             NULL,            run_gaussianBlur},
+    {"convolution",              NULL,            run_convolution},
+    {"convolution 7x7",          NULL,            run_convolution7},
+    {"gaussianBlurSeparable",    NULL,            run_gaussianBlurSeparable},
+    {"separableConvolution",     NULL,            run_separableConvolution},
+    {"separableConvolutionStats", NULL,           run_separableConvolutionStats},
+    {"pyramidDown",              NULL,            run_pyramidDown},
+    {"morph_erode 5x5",          NULL,            run_erode},
+    {"morph_dilate 5x5",         NULL,            run_dilate},
+    {"morph_open 5x5",           NULL,            run_open},
+    {"open_basic ellipse",       NULL,            run_openEllipse},
+    {"morphOpenFast ellipse",    NULL,            run_morphOpenFast},
+    {"packBinary",               NULL,            run_packBinary},
+    {"unpackBinary",             NULL,            run_unpackBinary},
+    {"threshold binary",         NULL,            run_thresholdPacked},
+    {"invert binary",            NULL,            run_invertPacked},
+    {"sum binary",               NULL,            run_sumPacked},
+    {"morphOpenFast binary",     NULL,            run_morphOpenFastPacked},
+    {"removeBorderBlobs",        copyBinaryToDst, run_removeBorderBlobs},
+    {"fillHoles",                NULL,            run_fillHoles},
+    {"fillHolesFast",            NULL,            run_fillHolesFast},
+    {"distanceTransform",        NULL,            run_distanceTransform},
+    {"waterShed",                NULL,            run_waterShed},
+    {"waterShedFast",            NULL,            run_waterShedFast},
+    {"splitBlobs",               NULL,            run_splitBlobs},
+    {"labelBlobs",               copyBinaryToDst, run_labelBlobs},
+    {"labelBlobsFast",           NULL,            run_labelBlobsFast},
+    {"binaryEdgeDetect",         NULL,            run_binaryEdgeDetect},
+    {"binaryEdgeDetect four",    NULL,            run_binaryEdgeDetectFour},
+    {"blobAnalyse",              NULL,            run_blobAnalyse},
+    {"centroid",                 NULL,            run_centroid},
+    {"normalizedCentralMoments", NULL,            run_normalizedCentralMoments},
+    {"blobStatistics",           NULL,            run_blobStatistics},
+    {"WBFE pipeline",            NULL,            run_wbfe},
+    {"WBFE pipeline separable",  NULL,            run_wbfeSeparable},
+    {"WBFE pipeline pyramid",    NULL,            run_wbfePyramid},
+    {"houghCircles",             NULL,            run_houghCircles},
+    {"HT pipeline separable",    NULL,            run_ht},
+};
+
+// ----------------------------------------------------------------------------
+// Helpers
+// ----------------------------------------------------------------------------
+
+static int compareDouble(const void *a, const void *b)
+{
+    double d = *(const double *)a - *(const double *)b;
+    return (d > 0) - (d < 0);
+}
+
+// Load a png file as an 8-bit grayscale basic image, colour images are
+// converted to grayscale
+// Returns NULL if the file can not be read
+static image_t *loadPNG(const char *path)
+{
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if(!png_image_begin_read_from_file(&png, path))
+    {
+        fprintf(stderr, "%s: %s\n", path, png.message);
+        return NULL;
+    }
+    png.format = PNG_FORMAT_GRAY;
+    image_t *img = newBasicImage(png.width, png.height);
+    if(img == NULL)
+    {
+        png_image_free(&png);
+        return NULL;
+    }
+    if(!png_image_finish_read(&png, NULL, img->data, img->stride, NULL))
+    {
+        fprintf(stderr, "%s: %s\n", path, png.message);
+        deleteImage(img);
+        return NULL;
+    }
+    return img;
+}
+
+// Allocate the images and workspaces for gray and run the pipeline up to
+// the labelling to create the binary and labeled images
+// Returns 0 if memory could not be allocated
+static int newBenchData(bench_data_t *b, image_t *gray)
+{
+    const int32_t cols = gray->cols;
+    const int32_t rows = gray->rows;
+    wbfe_params_t params = {BLUR_KERNEL_SIZE, BLUR_SIGMA, GAMMA_C, GAMMA_G, THRESHOLD, AREA_THRESHOLD, 0, 0, 0};
+    const float ht_scale = (float)cols / HT_COLS;
+    ht_params_t ht_params = {(int32_t)(HT_KERNEL_SIZE * ht_scale) | 1, HT_BLUR_SIGMA, HT_GAMMA_C, HT_GAMMA_G, 1,
+                             {(int32_t)(HT_MIN_RADIUS * ht_scale), (int32_t)(HT_MAX_RADIUS * ht_scale),
+                              (int32_t)(HT_MIN_DISTANCE * ht_scale), HT_PARAM1, HT_PARAM2}};
+    int32_t target[2] = {cols / 2, rows / 2};
+    float offset[2];
+
+    memset(b, 0, sizeof(*b));
+    b->gray = gray;
+    b->blurred = newBasicImage(cols, rows);
+    b->binary = newBasicImage(cols, rows);
+    b->packed = newBinaryImage(cols, rows);
+    b->packed_dst = newBinaryImage(cols, rows);
+    b->labels = newInt16Image(cols, rows);
+    b->dst = newBasicImage(cols, rows);
+    b->tmp = newInt16Image(cols, rows);
+    b->dst16 = newInt16Image(cols, rows);
+    b->kernel2d = newFloatImage(BLUR_KERNEL_SIZE, BLUR_KERNEL_SIZE);
+    b->kernel7 = newFloatImage(7, 7);
+    b->kernel1d = newInt16Image(BLUR_KERNEL_SIZE, 1);
+    b->morph = newBasicImage(5, 5);
+    b->ellipse = newBasicImage(OPEN_SIZE, OPEN_SIZE);
+    b->rgb = newRGB888Image(cols, rows);
+    b->queue = (uint32_t *)malloc(cols * rows * sizeof(uint32_t));
+    b->ws = newLabelWorkspace(cols, rows);
+    b->stats = (blobstats_t *)malloc(MAX_INT16_LABELS * sizeof(blobstats_t));
+    b->wbfe = newWBFEContext(cols, rows, &params);
+    params.separable = 1;
+    b->wbfe_separable = newWBFEContext(cols, rows, &params);
+    params.pyramid_levels = 2;
+    b->wbfe_pyramid = newWBFEContext(cols, rows, &params);
+    b->half = newBasicImage((cols + 1) / 2, (rows + 1) / 2);
+    b->ht = newHTContext(cols, rows, &ht_params);
+    if(b->blurred == NULL || b->binary == NULL || b->packed == NULL || b->packed_dst == NULL || b->labels == NULL || b->dst == NULL || b->tmp == NULL || b->dst16 == NULL ||
+       b->kernel2d == NULL || b->kernel7 == NULL || b->kernel1d == NULL || b->morph == NULL || b->ellipse == NULL || b->rgb == NULL || b->queue == NULL || b->ws == NULL ||
+       b->stats == NULL || b->wbfe == NULL || b->wbfe_separable == NULL || b->wbfe_pyramid == NULL || b->half == NULL ||
+       b->ht == NULL)
+    {
+        return 0;
+    }
+
+    gaussianKernel(b->kernel2d, BLUR_SIGMA);
+    gaussianKernel(b->kernel7, 1.5);
+    gaussianKernel1D(b->kernel1d, BLUR_SIGMA);
+    gammaLUT_basic(b->lut, GAMMA_C, GAMMA_G);
+    erase(b->morph);
+    setSelectedToValue(b->morph, b->morph, 0, 1);
+    ellipseKernel(b->ellipse);
+    for(int32_t i = 0; i < cols * rows; i++)
+    {
+        ((rgb888_pixel_t *)b->rgb->data)[i] = (rgb888_pixel_t){gray->data[i], gray->data[i], gray->data[i]};
+    }
+    b->morph_ws = newMorphWorkspace(cols, rows, b->ellipse);
+    b->dist = newFloatImage(cols, rows);
+    b->wshed_ws = newWatershedWorkspace(cols, rows);
+    if(b->morph_ws == NULL || b->dist == NULL || b->wshed_ws == NULL)
+    {
+        return 0;
+    }
+
+    // Pipeline intermediates, see WBFE_evaluateContext()
+    separableConvolutionStats(gray, b->blurred, b->tmp, b->kernel1d, &b->blur_stats);
+    separableConvolution(gray, b->binary, b->tmp, b->kernel1d);
+    contrastStretchFast(b->binary, b->binary);
+    applyLUT(b->binary, b->binary, b->lut);
+    threshold(b->binary, b->binary, 0, THRESHOLD);
+    invert(b->binary, b->binary);
+    fillHolesFast(b->binary, b->binary, EIGHT, b->queue);
+    packBinary(b->binary, b->packed);
+    b->nof_blobs = labelBlobsFast(b->binary, b->labels, EIGHT, b->ws);
+    HT_evaluateContext(b->ht, gray, target, offset);
+    return 1;
+}
+
+static void deleteBenchData(bench_data_t *b)
+{
+    image_t *imgs[] = {b->blurred, b->binary, b->packed, b->packed_dst, b->labels, b->dst, b->tmp, b->dst16, b->kernel2d, b->kernel7, b->kernel1d, b->morph,
+                        b->ellipse, b->rgb, b->half, b->dist};
+    for(uint32_t i = 0; i < sizeof(imgs) / sizeof(imgs[0]); i++)
+    {
+        if(imgs[i] != NULL)
+        {
+            deleteImage(imgs[i]);
+        }
+    }
+    free(b->queue);
+    deleteLabelWorkspace(b->ws);
+    deleteMorphWorkspace(b->morph_ws);
+    deleteWatershedWorkspace(b->wshed_ws);
+    free(b->stats);
+    deleteWBFEContext(b->wbfe);
+    deleteWBFEContext(b->wbfe_separable);
+    deleteWBFEContext(b->wbfe_pyramid);
+    deleteHTContext(b->ht);
+}
+
+// Run every operator on one image and print the results
+static void benchImage(const char *path, const uint32_t max_runs, const double budget_ms)
+{
+    image_t *gray = loadPNG(path);
+    if(gray == NULL)
+    {
+        return;
+    }
+    bench_data_t b;
+    memset(&b, 0, sizeof(b));
+    double *ms = (double *)malloc(max_runs * sizeof(double));
+    if(ms == NULL || !newBenchData(&b, gray))
+    {
+        fprintf(stderr, "%s: could not allocate memory\n", path);
+        free(ms);
+        deleteBenchData(&b);
+        deleteImage(gray);
+        return;
+    }
+
+    printf("%s (%dx%d, %u blobs)\n", path, gray->cols, gray->rows, b.nof_blobs);
+    printf("  %-28s %6s %12s %12s %10s\n", "operator", "runs", "median (ms)", "p99 (ms)", "Mpixel/s");
+    for(uint32_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+    {
+        uint32_t runs = 0;
+        double elapsed = 0.0;
+        while(runs < max_runs && (runs < MIN_RUNS || elapsed < budget_ms))
+        {
+            if(ops[i].prepare != NULL)
+            {
+                ops[i].prepare(&b);
+            }
+            double t = monotonicMs();
+            ops[i].run(&b);
+            ms[runs] = monotonicMs() - t;
+            elapsed += ms[runs++];
+        }
+        qsort(ms, runs, sizeof(double), compareDouble);
+        // p99 is the nearest rank, the slowest run if there are less than 100
+        double median = runs % 2 ? ms[runs / 2] : (ms[runs / 2 - 1] + ms[runs / 2]) / 2;
+        double p99 = ms[(99 * runs + 99) / 100 - 1];
+        printf("  %-28s %6u %12.3f %12.3f %10.2f\n", ops[i].name, runs, median, p99,
+               median > 0 ? gray->cols * gray->rows / (median * 1000.0) : 0.0);
+        fflush(stdout);
+    }
+    printf("\n");
+
+    free(ms);
+    deleteBenchData(&b);
+    deleteImage(gray);
+}
+
+// Evaluate every frame of an archive once and print the latency of the frames
+static void benchArchive(const char *path)
+{
+    framearchive_t *archive = openFrameArchive(path);
+    if(archive == NULL || archive->type != IMGTYPE_BASIC || archive->nof_frames == 0)
+    {
+        fprintf(stderr, "%s: not an archive of grayscale frames\n", path);
+        closeFrameArchive(archive);
+        return;
+    }
+    wbfe_params_t params = {BLUR_KERNEL_SIZE, BLUR_SIGMA, GAMMA_C, GAMMA_G, THRESHOLD, AREA_THRESHOLD, 0, 0, 0};
+    wbfe_context_t *ctx = newWBFEContext(archive->cols, archive->rows, &params);
+    double *ms = (double *)malloc(archive->nof_frames * sizeof(double));
+    if(ctx == NULL || ms == NULL)
+    {
+        fprintf(stderr, "%s: could not allocate memory\n", path);
+        deleteWBFEContext(ctx);
+        free(ms);
+        closeFrameArchive(archive);
+        return;
+    }
+
+    uint32_t found = 0;
+    double total = 0.0;
+    for(uint32_t i = 0; i < archive->nof_frames; i++)
+    {
+        image_t frame;
+        int32_t offset[2];
+        frameArchiveFrame(archive, i, &frame);
+        double t = monotonicMs();
+        found += WBFE_evaluateContext(ctx, &frame, frameArchiveMeta(archive, i)->target, offset) != 0;
+        ms[i] = monotonicMs() - t;
+        total += ms[i];
+    }
+    qsort(ms, archive->nof_frames, sizeof(double), compareDouble);
+    uint32_t n = archive->nof_frames;
+    double median = n % 2 ? ms[n / 2] : (ms[n / 2 - 1] + ms[n / 2]) / 2;
+    double p99 = ms[(99 * n + 99) / 100 - 1];
+    printf("%s (%u frames of %dx%d, %u found)\n", path, n, archive->cols, archive->rows, found);
+    printf("  %-28s %6s %12s %12s %10s\n", "replay", "frames", "median (ms)", "p99 (ms)", "frames/s");
+    printf("  %-28s %6u %12.3f %12.3f %10.2f\n\n", "well bottom features", n, median, p99,
+           total > 0 ? n * 1000.0 / total : 0.0);
+    fflush(stdout);
+
+    free(ms);
+    deleteWBFEContext(ctx);
+    closeFrameArchive(archive);
+}
+
+// Benchmark a png file, a frame archive, or all png files in a directory
+static void benchPath(const char *path, const uint32_t max_runs, const double budget_ms)
+{
+    size_t len = strlen(path);
+    if(len > 4 && strcmp(path + len - 4, ".wva") == 0)
+    {
+        benchArchive(path);
+        return;
+    }
+#ifndef _WIN32
+    DIR *dir = opendir(path);
+    if(dir != NULL)
+    {
+        struct dirent *entry;
+        char file[4096];
+        while((entry = readdir(dir)) != NULL)
+        {
+            size_t len = strlen(entry->d_name);
+            if(len > 4 && strcmp(entry->d_name + len - 4, ".png") == 0)
+            {
+                snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+                benchImage(file, max_runs, budget_ms);
+            }
+        }
+        closedir(dir);
+        return;
+    }
+#endif
+    benchImage(path, max_runs, budget_ms);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t max_runs = 50;
+    double budget_ms = 2000.0;
+    int i = 1;
+
+    // Options come before the paths
+    for(; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        if(strcmp(argv[i], "-n") == 0)
+        {
+            max_runs = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            budget_ms = atof(argv[i + 1]) * 1000.0;
+        }
+        else if(strcmp(argv[i], "-j") == 0)
+        {
+            printf("%u threads\n\n", setThreadCount((uint32_t)atoi(argv[i + 1])));
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n runs] [-t seconds] [-j threads] [png files, directories or archives]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(max_runs < MIN_RUNS)
+    {
+        max_runs = MIN_RUNS;
+    }
+
+    if(i == argc)
+    {
+        benchPath("../images", max_runs, budget_ms);
+    }
+    for(; i < argc; i++)
+    {
+        benchPath(argv[i], max_runs, budget_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,1083 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the C implementations of the well
+ *              position evaluators
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision: well bottom features evaluator context
+    > Separable fixed point gaussian blur option
+    > Union-find blob labelling into an int16 label image
+    > Blob classification from single pass blob statistics
+    > Flood fill hole filling
+    > Region of interest evaluation
+    > Regions of interest are evaluated as views into the frame
+    > Optional per stage timing of the pipeline
+    > Contexts can be used from different threads
+    > Optional elliptical opening after the threshold
+    > Hough transform evaluator context
+    > Optional frame preprocessing cache shared between contexts
+    > Optional coarse to fine search on a gaussian pyramid
+    > Optional tracking of the blob between frames
+    > Batch evaluation of frame sets with parameter sets
+
+******************************************************************************/
+#include "evaluators.h"
+#include "operators_basic.h"
+#include "math.h"
+
+#ifndef M_PI
+#define M_PI		3.14159265358979323846
+#endif
+
+// Candidate blobs of the coarse search that are evaluated at full resolution:
+// at most WBFE_MAX_CANDIDATES, with a coarse score up to WBFE_CANDIDATE_MARGIN
+// above the best one. The scores of small blobs are not very accurate in the
+// pyramid.
+#define WBFE_MAX_CANDIDATES    8
+#define WBFE_CANDIDATE_MARGIN  0.25f
+
+// A tracked blob is searched within WBFE_TRACK_MARGIN pixels plus half the
+// expected shift of its expected position, the motors do not move exactly
+// the commanded distance. Its score may be up to WBFE_TRACK_SCORE_MARGIN
+// above the last one.
+#define WBFE_TRACK_MARGIN        16
+#define WBFE_TRACK_SCORE_MARGIN  0.1f
+
+// Image type of each working image in the pool
+// (make sure order matches the order in eWBFEBuffer)
+static const eImageType pool_types[WBFE_POOL_SIZE] =
+{
+    IMGTYPE_BASIC,  // WBFE_BUF_FRAME
+    IMGTYPE_BASIC,  // WBFE_BUF_WORK
+    IMGTYPE_INT16,  // WBFE_BUF_BLUR
+    IMGTYPE_INT16,  // WBFE_BUF_LABELS
+    IMGTYPE_BINARY, // WBFE_BUF_BINARY
+    IMGTYPE_BASIC,  // WBFE_BUF_WINDOW
+};
+
+// Row stride of a working image of cols pixels wide, in pixels (words for
+// IMGTYPE_BINARY)
+static uint32_t poolStride(const eImageType type, const uint32_t cols)
+{
+    return type == IMGTYPE_BINARY ? BINARY_WORDS(cols) : cols;
+}
+
+// Working image i takes the size cols x rows, unless it is the frame that is
+// evaluated
+static void resizePool(wbfe_context_t *ctx, const uint32_t i, const image_t *src, const int32_t cols,
+                       const int32_t rows)
+{
+    if(&ctx->pool[i] != src)
+    {
+        ctx->pool[i].cols = cols;
+        ctx->pool[i].rows = rows;
+        ctx->pool[i].stride = poolStride(pool_types[i], cols);
+    }
+}
+
+// Stage names (make sure order matches the order in eWBFEStage)
+static const char *stage_names[WBFE_NOF_STAGES] =
+{
+    "blur",
+    "stretch",
+    "gamma",
+    "threshold",
+    "open",
+    "fill_holes",
+    "labelling",
+    "classification",
+    "centroid",
+    "coarse",
+};
+
+// Add the time since *t to the time of stage and restart *t
+// Does nothing if timing is off
+static void stageDone(wbfe_context_t *ctx, const eWBFEStage stage, double *t)
+{
+    if(ctx->timing != NULL)
+    {
+        double now = monotonicMs();
+        ctx->timing->ms[stage] += now - *t;
+        ctx->timing->total_ms += now - *t;
+        *t = now;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+wbfe_context_t *newWBFEContext(const int32_t cols,
+                               const int32_t rows,
+                               const wbfe_params_t *params)
+{
+    if(cols <= 0 || rows <= 0 || params->kernel_size <= 0 || params->kernel_size % 2 == 0 ||
+       params->open_size < 0 || params->pyramid_levels < 0 || params->pyramid_levels > WBFE_MAX_PYRAMID_LEVELS)
+    {
+        return NULL;
+    }
+
+    wbfe_context_t *ctx = (wbfe_context_t *)calloc(1, sizeof(wbfe_context_t));
+    if(ctx == NULL)
+    {
+        // Unable to allocate memory for context
+        return NULL;
+    }
+    ctx->cols = cols;
+    ctx->rows = rows;
+    ctx->params = *params;
+
+    // Allocate the pixel data of all working images in one block
+    // Each image starts at an 8 byte boundary
+    register uint32_t size = 0;
+    register uint32_t i;
+    for(i = 0; i < WBFE_POOL_SIZE; i++)
+    {
+        size += (poolStride(pool_types[i], cols) * rows * pixelSize(pool_types[i]) + 7) & ~7u;
+    }
+    ctx->arena = (uint8_t *)malloc(size);
+    if(ctx->arena == NULL)
+    {
+        deleteWBFEContext(ctx);
+        return NULL;
+    }
+    size = 0;
+    for(i = 0; i < WBFE_POOL_SIZE; i++)
+    {
+        ctx->pool[i].cols = cols;
+        ctx->pool[i].rows = rows;
+        ctx->pool[i].stride = poolStride(pool_types[i], cols);
+        ctx->pool[i].view = IMGVIEW_CLIP;
+        ctx->pool[i].type = pool_types[i];
+        ctx->pool[i].data = ctx->arena + size;
+        size += (poolStride(pool_types[i], cols) * rows * pixelSize(pool_types[i]) + 7) & ~7u;
+    }
+
+    // Precalculate the gaussian kernel and gamma look up table
+    if(params->separable)
+    {
+        ctx->kernel = newInt16Image(params->kernel_size, 1);
+    }
+    else
+    {
+        ctx->kernel = newFloatImage(params->kernel_size, params->kernel_size);
+    }
+    if(ctx->kernel == NULL)
+    {
+        deleteWBFEContext(ctx);
+        return NULL;
+    }
+    if(params->separable)
+    {
+        gaussianKernel1D(ctx->kernel, params->sigma);
+    }
+    else
+    {
+        gaussianKernel(ctx->kernel, params->sigma);
+    }
+    gammaLUT_basic(ctx->gamma_lut, params->c, params->g);
+
+    ctx->label_ws = newLabelWorkspace(cols, rows);
+    ctx->stats = (blobstats_t *)malloc(MAX_INT16_LABELS * sizeof(blobstats_t));
+    ctx->fill_queue = (uint32_t *)malloc(cols * rows * sizeof(uint32_t));
+    if(ctx->label_ws == NULL || ctx->stats == NULL || ctx->fill_queue == NULL)
+    {
+        deleteWBFEContext(ctx);
+        return NULL;
+    }
+
+    // The opening structuring element is only needed to create the workspace
+    if(params->open_size > 0)
+    {
+        image_t *ellipse = newBasicImage(params->open_size, params->open_size);
+        if(ellipse != NULL)
+        {
+            ellipseKernel(ellipse);
+            ctx->open_ws = newMorphWorkspace(cols, rows, ellipse);
+            deleteImage(ellipse);
+        }
+        if(ctx->open_ws == NULL)
+        {
+            deleteWBFEContext(ctx);
+            return NULL;
+        }
+    }
+
+    // Downsampled frames and the context that searches the smallest one, the
+    // blur, area and opening are scaled to its size. The pyramid filter
+    // itself adds a little blur, which is not compensated.
+    if(params->pyramid_levels > 0)
+    {
+        wbfe_params_t coarse = *params;
+        int32_t c = cols;
+        int32_t r = rows;
+        for(i = 0; i < (uint32_t)params->pyramid_levels; i++)
+        {
+            c = (c + 1) / 2;
+            r = (r + 1) / 2;
+            ctx->pyramid[i] = newBasicImage(c, r);
+            if(ctx->pyramid[i] == NULL)
+            {
+                deleteWBFEContext(ctx);
+                return NULL;
+            }
+        }
+        coarse.kernel_size = (params->kernel_size >> params->pyramid_levels) | 1;
+        coarse.sigma = params->sigma / (1 << params->pyramid_levels);
+        coarse.area_threshold = params->area_threshold >> (2 * params->pyramid_levels);
+        coarse.open_size = params->open_size >> params->pyramid_levels;
+        coarse.pyramid_levels = 0;
+        ctx->coarse = newWBFEContext(c, r, &coarse);
+        if(ctx->coarse == NULL)
+        {
+            deleteWBFEContext(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteWBFEContext(wbfe_context_t *ctx)
+{
+    register uint32_t i;
+
+    if(ctx == NULL)
+    {
+        return;
+    }
+    for(i = 0; i < WBFE_MAX_PYRAMID_LEVELS; i++)
+    {
+        if(ctx->pyramid[i] != NULL)
+        {
+            deleteImage(ctx->pyramid[i]);
+        }
+    }
+    deleteWBFEContext(ctx->coarse);
+    if(ctx->kernel != NULL)
+    {
+        deleteImage(ctx->kernel);
+    }
+    deleteLabelWorkspace(ctx->label_ws);
+    free(ctx->stats);
+    free(ctx->fill_queue);
+    deleteMorphWorkspace(ctx->open_ws);
+    free(ctx->arena);
+    free(ctx);
+}
+
+// 1. Gaussian blur of src into dst, from the cache if another context blurred
+// the frame with the same kernel. Returns the blurred image and sets *stats to
+// its statistics.
+static const image_t *blurFrame(wbfe_context_t *ctx, const image_t *src, image_t *dst,
+                                const pixelstats_t **stats)
+{
+    const image_t *blurred = NULL;
+
+    if(ctx->cache != NULL)
+    {
+        prepparams_t prep = {ctx->params.kernel_size, ctx->params.sigma, ctx->params.separable, 0.0f, 0.0f};
+        blurred = prepCacheBlur(ctx->cache, src, &prep, ctx->kernel, &ctx->pool[WBFE_BUF_BLUR], stats);
+    }
+    if(blurred == NULL)
+    {
+        if(ctx->params.separable)
+        {
+            separableConvolutionStats(src, dst, &ctx->pool[WBFE_BUF_BLUR], ctx->kernel, &ctx->blur_stats);
+        }
+        else
+        {
+            convolutionStats(src, dst, ctx->kernel, &ctx->blur_stats);
+        }
+        blurred = dst;
+        *stats = &ctx->blur_stats;
+    }
+    return blurred;
+}
+
+// Classification score of a blob, the mean of 1 - roundness and the
+// eccentricity: lower is better
+static float blobScore(const blobstats_t *bs)
+{
+    float roundness_metric, eccentricity_metric;
+    float m20, m02, m11;
+
+    // Calculate roundness metric
+    roundness_metric = 4 * M_PI * bs->m00 / (bs->perimeter * bs->perimeter);
+    // Calculate eccentricity metric using moments
+    m20 = blobStatsNormalizedCentralMoment(bs, 2, 0);
+    m02 = blobStatsNormalizedCentralMoment(bs, 0, 2);
+    m11 = blobStatsNormalizedCentralMoment(bs, 1, 1);
+    eccentricity_metric = ((m20 - m02) * (m20 - m02) + 4 * m11 * m11) / ((m20 + m02) * (m20 + m02));
+    return (1-roundness_metric + eccentricity_metric) / 2;
+}
+
+// 2. - 6. on a blurred frame of the size of the working images, stretched with
+// the min and max of blur_stats, up to the blob statistics in ctx->stats.
+// Returns the number of blobs.
+static uint32_t segmentBlobs(wbfe_context_t *ctx, const image_t *blurred, const pixelstats_t *blur_stats,
+                             double *t)
+{
+    image_t *work = &ctx->pool[WBFE_BUF_WORK];
+    image_t *labels = &ctx->pool[WBFE_BUF_LABELS];
+
+    // 2. Contrast stretch, 3. gamma and 4. inverted threshold in one pass,
+    // timed as the threshold stage: the pixels above the threshold after the
+    // stretch and gamma are selected. The min and max for the stretch come
+    // from the blur.
+    // 4b. Opening, removes the parts of the blobs that are thinner than the
+    // structuring element (same as the opencv implementation). The threshold
+    // is done straight into the packed image, the opening unpacks its result
+    // into work.
+    if(ctx->open_ws != NULL)
+    {
+        stretchLUTThresholdStats(blurred, &ctx->pool[WBFE_BUF_BINARY], ctx->gamma_lut, ctx->params.threshold + 1,
+                                 255, blur_stats);
+        stageDone(ctx, WBFE_STAGE_THRESHOLD, t);
+        morphOpenFast(&ctx->pool[WBFE_BUF_BINARY], work, ctx->open_ws);
+        stageDone(ctx, WBFE_STAGE_OPEN, t);
+    }
+    else
+    {
+        stretchLUTThresholdStats(blurred, work, ctx->gamma_lut, ctx->params.threshold + 1, 255, blur_stats);
+        stageDone(ctx, WBFE_STAGE_THRESHOLD, t);
+    }
+
+    // 5. fill holes
+    fillHolesFast(work, work, EIGHT, ctx->fill_queue);
+    stageDone(ctx, WBFE_STAGE_FILL_HOLES, t);
+
+    // 6. Labelling, feature extraction
+    uint32_t blob_count;
+    blob_count = labelBlobsFast(work, labels, EIGHT, ctx->label_ws);
+    stageDone(ctx, WBFE_STAGE_LABELLING, t);
+    blobStatistics(labels, ctx->stats, blob_count);
+    return blob_count;
+}
+
+// 6. Classification to select correct blob: the blob of ctx->stats with the
+// lowest score that passes the area threshold and, if interior is not NULL,
+// lies within interior. Returns its index and sets *score, or returns -1.
+static int32_t selectBlob(wbfe_context_t *ctx, const uint32_t blob_count, const wbfe_roi_t *interior,
+                          float *score)
+{
+    int32_t best_match = -1;
+    float best_score = 1000.0f;
+    float s;
+    const blobstats_t *bs;
+    for(uint32_t i = 1; i <= blob_count; i++) {
+        bs = &ctx->stats[i - 1];
+        if((int32_t) bs->m00 < ctx->params.area_threshold) {
+            continue;
+        }
+        if(interior != NULL && (bs->min_col < interior->col || bs->max_col >= interior->col + interior->cols ||
+                                bs->min_row < interior->row || bs->max_row >= interior->row + interior->rows)) {
+            continue;
+        }
+        s = blobScore(bs);
+        if(s < best_score) {
+            best_score = s;
+            best_match = i;
+        }
+    }
+    *score = best_score;
+    return best_match == -1 ? -1 : best_match - 1;
+}
+
+// Best blob in a window of src, evaluated at full resolution: the window is
+// blurred with the pixels the kernel reaches around it, so its blur is the
+// same as the blur of the whole frame, and the stretch of the whole frame
+// uses the min and max of stretch. Blobs that touch a side of the window
+// within src are cut off by it and are skipped.
+// Returns the index into ctx->stats and sets *score, or returns -1.
+static int32_t findBlobWindow(wbfe_context_t *ctx, const image_t *src, const wbfe_roi_t *window,
+                              const pixelstats_t *stretch, float *score, double *t)
+{
+    const image_t *blurred;
+    const pixelstats_t *blur_stats;
+    image_t view;
+    wbfe_roi_t padded;
+    wbfe_roi_t interior = {0, 0, window->cols, window->rows};
+    register uint32_t i;
+
+    // 1.
+    padded.col = window->col - ctx->params.kernel_size / 2;
+    padded.row = window->row - ctx->params.kernel_size / 2;
+    padded.cols = window->cols + ctx->params.kernel_size - 1;
+    padded.rows = window->rows + ctx->params.kernel_size - 1;
+    WBFE_clipROI(src, &padded);
+    subImage(src, &view, padded.col, padded.row, padded.cols, padded.rows);
+    resizePool(ctx, WBFE_BUF_BLUR, src, padded.cols, padded.rows);
+    resizePool(ctx, WBFE_BUF_WINDOW, src, padded.cols, padded.rows);
+    blurred = blurFrame(ctx, &view, &ctx->pool[WBFE_BUF_WINDOW], &blur_stats);
+    stageDone(ctx, WBFE_STAGE_BLUR, t);
+
+    // 2. - 6.
+    subImage(blurred, &view, window->col - padded.col, window->row - padded.row, window->cols, window->rows);
+    for(i = 0; i < WBFE_POOL_SIZE; i++)
+    {
+        if(i != WBFE_BUF_BLUR && i != WBFE_BUF_WINDOW)
+        {
+            resizePool(ctx, i, src, window->cols, window->rows);
+        }
+    }
+    if(window->col > 0)
+    {
+        interior.col++;
+        interior.cols--;
+    }
+    if(window->col + window->cols < src->cols)
+    {
+        interior.cols--;
+    }
+    if(window->row > 0)
+    {
+        interior.row++;
+        interior.rows--;
+    }
+    if(window->row + window->rows < src->rows)
+    {
+        interior.rows--;
+    }
+    uint32_t blob_count = segmentBlobs(ctx, &view, stretch, t);
+    int32_t best = selectBlob(ctx, blob_count, &interior, score);
+    stageDone(ctx, WBFE_STAGE_CLASSIFICATION, t);
+    return best;
+}
+
+// Coarse to fine search, see WBFE_evaluateContext(): the candidate blobs are
+// searched in the smallest pyramid level and evaluated in a window of src
+// around each of them, with the stretch of the coarse blur.
+// Returns 1 and sets *best, *window and *best_score to the best blob, the
+// window it is in and its score, or returns 0 if no window has a blob or the
+// windows are together larger than src (evaluating the whole frame is then
+// faster).
+static int findBlobPyramid(wbfe_context_t *ctx, const image_t *src, blobstats_t *best, wbfe_roi_t *window,
+                           float *best_score, double *t)
+{
+    wbfe_context_t *coarse = ctx->coarse;
+    const int32_t levels = ctx->params.pyramid_levels;
+    const image_t *level = src;
+    const image_t *blurred;
+    const pixelstats_t *blur_stats;
+    const blobstats_t *bs;
+    uint32_t candidates[WBFE_MAX_CANDIDATES];
+    float scores[WBFE_MAX_CANDIDATES];
+    wbfe_roi_t windows[WBFE_MAX_CANDIDATES];
+    int32_t area = 0;
+    uint32_t nof_candidates = 0;
+    float score;
+    int32_t match;
+    register uint32_t i;
+    register uint32_t j;
+
+    // the pyramid needs one row of the blur buffer, it is resized for the
+    // windows
+    resizePool(ctx, WBFE_BUF_BLUR, src, src->cols, 1);
+    for(i = 0; i < (uint32_t)levels; i++)
+    {
+        ctx->pyramid[i]->cols = (level->cols + 1) / 2;
+        ctx->pyramid[i]->rows = (level->rows + 1) / 2;
+        ctx->pyramid[i]->stride = ctx->pyramid[i]->cols;
+        pyramidDown(level, ctx->pyramid[i], &ctx->pool[WBFE_BUF_BLUR]);
+        level = ctx->pyramid[i];
+    }
+    for(i = 0; i < WBFE_POOL_SIZE; i++)
+    {
+        resizePool(coarse, i, level, level->cols, level->rows);
+    }
+    blurred = blurFrame(coarse, level, &coarse->pool[WBFE_BUF_WORK], &blur_stats);
+    uint32_t blob_count = segmentBlobs(coarse, blurred, blur_stats, t);
+
+    // The candidates, sorted by score. A blob can lose some of its area in
+    // the pyramid, the area threshold is lowered by a quarter.
+    for(i = 0; i < blob_count; i++)
+    {
+        bs = &coarse->stats[i];
+        if((int32_t) bs->m00 < coarse->params.area_threshold * 3 / 4)
+        {
+            continue;
+        }
+        score = blobScore(bs);
+        for(j = nof_candidates; j > 0 && scores[j - 1] > score; j--)
+        {
+            if(j < WBFE_MAX_CANDIDATES)
+            {
+                candidates[j] = candidates[j - 1];
+                scores[j] = scores[j - 1];
+            }
+        }
+        if(j < WBFE_MAX_CANDIDATES)
+        {
+            candidates[j] = i;
+            scores[j] = score;
+            if(nof_candidates < WBFE_MAX_CANDIDATES)
+            {
+                nof_candidates++;
+            }
+        }
+    }
+    while(nof_candidates > 0 && scores[nof_candidates - 1] > scores[0] + WBFE_CANDIDATE_MARGIN)
+    {
+        nof_candidates--;
+    }
+
+    // Bounding boxes at full resolution, with a margin for the pixels that
+    // are thinner than a pyramid level and the opening
+    const int32_t margin = (4 << levels) + ctx->params.open_size;
+    for(i = 0; i < nof_candidates; i++)
+    {
+        bs = &coarse->stats[candidates[i]];
+        windows[i].col = (bs->min_col << levels) - margin;
+        windows[i].row = (bs->min_row << levels) - margin;
+        windows[i].cols = ((bs->max_col + 1) << levels) + margin - windows[i].col;
+        windows[i].rows = ((bs->max_row + 1) << levels) + margin - windows[i].row;
+        WBFE_clipROI(src, &windows[i]);
+        area += windows[i].cols * windows[i].rows;
+    }
+    stageDone(ctx, WBFE_STAGE_COARSE, t);
+    if(area > src->cols * src->rows)
+    {
+        return 0;
+    }
+
+    *best_score = 1000.0f;
+    for(i = 0; i < nof_candidates; i++)
+    {
+        match = findBlobWindow(ctx, src, &windows[i], &coarse->blur_stats, &score, t);
+        if(match >= 0 && score < *best_score)
+        {
+            *best_score = score;
+            *best = ctx->stats[match];
+            *window = windows[i];
+        }
+    }
+    return *best_score < 1000.0f;
+}
+
+// Tracked search, see WBFE_evaluateContext(): the blob of ctx->track is
+// searched in a window around its expected position.
+// Returns 1 and sets *best, *window and *score if it is found there, 0
+// otherwise
+static int trackBlob(wbfe_context_t *ctx, const image_t *src, blobstats_t *best, wbfe_roi_t *window,
+                     float *score, double *t)
+{
+    const wbfe_track_t *track = ctx->track;
+    const int32_t margin[2] = {WBFE_TRACK_MARGIN + abs(track->shift[0]) / 2,
+                               WBFE_TRACK_MARGIN + abs(track->shift[1]) / 2};
+    const blobstats_t *bs;
+    int32_t match, cc, rc;
+
+    window->col = track->box.col + track->shift[0] - margin[0];
+    window->row = track->box.row + track->shift[1] - margin[1];
+    window->cols = track->box.cols + 2 * margin[0];
+    window->rows = track->box.rows + 2 * margin[1];
+    if(!WBFE_clipROI(src, window))
+    {
+        return 0;
+    }
+    match = findBlobWindow(ctx, src, window, &track->stretch, score, t);
+    if(match < 0)
+    {
+        return 0;
+    }
+
+    // Validation: the centroid, area and score are close to the expected ones
+    bs = &ctx->stats[match];
+    blobStatsCentroid(bs, &cc, &rc);
+    cc += window->col - track->centroid[0] - track->shift[0];
+    rc += window->row - track->centroid[1] - track->shift[1];
+    if(abs(cc) > margin[0] || abs(rc) > margin[1] || 4 * bs->m00 < 3 * track->area ||
+       3 * bs->m00 > 4 * track->area || *score > track->score + WBFE_TRACK_SCORE_MARGIN)
+    {
+        return 0;
+    }
+    *best = *bs;
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int WBFE_evaluateContext(wbfe_context_t *ctx,
+                         const image_t *src,
+                         const int32_t target[2],
+                               int32_t offset[2])
+{
+    const image_t *blurred;
+    const pixelstats_t *blur_stats;
+    const pixelstats_t *stretch = NULL;
+    blobstats_t best;
+    wbfe_roi_t window = {0, 0, src->cols, src->rows};
+    float score;
+    int found = 0;
+    register uint32_t i;
+    double t = 0.0;
+
+    if(ctx->timing != NULL)
+    {
+        for(i = 0; i < WBFE_NOF_STAGES; i++)
+        {
+            ctx->timing->ms[i] = 0.0;
+        }
+        ctx->timing->total_ms = 0.0;
+        t = monotonicMs();
+    }
+
+    if(ctx->track != NULL && ctx->track->valid)
+    {
+        found = trackBlob(ctx, src, &best, &window, &score, &t);
+        if(found)
+        {
+            ctx->track->hits++;
+        }
+        else
+        {
+            ctx->track->misses++;
+        }
+    }
+    if(!found && ctx->coarse != NULL)
+    {
+        found = findBlobPyramid(ctx, src, &best, &window, &score, &t);
+        stretch = &ctx->coarse->blur_stats;
+    }
+    if(!found)
+    {
+        // The working images take the size of the frame (or crop)
+        for(i = 0; i < WBFE_POOL_SIZE; i++)
+        {
+            resizePool(ctx, i, src, src->cols, src->rows);
+        }
+        blurred = blurFrame(ctx, src, &ctx->pool[WBFE_BUF_WORK], &blur_stats);
+        stageDone(ctx, WBFE_STAGE_BLUR, &t);
+        uint32_t blob_count = segmentBlobs(ctx, blurred, blur_stats, &t);
+        int32_t best_match = selectBlob(ctx, blob_count, NULL, &score);
+        stageDone(ctx, WBFE_STAGE_CLASSIFICATION, &t);
+        if(best_match == -1) {
+            // no blob passed the area threshold
+            if(ctx->track != NULL) {
+                WBFE_trackReset(ctx->track);
+            }
+            return 0;
+        }
+        found = 1;
+        best = ctx->stats[best_match];
+        window.col = 0;
+        window.row = 0;
+        stretch = blur_stats;
+    }
+
+    // 7. Calculate centroid / offset
+    int32_t cc, rc;
+    blobStatsCentroid(&best, &cc, &rc);
+    cc += window.col;
+    rc += window.row;
+    offset[0] = cc - target[0];
+    offset[1] = rc - target[1];
+    stageDone(ctx, WBFE_STAGE_CENTROID, &t);
+
+    // Track the blob in the next frame, the stretch of a tracked blob is kept
+    if(ctx->track != NULL)
+    {
+        wbfe_track_t *track = ctx->track;
+        track->valid = 1;
+        track->box.col = best.min_col + window.col;
+        track->box.row = best.min_row + window.row;
+        track->box.cols = best.max_col - best.min_col + 1;
+        track->box.rows = best.max_row - best.min_row + 1;
+        track->centroid[0] = cc;
+        track->centroid[1] = rc;
+        track->shift[0] = 0;
+        track->shift[1] = 0;
+        track->area = best.m00;
+        track->score = score;
+        if(stretch != NULL)
+        {
+            track->stretch = *stretch;
+        }
+    }
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void WBFE_trackReset(wbfe_track_t *track)
+{
+    track->valid = 0;
+    track->shift[0] = 0;
+    track->shift[1] = 0;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void WBFE_trackMove(wbfe_track_t *track,
+                    const int32_t shift[2])
+{
+    track->shift[0] += shift[0];
+    track->shift[1] += shift[1];
+}
+
+// 1 if contexts with parameters a and b have the same working images and blur
+// kernel, see WBFE_setParams()
+static int sameStructure(const wbfe_params_t *a, const wbfe_params_t *b)
+{
+    return a->kernel_size == b->kernel_size && a->sigma == b->sigma && a->separable == b->separable &&
+           a->open_size == b->open_size && a->pyramid_levels == b->pyramid_levels;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int WBFE_setParams(wbfe_context_t *ctx,
+                   const wbfe_params_t *params)
+{
+    if(!sameStructure(&ctx->params, params))
+    {
+        return 0;
+    }
+    if(params->c != ctx->params.c || params->g != ctx->params.g)
+    {
+        gammaLUT_basic(ctx->gamma_lut, params->c, params->g);
+    }
+    ctx->params = *params;
+    // the coarse context of the pyramid, scaled as in newWBFEContext()
+    if(ctx->coarse != NULL)
+    {
+        wbfe_params_t coarse = ctx->coarse->params;
+        coarse.c = params->c;
+        coarse.g = params->g;
+        coarse.threshold = params->threshold;
+        coarse.area_threshold = params->area_threshold >> (2 * params->pyramid_levels);
+        WBFE_setParams(ctx->coarse, &coarse);
+    }
+    return 1;
+}
+
+// Arguments of the bands of WBFE_evaluateBatch()
+typedef struct wbfe_batch_t
+{
+    const image_t       *frames;
+    uint32_t             nof_frames;
+    const wbfe_params_t *params;
+    uint32_t             nof_params;
+    const uint32_t      *group;       // context of each parameter set
+    uint32_t             nof_groups;
+    const int32_t       *target;
+    int32_t             *offsets;
+    uint8_t             *found;
+    int                  failed;      // a band could not allocate its contexts
+
+}wbfe_batch_t;
+
+// Evaluate items item_begin up to (not including) item_end, item
+// f * nof_params + p is frame f with parameter set p, see
+// WBFE_evaluateBatch()
+static void evaluateBatchItems(void *arg, const int32_t item_begin, const int32_t item_end)
+{
+    wbfe_batch_t *b = (wbfe_batch_t *)arg;
+    wbfe_context_t **ctx = (wbfe_context_t **)calloc(b->nof_groups, sizeof(wbfe_context_t *));
+    prepcache_t *cache = newPrepCache(b->frames[0].cols, b->frames[0].rows);
+    int ok = ctx != NULL && cache != NULL;
+    uint32_t frame = b->nof_frames;  // frame in the cache
+    register uint32_t p;
+    register int32_t item;
+
+    // the parameter sets of a frame are consecutive items, so they share the
+    // blur of the frame
+    for(item = item_begin; ok && item < item_end; item++)
+    {
+        uint32_t f = (uint32_t)item / b->nof_params;
+        uint32_t i;
+        wbfe_context_t *c;
+
+        p = (uint32_t)item % b->nof_params;
+        i = p * b->nof_frames + f;
+        c = ctx[b->group[p]];
+        if(c == NULL)
+        {
+            c = newWBFEContext(b->frames[0].cols, b->frames[0].rows, &b->params[p]);
+            if(c == NULL)
+            {
+                ok = 0;
+                break;
+            }
+            c->cache = cache;
+            ctx[b->group[p]] = c;
+        }
+        if(f != frame)
+        {
+            prepCacheNewFrame(cache);
+            frame = f;
+        }
+        WBFE_setParams(c, &b->params[p]);
+        b->found[i] = (uint8_t)WBFE_evaluateContext(c, &b->frames[f], b->target, &b->offsets[2 * i]);
+        if(!b->found[i])
+        {
+            b->offsets[2 * i] = 0;
+            b->offsets[2 * i + 1] = 0;
+        }
+    }
+    if(!ok)
+    {
+        lockBandMerge();
+        b->failed = 1;
+        unlockBandMerge();
+    }
+
+    for(p = 0; ctx != NULL && p < b->nof_groups; p++)
+    {
+        deleteWBFEContext(ctx[p]);
+    }
+    free(ctx);
+    deletePrepCache(cache);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int WBFE_evaluateBatch(const image_t *frames,
+                       const uint32_t nof_frames,
+                       const wbfe_params_t *params,
+                       const uint32_t nof_params,
+                       const int32_t target[2],
+                       int32_t *offsets,
+                       uint8_t *found)
+{
+    register uint32_t p;
+    register uint32_t q;
+
+    if(nof_frames == 0 || nof_params == 0)
+    {
+        return 1;
+    }
+    if((uint64_t)nof_frames * nof_params > INT32_MAX)
+    {
+        return 0;
+    }
+    uint32_t *group = (uint32_t *)malloc(nof_params * sizeof(uint32_t));
+    if(group == NULL)
+    {
+        return 0;
+    }
+    wbfe_batch_t b = {frames, nof_frames, params, nof_params, group, 0, target, offsets, found, 0};
+    for(p = 0; p < nof_params; p++)
+    {
+        for(q = 0; q < p && !sameStructure(&params[q], &params[p]); q++)
+        {
+        }
+        group[p] = q < p ? group[q] : b.nof_groups++;
+    }
+    parallelItems((int32_t)(nof_frames * nof_params), evaluateBatchItems, &b);
+    free(group);
+    return !b.failed;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+const char *WBFE_stageName(const eWBFEStage stage)
+{
+    if(stage < 0 || stage >= WBFE_NOF_STAGES)
+    {
+        return NULL;
+    }
+    return stage_names[stage];
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int WBFE_clipROI(const image_t *src,
+                       wbfe_roi_t *roi)
+{
+    if(roi->col < 0)
+    {
+        roi->cols += roi->col;
+        roi->col = 0;
+    }
+    if(roi->row < 0)
+    {
+        roi->rows += roi->row;
+        roi->row = 0;
+    }
+    if(roi->col + roi->cols > src->cols)
+    {
+        roi->cols = src->cols - roi->col;
+    }
+    if(roi->row + roi->rows > src->rows)
+    {
+        roi->rows = src->rows - roi->row;
+    }
+    return roi->cols > 0 && roi->rows > 0;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+image_t *WBFE_cropROI(wbfe_context_t *ctx,
+                      const image_t *src,
+                            wbfe_roi_t *roi)
+{
+    image_t *frame = &ctx->pool[WBFE_BUF_FRAME];
+    image_t view;
+
+    if(!WBFE_clipROI(src, roi))
+    {
+        return NULL;
+    }
+    subImage(src, &view, roi->col, roi->row, roi->cols, roi->rows);
+    frame->cols = roi->cols;
+    frame->rows = roi->rows;
+    frame->stride = roi->cols;
+    copy(&view, frame);
+    return frame;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void WBFE_autoROI(const int32_t target[2],
+                  const int32_t radius,
+                        wbfe_roi_t *roi)
+{
+    roi->col = target[0] - radius;
+    roi->row = target[1] - radius;
+    roi->cols = 2 * radius + 1;
+    roi->rows = 2 * radius + 1;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+ht_context_t *newHTContext(const int32_t cols,
+                           const int32_t rows,
+                           const ht_params_t *params)
+{
+    if(cols <= 0 || rows <= 0 || params->kernel_size <= 0 || params->kernel_size % 2 == 0)
+    {
+        return NULL;
+    }
+
+    ht_context_t *ctx = (ht_context_t *)calloc(1, sizeof(ht_context_t));
+    if(ctx == NULL)
+    {
+        // Unable to allocate memory for context
+        return NULL;
+    }
+    ctx->cols = cols;
+    ctx->rows = rows;
+    ctx->params = *params;
+
+    ctx->work = newBasicImage(cols, rows);
+    if(params->separable)
+    {
+        ctx->blur = newInt16Image(cols, rows);
+        ctx->kernel = newInt16Image(params->kernel_size, 1);
+    }
+    else
+    {
+        ctx->kernel = newFloatImage(params->kernel_size, params->kernel_size);
+    }
+    ctx->hough_ws = newHoughWorkspace(cols, rows);
+    if(ctx->work == NULL || (params->separable && ctx->blur == NULL) || ctx->kernel == NULL ||
+       ctx->hough_ws == NULL)
+    {
+        deleteHTContext(ctx);
+        return NULL;
+    }
+
+    // Precalculate the gaussian kernel and gamma look up table
+    if(params->separable)
+    {
+        gaussianKernel1D(ctx->kernel, params->sigma);
+    }
+    else
+    {
+        gaussianKernel(ctx->kernel, params->sigma);
+    }
+    gammaLUT_basic(ctx->gamma_lut, params->c, params->g);
+
+    return ctx;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteHTContext(ht_context_t *ctx)
+{
+    if(ctx == NULL)
+    {
+        return;
+    }
+    if(ctx->work != NULL)
+    {
+        deleteImage(ctx->work);
+    }
+    if(ctx->blur != NULL)
+    {
+        deleteImage(ctx->blur);
+    }
+    if(ctx->kernel != NULL)
+    {
+        deleteImage(ctx->kernel);
+    }
+    deleteHoughWorkspace(ctx->hough_ws);
+    free(ctx);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int HT_evaluateContext(ht_context_t *ctx,
+                       const image_t *src,
+                       const int32_t target[2],
+                             float offset[2])
+{
+    image_t *work = ctx->work;
+    const image_t *preprocessed = NULL;
+    houghcircle_t circle;
+
+    // The working images take the size of the frame (or crop)
+    work->cols = src->cols;
+    work->rows = src->rows;
+    work->stride = src->cols;
+    if(ctx->blur != NULL)
+    {
+        ctx->blur->cols = src->cols;
+        ctx->blur->rows = src->rows;
+        ctx->blur->stride = src->cols;
+    }
+
+    // 1. - 3. from the cache if another context preprocessed the frame with
+    // the same parameters
+    if(ctx->cache != NULL)
+    {
+        prepparams_t prep = {ctx->params.kernel_size, ctx->params.sigma, ctx->params.separable, ctx->params.c,
+                             ctx->params.g};
+        preprocessed = prepCacheGamma(ctx->cache, src, &prep, ctx->kernel, ctx->blur, ctx->gamma_lut);
+    }
+    if(preprocessed == NULL)
+    {
+        // 1. Gaussian blur
+        if(ctx->params.separable)
+        {
+            separableConvolutionStats(src, work, ctx->blur, ctx->kernel, &ctx->blur_stats);
+        }
+        else
+        {
+            convolutionStats(src, work, ctx->kernel, &ctx->blur_stats);
+        }
+
+        // 2. Contrast stretch with the min and max of the blur, 3. gamma
+        contrastStretchFastStats(work, work, &ctx->blur_stats);
+        applyLUT(work, work, ctx->gamma_lut);
+        preprocessed = work;
+    }
+
+    // 4. Hough transform, the circle with the most votes is the well
+    if(houghCircles(preprocessed, ctx->hough_ws, &ctx->params.hough, &circle, 1) == 0)
+    {
+        return 0;
+    }
+    offset[0] = target[0] - circle.col;
+    offset[1] = target[1] - circle.row;
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
@@ -0,0 +1,377 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the C implementations of the well position
+ *              evaluators
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision: well bottom features evaluator context
+    > Separable fixed point gaussian blur option
+    > Union-find blob labelling into an int16 label image
+    > Blob classification from single pass blob statistics
+    > Flood fill hole filling
+    > Region of interest evaluation
+    > Regions of interest are evaluated as views into the frame
+    > Optional per stage timing of the pipeline
+    > Contexts can be used from different threads
+    > Optional elliptical opening after the threshold
+    > Hough transform evaluator context
+    > Optional frame preprocessing cache shared between contexts
+    > Optional coarse to fine search on a gaussian pyramid
+    > Optional tracking of the blob between frames
+    > Batch evaluation of frame sets with parameter sets
+
+******************************************************************************/
+#ifndef _EVALUATORS_H_
+#define _EVALUATORS_H_
+
+#include "stdint.h"
+#include "operators.h"
+#include "morphology.h"
+#include "hough.h"
+#include "prepcache.h"
+
+// ----------------------------------------------------------------------------
+// Defines
+// ----------------------------------------------------------------------------
+
+// Maximum wbfe_params_t.pyramid_levels
+#define WBFE_MAX_PYRAMID_LEVELS  2
+
+// Working images owned by a well bottom features evaluator context
+// (index into wbfe_context_t.pool)
+typedef enum
+{
+    WBFE_BUF_FRAME = 0, // private copy of the frame or region of interest
+    WBFE_BUF_WORK,      // blur output, all later stages work in place on it
+    WBFE_BUF_BLUR,      // int16 horizontal pass of the separable blur
+    WBFE_BUF_LABELS,    // int16 blob labels
+    WBFE_BUF_BINARY,    // bit-packed threshold output for the opening
+    WBFE_BUF_WINDOW,    // blur of a window of the frame, see
+                        // WBFE_evaluateContext()
+
+    WBFE_POOL_SIZE
+
+}eWBFEBuffer;
+
+// Pipeline stages timed by WBFE_evaluateContext()
+// (index into wbfe_timing_t.ms, see WBFE_stageName())
+typedef enum
+{
+    WBFE_STAGE_BLUR = 0,
+    WBFE_STAGE_STRETCH,         // 0, fused into WBFE_STAGE_THRESHOLD
+    WBFE_STAGE_GAMMA,           // 0, fused into WBFE_STAGE_THRESHOLD
+    WBFE_STAGE_THRESHOLD,       // stretch, gamma and threshold, see stretchLUTThreshold()
+    WBFE_STAGE_OPEN,            // only timed if params.open_size > 0
+    WBFE_STAGE_FILL_HOLES,
+    WBFE_STAGE_LABELLING,
+    WBFE_STAGE_CLASSIFICATION,  // blob statistics and scoring
+    WBFE_STAGE_CENTROID,
+    WBFE_STAGE_COARSE,          // pyramid and coarse search, only timed if
+                                // params.pyramid_levels > 0
+
+    WBFE_NOF_STAGES
+
+}eWBFEStage;
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Evaluation parameters, see WellBottomFeaturesEvaluator in
+// well_position_evaluators.py
+typedef struct wbfe_params_t
+{
+    int32_t kernel_size;     // gaussian blur kernel size (odd)
+    double  sigma;           // gaussian blur sigma
+    float   c;               // gamma constant
+    float   g;               // gamma
+    int32_t threshold;       // pixels with a value up to this value are selected
+    int32_t area_threshold;  // blobs smaller than this area are ignored
+    int32_t separable;       // 1: separable fixed point blur, 0: 2D float convolution
+    int32_t open_size;       // elliptical opening of open_size x open_size after the
+                             // threshold, 0: off
+    int32_t pyramid_levels;  // search the blobs in the frame downsampled this many
+                             // times (see pyramidDown()) and refine the centroid
+                             // of the best one at full resolution, 0: off
+
+}wbfe_params_t;
+
+// Region of interest in frame pixel coordinates
+typedef struct wbfe_roi_t
+{
+    int32_t col;   // left column
+    int32_t row;   // top row
+    int32_t cols;
+    int32_t rows;
+
+}wbfe_roi_t;
+
+// Monotonic clock timings of one evaluation in milliseconds
+// Stages that were not reached (no blob found) are 0.
+typedef struct wbfe_timing_t
+{
+    double ms[WBFE_NOF_STAGES];
+    double total_ms;             // sum of the stages
+
+}wbfe_timing_t;
+
+// Tracking state of the blob found by a well bottom features evaluator
+// context, see WBFE_evaluateContext(). The coordinates are src coordinates,
+// so the same frame size (or roi) must be evaluated every time.
+typedef struct wbfe_track_t
+{
+    int32_t       valid;         // the fields below describe the blob of the
+                                 // last evaluation
+    wbfe_roi_t    box;           // bounding box of the blob
+    int32_t       centroid[2];
+    int32_t       shift[2];      // expected move of the blob since then,
+                                 // see WBFE_trackMove()
+    uint32_t      area;          // number of pixels
+    float         score;         // classification score, lower is better
+    pixelstats_t  stretch;       // statistics for the contrast stretch
+    uint32_t      hits;          // evaluations that were tracked
+    uint32_t      misses;        // evaluations with a full search because
+                                 // the blob was not found where predicted
+
+}wbfe_track_t;
+
+// Well bottom features evaluator context
+// Everything that only depends on the resolution and the parameters is
+// allocated and calculated once, so evaluating a frame does not allocate
+// any memory.
+// A context must only be used by one thread at a time. The pipeline has no
+// other (static) state, so different contexts can evaluate frames in parallel.
+typedef struct wbfe_context_t
+{
+    int32_t       cols;
+    int32_t       rows;
+    wbfe_params_t params;
+
+    image_t       pool[WBFE_POOL_SIZE]; // working images, pixel data lives in arena
+    uint8_t      *arena;
+
+    image_t      *kernel;               // gaussian blur kernel
+                                        // (int16 1D kernel if params.separable)
+    basic_pixel_t gamma_lut[256];       // gamma look up table
+    pixelstats_t  blur_stats;           // statistics of the blur output
+    labelworkspace_t *label_ws;         // blob labelling runs
+    blobstats_t  *stats;                // MAX_INT16_LABELS blob statistics
+    uint32_t     *fill_queue;           // cols * rows hole filling queue
+    morphworkspace_t *open_ws;          // opening, NULL if params.open_size is 0
+    wbfe_timing_t *timing;              // set by the user to time the stages of
+                                        // each evaluation, NULL (default): off
+    prepcache_t  *cache;                // set by the user to share the blur of a
+                                        // frame with other contexts, NULL
+                                        // (default): off
+    wbfe_track_t *track;                // set by the user to track the blob
+                                        // between frames, NULL (default): off
+    image_t      *pyramid[WBFE_MAX_PYRAMID_LEVELS]; // downsampled frames
+    struct wbfe_context_t *coarse;      // context of the smallest pyramid
+                                        // level, NULL if params.pyramid_levels
+                                        // is 0
+
+}wbfe_context_t;
+
+// Hough transform evaluation parameters, see HoughTransformEvaluator in
+// well_position_evaluators.py
+typedef struct ht_params_t
+{
+    int32_t kernel_size;     // gaussian blur kernel size (odd)
+    double  sigma;           // gaussian blur sigma
+    float   c;               // gamma constant
+    float   g;               // gamma
+    int32_t separable;       // 1: separable fixed point blur, 0: 2D float convolution
+    houghparams_t hough;     // circle detection, see houghCircles()
+
+}ht_params_t;
+
+// Hough transform evaluator context, see wbfe_context_t
+typedef struct ht_context_t
+{
+    int32_t       cols;
+    int32_t       rows;
+    ht_params_t   params;
+
+    image_t      *work;                 // blur output, stretch and gamma in place
+    image_t      *blur;                 // int16 horizontal pass of the separable blur
+    image_t      *kernel;               // gaussian blur kernel
+                                        // (int16 1D kernel if params.separable)
+    basic_pixel_t gamma_lut[256];       // gamma look up table
+    pixelstats_t  blur_stats;           // statistics of the blur output
+    houghworkspace_t *hough_ws;
+    prepcache_t  *cache;                // set by the user to share the blur,
+                                        // stretch and gamma of a frame with
+                                        // other contexts, NULL (default): off
+
+}ht_context_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Create an evaluator context for frames of cols x rows pixels
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling deleteWBFEContext()
+//                Returns NULL if memory could not be allocated
+wbfe_context_t *newWBFEContext( const int32_t cols
+                              , const int32_t rows
+                              , const wbfe_params_t *params
+                              );
+
+void deleteWBFEContext( wbfe_context_t *ctx );
+
+// Run the well bottom features pipeline on a frame
+// offset is set to the (x, y) offset of the best matching blob centroid
+// relative to target. Returns 1 if a blob was found, 0 otherwise.
+// The working images take the size of src, so a crop returned by
+// WBFE_cropROI() can be evaluated as well.
+// With params.pyramid_levels > 0 the candidate blobs are searched in the
+// downsampled frame with the blur, area and opening scaled to its size. Only
+// a window around each candidate is then evaluated at full resolution: it is
+// blurred with a margin so its pixels are the same as in a blur of the whole
+// frame, and the stretch uses the statistics of the coarse blur. The best
+// blob of the windows is selected. The whole frame is evaluated if no window
+// has a blob, or if the windows cover more pixels than the frame.
+// With ctx->track set and valid, the blob of the last evaluation is first
+// searched at full resolution in a window around its expected position (its
+// last position plus the shift of WBFE_trackMove()), with the contrast
+// stretch of the last evaluation. It is accepted if its centroid is close to
+// the expected centroid and its area and score are close to the last ones;
+// otherwise the frame is searched as above. The state is updated after every
+// evaluation.
+//
+// Precondition : src is a basic image (or view) of at most ctx->cols x
+//                ctx->rows pixels
+//                src is not modified
+// Postcondition: -
+int WBFE_evaluateContext( wbfe_context_t *ctx
+                        , const image_t *src
+                        , const int32_t target[2]
+                        ,       int32_t offset[2]
+                        );
+
+// Forget the tracked blob, eg. after a move of unknown size
+//
+// Precondition : -
+// Postcondition: the next evaluation with track searches the whole frame
+void WBFE_trackReset( wbfe_track_t *track );
+
+// Add the expected move of the blob in pixels since the last evaluation, eg.
+// the correction that was sent to the motors converted to pixels
+//
+// Precondition : -
+// Postcondition: -
+void WBFE_trackMove( wbfe_track_t *track
+                   , const int32_t shift[2]
+                   );
+
+// Change the parameters that do not change the working images or the blur
+// kernel: c, g, threshold and area_threshold. Returns 0 and leaves ctx
+// unchanged if one of the other parameters differs from ctx->params.
+//
+// Precondition : ctx is not used by another thread
+// Postcondition: -
+int WBFE_setParams( wbfe_context_t *ctx
+                  , const wbfe_params_t *params
+                  );
+
+// Evaluate every frame with every parameter set, for offline tuning of the
+// parameters on logged frames. The result of frames[f] with params[p] is
+// stored in offset pair p * nof_frames + f of offsets and in the same element
+// of found (see WBFE_evaluateContext(), the offset is 0, 0 if no blob was
+// found). Every frame with every parameter set is one item, the items are
+// split into bands that run on the thread pool (see parallelItems()), so a
+// small batch or a single frame with many parameter sets uses all threads as
+// well. Each band has one context for each combination of blur, opening and
+// pyramid parameters and a frame cache, so the parameter sets of a frame
+// with the same blur share the blur within a band.
+// Returns 0 if memory could not be allocated or there are more than
+// INT32_MAX items, 1 otherwise.
+//
+// Precondition : the frames are basic images (or views) of the same size
+// Postcondition: -
+int WBFE_evaluateBatch( const image_t *frames
+                      , const uint32_t nof_frames
+                      , const wbfe_params_t *params
+                      , const uint32_t nof_params
+                      , const int32_t target[2]
+                      ,       int32_t *offsets
+                      ,       uint8_t *found
+                      );
+
+// Name of a pipeline stage, eg. "fill_holes"
+//
+// Precondition : -
+// Postcondition: Returns NULL if stage is not a valid stage
+const char *WBFE_stageName( const eWBFEStage stage );
+
+// Clip a region of interest to src
+// Evaluate a view of the roi (see subImage()) with the target converted to
+// roi coordinates (target - roi origin); the offset is then the same as for
+// the full frame.
+//
+// Precondition : -
+// Postcondition: Returns 0 if the clipped roi is empty, 1 otherwise
+int WBFE_clipROI( const image_t *src
+                ,       wbfe_roi_t *roi
+                );
+
+// Clip a region of interest to src and copy it into the WBFE_BUF_FRAME image,
+// for frames that can change during the evaluation. See WBFE_clipROI().
+//
+// Precondition : src is a basic image of at most ctx->cols x ctx->rows pixels
+//                src is not the WBFE_BUF_FRAME image
+// Postcondition: Returns the crop or NULL if the clipped roi is empty
+image_t *WBFE_cropROI( wbfe_context_t *ctx
+                     , const image_t *src
+                     ,       wbfe_roi_t *roi
+                     );
+
+// Region of interest of radius pixels around target in all directions
+//
+// Precondition : -
+// Postcondition: -
+void WBFE_autoROI( const int32_t target[2]
+                 , const int32_t radius
+                 ,       wbfe_roi_t *roi
+                 );
+
+// Create a Hough transform evaluator context for frames of cols x rows pixels
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling deleteHTContext()
+//                Returns NULL if memory could not be allocated
+ht_context_t *newHTContext( const int32_t cols
+                          , const int32_t rows
+                          , const ht_params_t *params
+                          );
+
+void deleteHTContext( ht_context_t *ctx );
+
+// Run the Hough transform pipeline on a frame: blur, contrast stretch, gamma
+// and houghCircles()
+// offset is set to target - center of the circle with the most votes (the
+// sign and subpixel center of cv2.HoughCircles() in HoughTransformEvaluator).
+// Returns 1 if a circle was found, 0 otherwise.
+//
+// Precondition : src is a basic image (or view) of at most ctx->cols x
+//                ctx->rows pixels
+//                src is not modified
+// Postcondition: -
+int HT_evaluateContext( ht_context_t *ctx
+                      , const image_t *src
+                      , const int32_t target[2]
+                      ,       float offset[2]
+                      );
+
+#endif // _EVALUATORS_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
@@ -0,0 +1,186 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the raw frame archive of logged runs
+ *
+ *              The file is mapped read only (mmap, or a file mapping on
+ *              windows), the frames are views into the mapping.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "framearchive.h"
+#include "stdlib.h"
+#include "string.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// Map the whole file read only, returns NULL on failure
+static const uint8_t *mapFile(const char *path, size_t *size, void **handle)
+{
+#ifdef _WIN32
+    LARGE_INTEGER length;
+    const uint8_t *map = NULL;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return NULL;
+    }
+    *handle = NULL;
+    if(GetFileSizeEx(file, &length) && length.QuadPart > 0)
+    {
+        *handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if(*handle == NULL)
+    {
+        return NULL;
+    }
+    map = (const uint8_t *)MapViewOfFile(*handle, FILE_MAP_READ, 0, 0, 0);
+    if(map == NULL)
+    {
+        CloseHandle(*handle);
+        return NULL;
+    }
+    *size = (size_t)length.QuadPart;
+    return map;
+#else
+    struct stat st;
+    void *map;
+    int fd = open(path, O_RDONLY);
+    *handle = NULL;
+    if(fd < 0)
+    {
+        return NULL;
+    }
+    if(fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the file is closed
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return (const uint8_t *)map;
+#endif
+}
+
+static void unmapFile(const uint8_t *map, const size_t size, void *handle)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(map);
+    CloseHandle(handle);
+#else
+    (void)handle;
+    munmap((void *)map, size);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+framearchive_t *openFrameArchive(const char *path)
+{
+    framearchive_header_t header;
+
+    framearchive_t *archive = (framearchive_t *)calloc(1, sizeof(framearchive_t));
+    if(archive == NULL)
+    {
+        return NULL;
+    }
+    archive->map = mapFile(path, &archive->map_size, &archive->handle);
+    if(archive->map == NULL || archive->map_size < FRAMEARCHIVE_HEADER_SIZE)
+    {
+        closeFrameArchive(archive);
+        return NULL;
+    }
+    memcpy(&header, archive->map, sizeof(header));
+    // the records must hold the pixels of the type, binary images are not
+    // supported (their rows are words)
+    if(header.magic != FRAMEARCHIVE_MAGIC || header.version != FRAMEARCHIVE_VERSION ||
+       header.cols <= 0 || header.rows <= 0 || header.type == IMGTYPE_BINARY ||
+       header.type < IMGTYPE_BASIC || header.type > IMGTYPE_RGB565 ||
+       header.frame_size < (uint64_t)header.cols * header.rows * pixelSize((eImageType)header.type) ||
+       header.record_size < FRAMEARCHIVE_META_SIZE + (uint64_t)header.frame_size ||
+       header.record_size % FRAMEARCHIVE_ALIGN != 0)
+    {
+        closeFrameArchive(archive);
+        return NULL;
+    }
+    archive->cols = header.cols;
+    archive->rows = header.rows;
+    archive->type = (eImageType)header.type;
+    archive->record_size = header.record_size;
+    archive->nof_frames = (uint32_t)((archive->map_size - FRAMEARCHIVE_HEADER_SIZE) / header.record_size);
+    return archive;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void closeFrameArchive(framearchive_t *archive)
+{
+    if(archive == NULL)
+    {
+        return;
+    }
+    if(archive->map != NULL)
+    {
+        unmapFile(archive->map, archive->map_size, archive->handle);
+    }
+    free(archive);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int frameArchiveFrame(const framearchive_t *archive,
+                      const uint32_t i,
+                      image_t *img)
+{
+    if(i >= archive->nof_frames)
+    {
+        return 0;
+    }
+    img->cols = archive->cols;
+    img->rows = archive->rows;
+    img->stride = archive->cols;
+    img->view = IMGVIEW_CLIP;
+    img->type = archive->type;
+    img->data = (uint8_t *)archive->map + FRAMEARCHIVE_HEADER_SIZE + (size_t)i * archive->record_size +
+                FRAMEARCHIVE_META_SIZE;
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+const framearchive_meta_t *frameArchiveMeta(const framearchive_t *archive,
+                                            const uint32_t i)
+{
+    if(i >= archive->nof_frames)
+    {
+        return NULL;
+    }
+    return (const framearchive_meta_t *)(archive->map + FRAMEARCHIVE_HEADER_SIZE + (size_t)i * archive->record_size);
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
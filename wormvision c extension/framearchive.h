@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the raw frame archive of logged runs
+ *
+ *              An archive is an append only file: a header with the frame
+ *              size and type, followed by one fixed size record per frame.
+ *              A record is the metadata of the evaluation (timestamp,
+ *              setpoint, target and offsets) and the raw pixels, padded to
+ *              FRAMEARCHIVE_ALIGN bytes so every frame starts at an aligned
+ *              offset. The archive is written by the logger of the controller
+ *              (see frame_archive.py) and read through a read only memory
+ *              map, so the frames are views into the file without a copy.
+ *
+ *              File layout, little endian, all sizes in bytes:
+ *                0                         framearchive_header_t
+ *                FRAMEARCHIVE_HEADER_SIZE  record 0: framearchive_meta_t,
+ *                                          then frame_size pixel bytes and
+ *                                          padding up to record_size
+ *                ...                       record 1, 2, ...
+ *              A partly written record at the end of the file (eg. after a
+ *              power failure) is ignored, and overwritten by the next record
+ *              that is appended. The file never shrinks, so an archive can
+ *              stay open (mapped) while a writer appends to it: the part of
+ *              the file that was seen when it was opened is never cut off.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _FRAMEARCHIVE_H_
+#define _FRAMEARCHIVE_H_
+
+#include "stdint.h"
+#include "stddef.h"
+#include "operators.h"
+
+// ----------------------------------------------------------------------------
+// Defines
+// ----------------------------------------------------------------------------
+
+#define FRAMEARCHIVE_MAGIC        0x41465657u  // "WVFA"
+#define FRAMEARCHIVE_VERSION      1
+#define FRAMEARCHIVE_HEADER_SIZE  64
+#define FRAMEARCHIVE_META_SIZE    64
+#define FRAMEARCHIVE_ALIGN        64
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// First FRAMEARCHIVE_HEADER_SIZE bytes of the file
+typedef struct framearchive_header_t
+{
+    uint32_t  magic;                  // FRAMEARCHIVE_MAGIC
+    uint32_t  version;                // FRAMEARCHIVE_VERSION
+    int32_t   cols;                   // frame size
+    int32_t   rows;
+    int32_t   type;                   // eImageType of the frames
+    uint32_t  frame_size;             // pixel bytes of a frame
+    uint32_t  record_size;            // FRAMEARCHIVE_META_SIZE + frame_size,
+                                      // rounded up to FRAMEARCHIVE_ALIGN
+    uint8_t   reserved[36];
+
+}framearchive_header_t;
+
+// Metadata of a frame, first FRAMEARCHIVE_META_SIZE bytes of its record
+typedef struct framearchive_meta_t
+{
+    double    timestamp;              // seconds since the epoch
+    float     setpoint[2];            // mm
+    int32_t   target[2];              // pixel coordinates
+    float     offset[2];              // total weighted offset in pixels
+    float     offset_mm[2];           // total weighted offset in mm
+    uint32_t  passed;                 // 1: within the maximum offset
+    uint8_t   reserved[20];
+
+}framearchive_meta_t;
+
+// Archive opened by openFrameArchive()
+typedef struct framearchive_t
+{
+    int32_t      cols;
+    int32_t      rows;
+    eImageType   type;
+    uint32_t     nof_frames;          // complete records when it was opened
+    uint32_t     record_size;
+    const uint8_t *map;               // the mapped file
+    size_t       map_size;
+    void        *handle;              // file mapping object on windows
+
+}framearchive_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Open an archive read only and map it into memory. Frames that are appended
+// later are not seen, open the archive again to read them.
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling
+//                closeFrameArchive(), returns NULL if the file can not be
+//                opened or mapped, or is not a valid archive
+framearchive_t *openFrameArchive( const char *path );
+void closeFrameArchive( framearchive_t *archive );
+
+// Frame i of the archive as an image that points into the mapped file, the
+// pixels must not be written. Returns 0 if i is out of range.
+//
+// Precondition : -
+// Postcondition: img is valid until closeFrameArchive()
+int frameArchiveFrame( const framearchive_t *archive
+                     , const uint32_t i
+                     ,       image_t *img
+                     );
+
+// Metadata of frame i, NULL if i is out of range
+//
+// Precondition : -
+// Postcondition: the metadata is valid until closeFrameArchive()
+const framearchive_meta_t *frameArchiveMeta( const framearchive_t *archive
+                                           , const uint32_t i
+                                           );
+
+#endif // _FRAMEARCHIVE_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
@@ -0,0 +1,178 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the ring buffer of camera frames
+ *
+ *              The slot that is written has sequence number 0, so readers
+ *              never pick it. The pixels are written and read without the
+ *              lock: the slot bookkeeping guarantees that a slot is never
+ *              written and read at the same time.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "framering.h"
+#include "stdlib.h"
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+framering_t *newFrameRing(const int32_t cols,
+                          const int32_t rows,
+                          const uint32_t nof_slots)
+{
+    register uint32_t i;
+
+    if(cols <= 0 || rows <= 0 || nof_slots < 3 || nof_slots > FRAMERING_MAX_SLOTS)
+    {
+        return NULL;
+    }
+    framering_t *ring = (framering_t *)calloc(1, sizeof(framering_t));
+    if(ring == NULL)
+    {
+        return NULL;
+    }
+    ring->cols = cols;
+    ring->rows = rows;
+    ring->nof_slots = nof_slots;
+    ring->writing = nof_slots;
+    ring->lock = newLock();
+    if(ring->lock == NULL)
+    {
+        deleteFrameRing(ring);
+        return NULL;
+    }
+    for(i = 0; i < nof_slots; i++)
+    {
+        ring->slots[i] = newBasicImage(cols, rows);
+        if(ring->slots[i] == NULL)
+        {
+            deleteFrameRing(ring);
+            return NULL;
+        }
+    }
+    return ring;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteFrameRing(framering_t *ring)
+{
+    register uint32_t i;
+
+    if(ring == NULL)
+    {
+        return;
+    }
+    for(i = 0; i < ring->nof_slots; i++)
+    {
+        if(ring->slots[i] != NULL)
+        {
+            deleteImage(ring->slots[i]);
+        }
+    }
+    deleteLock(ring->lock);
+    free(ring);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+image_t *frameRingBeginWrite(framering_t *ring)
+{
+    register uint32_t i;
+    register uint32_t slot = ring->nof_slots;
+
+    acquireLock(ring->lock);
+    if(ring->writing == ring->nof_slots)
+    {
+        for(i = 0; i < ring->nof_slots; i++)
+        {
+            if(ring->readers[i] == 0 && (ring->seq[i] != ring->newest || ring->seq[i] == 0) &&
+               (slot == ring->nof_slots || ring->seq[i] < ring->seq[slot]))
+            {
+                slot = i;
+            }
+        }
+    }
+    if(slot == ring->nof_slots)
+    {
+        ring->dropped++;
+        releaseLock(ring->lock);
+        return NULL;
+    }
+    ring->writing = slot;
+    ring->seq[slot] = 0;
+    releaseLock(ring->lock);
+    return ring->slots[slot];
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint64_t frameRingEndWrite(framering_t *ring)
+{
+    uint64_t seq;
+
+    acquireLock(ring->lock);
+    seq = ++ring->newest;
+    ring->seq[ring->writing] = seq;
+    ring->writing = ring->nof_slots;
+    notifyLock(ring->lock);
+    releaseLock(ring->lock);
+    return seq;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int32_t frameRingAcquire(framering_t *ring,
+                         const uint64_t after,
+                         const int32_t timeout_ms,
+                         uint64_t *seq)
+{
+    register uint32_t i;
+    // the wakeups of frames that other readers took do not extend the timeout
+    const double deadline = monotonicMs() + timeout_ms;
+    int32_t remaining = timeout_ms;
+
+    acquireLock(ring->lock);
+    while(ring->newest <= after)
+    {
+        if(timeout_ms >= 0)
+        {
+            remaining = (int32_t)(deadline - monotonicMs() + 0.999);
+            if(remaining <= 0)
+            {
+                releaseLock(ring->lock);
+                return -1;
+            }
+        }
+        if(!waitLock(ring->lock, remaining) && ring->newest <= after)
+        {
+            releaseLock(ring->lock);
+            return -1;
+        }
+    }
+    // the newest frame is never overwritten
+    for(i = 0; ring->seq[i] != ring->newest; i++)
+    {
+    }
+    ring->readers[i]++;
+    *seq = ring->newest;
+    releaseLock(ring->lock);
+    return (int32_t)i;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void frameRingRelease(framering_t *ring, const int32_t slot)
+{
+    acquireLock(ring->lock);
+    ring->readers[slot]--;
+    releaseLock(ring->lock);
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
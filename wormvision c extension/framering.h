@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the ring buffer of camera frames
+ *
+ *              The camera thread writes every frame into a preallocated slot
+ *              and the controller reads the newest frame, so a frame is
+ *              evaluated while the next one is captured. A slot is not
+ *              written while it is read; the newest frame is never
+ *              overwritten, so a reader can always get it. If all other
+ *              slots are being read the frame is dropped.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _FRAMERING_H_
+#define _FRAMERING_H_
+
+#include "stdint.h"
+#include "operators.h"
+#include "threads.h"
+
+// ----------------------------------------------------------------------------
+// Defines
+// ----------------------------------------------------------------------------
+
+// Maximum number of slots of a ring
+#define FRAMERING_MAX_SLOTS  8
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Ring of grayscale frames, see newFrameRing()
+typedef struct framering_t
+{
+    int32_t   cols;                          // frame size
+    int32_t   rows;
+    uint32_t  nof_slots;
+    image_t  *slots[FRAMERING_MAX_SLOTS];
+    uint64_t  seq[FRAMERING_MAX_SLOTS];      // sequence number of the frame in
+                                             // the slot, 0 if it is empty
+    uint32_t  readers[FRAMERING_MAX_SLOTS];  // see frameRingAcquire()
+    uint32_t  writing;                       // slot that is written or
+                                             // nof_slots
+    uint64_t  newest;                        // sequence number of the newest
+                                             // frame, 0 before the first one
+    uint64_t  dropped;                       // frames without a free slot
+    lock_t   *lock;                          // protects all fields above
+
+}framering_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Create a ring of nof_slots (3 to FRAMERING_MAX_SLOTS) basic images of cols x
+// rows pixels: one for the writer, the newest frame and the frames that are
+// being read
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling deleteFrameRing()
+//                when no slot is being read or written, returns NULL if memory
+//                could not be allocated or nof_slots is out of range
+framering_t *newFrameRing( const int32_t cols
+                         , const int32_t rows
+                         , const uint32_t nof_slots
+                         );
+void deleteFrameRing( framering_t *ring );
+
+// Slot for the next frame: the oldest slot that is not the newest frame and
+// not being read. Returns NULL (and counts a dropped frame) if there is no free
+// slot, or if another write is in progress. The frame is published by
+// frameRingEndWrite(), readers wait until then.
+//
+// Precondition : -
+// Postcondition: if a slot is returned frameRingEndWrite() must be called
+image_t *frameRingBeginWrite( framering_t *ring );
+
+// Publish the frame of frameRingBeginWrite() as the newest frame and wake the
+// readers. Returns the sequence number of the frame, the first frame is 1.
+//
+// Precondition : frameRingBeginWrite() returned a slot
+// Postcondition: -
+uint64_t frameRingEndWrite( framering_t *ring );
+
+// Newest frame with a sequence number larger than after, waits at most
+// timeout_ms milliseconds (forever if negative) for it. Returns the slot index
+// and sets *seq, or returns -1 on a timeout. The slot is not written until it
+// is released, the image is ring->slots[slot].
+//
+// Precondition : -
+// Postcondition: frameRingRelease() must be called for the returned slot
+int32_t frameRingAcquire( framering_t *ring
+                        , const uint64_t after
+                        , const int32_t timeout_ms
+                        , uint64_t *seq
+                        );
+void frameRingRelease( framering_t *ring, const int32_t slot );
+
+#endif // _FRAMERING_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
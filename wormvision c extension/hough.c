@@ -0,0 +1,469 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the Hough circle transform
+ *
+ *              Follows the HOUGH_GRADIENT method of opencv 3 with dp = 1:
+ *
+ *              1. 3x3 sobel gradients with a replicated border and Canny edges
+ *                 with the L1 magnitude, thresholds param1 / 2 and param1.
+ *              2. Every edge pixel votes for the centers along its gradient,
+ *                 in both directions, between min_radius and max_radius. The
+ *                 line is stepped in fixed point with 10 fraction bits.
+ *              3. The centers are the accumulator values above acc_threshold
+ *                 that are larger than their 4 neighbours, the most votes
+ *                 first.
+ *              4. The radius of a center is picked from the sorted distances
+ *                 to all edge pixels between min_radius and max_radius: the
+ *                 group of distances (1 pixel apart) with the most pixels per
+ *                 unit of radius. The circle is accepted if that group has
+ *                 more than acc_threshold pixels and the center is at least
+ *                 min_distance from the centers of the accepted circles.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "hough.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include "float.h"
+
+#define HOUGH_SHIFT  (10)
+#define CANNY_SHIFT  (15)
+#define CANNY_TG22   ((int32_t)(0.4142135623730950488 * (1 << CANNY_SHIFT) + 0.5))
+
+// Canny edge map values
+#define EDGE_CANDIDATE (0)   // local maximum above the low threshold
+#define EDGE_NONE      (1)
+#define EDGE_STRONG    (2)
+
+// 3x3 sobel derivatives of img with a replicated border
+static void sobel3x3(const image_t *img, image_t *dx, image_t *dy)
+{
+    register int32_t col;
+    register int32_t row;
+    register int32_t l;
+    register int32_t r;
+    register const basic_pixel_t *above;
+    register const basic_pixel_t *cur;
+    register const basic_pixel_t *below;
+    register int16_pixel_t *gx;
+    register int16_pixel_t *gy;
+
+    for(row = 0; row < img->rows; row++)
+    {
+        above = BASIC_ROW(img, row > 0 ? row - 1 : 0);
+        cur = BASIC_ROW(img, row);
+        below = BASIC_ROW(img, row < img->rows - 1 ? row + 1 : row);
+        gx = INT16_ROW(dx, row);
+        gy = INT16_ROW(dy, row);
+        for(col = 0; col < img->cols; col++)
+        {
+            l = col > 0 ? col - 1 : 0;
+            r = col < img->cols - 1 ? col + 1 : col;
+            gx[col] = (int16_pixel_t)((above[r] - above[l]) + 2 * (cur[r] - cur[l]) + (below[r] - below[l]));
+            gy[col] = (int16_pixel_t)((below[l] + 2 * below[col] + below[r]) - (above[l] + 2 * above[col] + above[r]));
+        }
+    }
+}
+
+// Canny edges of the gradients of ws, the same result as
+// cv2.Canny(img, low, high, apertureSize=3, L2gradient=False)
+// Returns the number of edge pixels, the edge pixels are stored in ws->points
+// as row * cols + col
+static uint32_t cannyEdges(houghworkspace_t *ws,
+                           const int32_t cols,
+                           const int32_t rows,
+                           const int32_t low,
+                           const int32_t high)
+{
+    register const int32_t step = cols + 2;
+    register int32_t col;
+    register int32_t row;
+    register int32_t m;
+    register int32_t x;
+    register int32_t y;
+    register int32_t tg22x;
+    register int32_t s;
+    register const int16_pixel_t *gx;
+    register const int16_pixel_t *gy;
+    register const int32_t *mag;
+    register uint8_t *edge;
+    register uint32_t top = 0;
+    register uint32_t n = 0;
+    uint32_t i;
+
+    // gradient magnitudes with a zero border
+    memset(ws->mag, 0, step * sizeof(int32_t));
+    memset(ws->mag + (rows + 1) * step, 0, step * sizeof(int32_t));
+    for(row = 0; row < rows; row++)
+    {
+        gx = INT16_ROW(ws->dx, row);
+        gy = INT16_ROW(ws->dy, row);
+        ws->mag[(row + 1) * step] = 0;
+        ws->mag[(row + 1) * step + cols + 1] = 0;
+        for(col = 0; col < cols; col++)
+        {
+            ws->mag[(row + 1) * step + col + 1] = abs(gx[col]) + abs(gy[col]);
+        }
+    }
+
+    // non maximum suppression along the gradient direction, the strong edges
+    // are pushed on the stack
+    memset(ws->edges, EDGE_NONE, step * (rows + 2));
+    for(row = 0; row < rows; row++)
+    {
+        gx = INT16_ROW(ws->dx, row);
+        gy = INT16_ROW(ws->dy, row);
+        mag = ws->mag + (row + 1) * step + 1;
+        edge = ws->edges + (row + 1) * step + 1;
+        for(col = 0; col < cols; col++)
+        {
+            m = mag[col];
+            if(m <= low)
+            {
+                continue;
+            }
+            x = abs(gx[col]);
+            y = abs(gy[col]) << CANNY_SHIFT;
+            tg22x = x * CANNY_TG22;
+            if(y < tg22x)
+            {
+                if(!(m > mag[col - 1] && m >= mag[col + 1]))
+                {
+                    continue;
+                }
+            }
+            else if(y > tg22x + (x << (CANNY_SHIFT + 1)))
+            {
+                if(!(m > mag[col - step] && m >= mag[col + step]))
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                s = (gx[col] ^ gy[col]) < 0 ? -1 : 1;
+                if(!(m > mag[col - step - s] && m > mag[col + step + s]))
+                {
+                    continue;
+                }
+            }
+            if(m > high)
+            {
+                edge[col] = EDGE_STRONG;
+                ws->points[top++] = (uint32_t)(edge + col - ws->edges);
+            }
+            else
+            {
+                edge[col] = EDGE_CANDIDATE;
+            }
+        }
+    }
+
+    // hysteresis: candidates 8-connected to a strong edge are edges
+    while(top > 0)
+    {
+        i = ws->points[--top];
+        edge = ws->edges + i;
+        for(y = -step; y <= step; y += step)
+        {
+            for(x = -1; x <= 1; x++)
+            {
+                if(edge[y + x] == EDGE_CANDIDATE)
+                {
+                    edge[y + x] = EDGE_STRONG;
+                    ws->points[top++] = i + y + x;
+                }
+            }
+        }
+    }
+
+    for(row = 0; row < rows; row++)
+    {
+        edge = ws->edges + (row + 1) * step + 1;
+        gx = INT16_ROW(ws->dx, row);
+        gy = INT16_ROW(ws->dy, row);
+        for(col = 0; col < cols; col++)
+        {
+            if(edge[col] == EDGE_STRONG && (gx[col] != 0 || gy[col] != 0))
+            {
+                ws->points[n++] = (uint32_t)(row * cols + col);
+            }
+        }
+    }
+    return n;
+}
+
+// Most votes first, ties in accumulator order
+static int compareCenters(const void *a, const void *b)
+{
+    const houghcenter_t *ca = (const houghcenter_t *)a;
+    const houghcenter_t *cb = (const houghcenter_t *)b;
+
+    if(ca->votes != cb->votes)
+    {
+        return ca->votes > cb->votes ? -1 : 1;
+    }
+    return ca->index < cb->index ? -1 : (ca->index > cb->index);
+}
+
+// Largest distance first
+static int compareDistances(const void *a, const void *b)
+{
+    const float da = *(const float *)a;
+    const float db = *(const float *)b;
+
+    return da > db ? -1 : (da < db);
+}
+
+houghworkspace_t *newHoughWorkspace(const int32_t cols, const int32_t rows)
+{
+    register const size_t pixels = (size_t)cols * rows;
+    register const size_t padded = (size_t)(cols + 2) * (rows + 2);
+
+    if(cols <= 0 || rows <= 0)
+    {
+        return NULL;
+    }
+    houghworkspace_t *ws = (houghworkspace_t *)calloc(1, sizeof(houghworkspace_t));
+    if(ws == NULL)
+    {
+        return NULL;
+    }
+    ws->cols = cols;
+    ws->rows = rows;
+    ws->dx = newInt16Image(cols, rows);
+    ws->dy = newInt16Image(cols, rows);
+    ws->mag = (int32_t *)malloc(padded * sizeof(int32_t));
+    ws->edges = (uint8_t *)malloc(padded);
+    ws->points = (uint32_t *)malloc(pixels * sizeof(uint32_t));
+    ws->acc = (int32_t *)malloc(padded * sizeof(int32_t));
+    ws->centers = (houghcenter_t *)malloc((pixels / 2 + 1) * sizeof(houghcenter_t));
+    ws->dist = (float *)malloc(pixels * sizeof(float));
+    if(ws->dx == NULL || ws->dy == NULL || ws->mag == NULL || ws->edges == NULL ||
+       ws->points == NULL || ws->acc == NULL || ws->centers == NULL || ws->dist == NULL)
+    {
+        deleteHoughWorkspace(ws);
+        return NULL;
+    }
+    return ws;
+}
+
+void deleteHoughWorkspace(houghworkspace_t *ws)
+{
+    if(ws == NULL)
+    {
+        return;
+    }
+    if(ws->dx != NULL)
+    {
+        deleteImage(ws->dx);
+    }
+    if(ws->dy != NULL)
+    {
+        deleteImage(ws->dy);
+    }
+    free(ws->mag);
+    free(ws->edges);
+    free(ws->points);
+    free(ws->acc);
+    free(ws->centers);
+    free(ws->dist);
+    free(ws);
+}
+
+uint32_t houghCircles(const image_t *img,
+                      houghworkspace_t *ws,
+                      const houghparams_t *params,
+                      houghcircle_t *circles,
+                      const uint32_t max_circles)
+{
+    register const int32_t cols = img->cols;
+    register const int32_t rows = img->rows;
+    register const int32_t step = cols + 2;
+    register int32_t col;
+    register int32_t row;
+    register int32_t r;
+    register int32_t x1;
+    register int32_t y1;
+    register int32_t sx;
+    register int32_t sy;
+    register int32_t *acc;
+    register uint32_t i;
+    register uint32_t j;
+    register uint32_t k;
+    int32_t min_radius = params->min_radius > 0 ? params->min_radius : 0;
+    int32_t max_radius = params->max_radius;
+    int32_t acc_threshold = params->acc_threshold > 0 ? params->acc_threshold : 1;
+    int32_t canny_threshold = params->canny_threshold;
+    int32_t vx;
+    int32_t vy;
+    int32_t start;
+    int32_t max_count;
+    uint32_t nof_points;
+    uint32_t nof_centers = 0;
+    uint32_t nof_circles = 0;
+    uint32_t nof_dist;
+    float min_dist2;
+    float min_radius2;
+    float max_radius2;
+    float cx;
+    float cy;
+    float d;
+    float r_best;
+    float r_cur;
+    float start_dist;
+    float mag;
+
+    if(cols <= 0 || rows <= 0 || cols > ws->cols || rows > ws->rows || max_circles == 0)
+    {
+        return 0;
+    }
+    if(max_radius <= 0)
+    {
+        max_radius = cols > rows ? cols : rows;
+    }
+    else if(max_radius <= min_radius)
+    {
+        max_radius = min_radius + 2;
+    }
+    min_dist2 = params->min_distance > 1 ? (float)params->min_distance : 1.0f;
+    min_dist2 *= min_dist2;
+    min_radius2 = (float)min_radius * min_radius;
+    max_radius2 = (float)max_radius * max_radius;
+
+    // 1. edges
+    sobel3x3(img, ws->dx, ws->dy);
+    nof_points = cannyEdges(ws, cols, rows, canny_threshold / 2 > 1 ? canny_threshold / 2 : 1, canny_threshold);
+
+    // 2. votes along the gradient of every edge pixel
+    acc = ws->acc;
+    memset(acc, 0, (size_t)step * (rows + 2) * sizeof(int32_t));
+    for(i = 0; i < nof_points; i++)
+    {
+        col = (int32_t)(ws->points[i] % cols);
+        row = (int32_t)(ws->points[i] / cols);
+        vx = INT16_ROW(ws->dx, row)[col];
+        vy = INT16_ROW(ws->dy, row)[col];
+        mag = sqrtf((float)(vx * vx + vy * vy));
+        sx = (int32_t)lrintf(vx * (float)(1 << HOUGH_SHIFT) / mag);
+        sy = (int32_t)lrintf(vy * (float)(1 << HOUGH_SHIFT) / mag);
+        for(k = 0; k < 2; k++)
+        {
+            x1 = (col << HOUGH_SHIFT) + min_radius * sx;
+            y1 = (row << HOUGH_SHIFT) + min_radius * sy;
+            for(r = min_radius; r <= max_radius; r++)
+            {
+                if((uint32_t)(x1 >> HOUGH_SHIFT) >= (uint32_t)cols || (uint32_t)(y1 >> HOUGH_SHIFT) >= (uint32_t)rows)
+                {
+                    break;
+                }
+                acc[(y1 >> HOUGH_SHIFT) * step + (x1 >> HOUGH_SHIFT)]++;
+                x1 += sx;
+                y1 += sy;
+            }
+            sx = -sx;
+            sy = -sy;
+        }
+    }
+
+    // 3. candidate centers
+    for(row = 1; row < rows - 1; row++)
+    {
+        for(col = 1; col < cols - 1; col++)
+        {
+            k = (uint32_t)(row * step + col);
+            if(acc[k] > acc_threshold && acc[k] > acc[k - 1] && acc[k] > acc[k + 1] &&
+               acc[k] > acc[k - step] && acc[k] > acc[k + step])
+            {
+                ws->centers[nof_centers].votes = acc[k];
+                ws->centers[nof_centers].index = k;
+                nof_centers++;
+            }
+        }
+    }
+    qsort(ws->centers, nof_centers, sizeof(houghcenter_t), compareCenters);
+
+    // 4. radius of every candidate
+    for(i = 0; i < nof_centers && nof_circles < max_circles; i++)
+    {
+        cx = (float)(ws->centers[i].index % step) + 0.5f;
+        cy = (float)(ws->centers[i].index / step) + 0.5f;
+
+        for(j = 0; j < nof_circles; j++)
+        {
+            if((circles[j].col - cx) * (circles[j].col - cx) + (circles[j].row - cy) * (circles[j].row - cy) < min_dist2)
+            {
+                break;
+            }
+        }
+        if(j < nof_circles)
+        {
+            continue;
+        }
+
+        nof_dist = 0;
+        for(j = 0; j < nof_points; j++)
+        {
+            vx = (int32_t)(ws->points[j] % cols);
+            vy = (int32_t)(ws->points[j] / cols);
+            d = (cx - vx) * (cx - vx) + (cy - vy) * (cy - vy);
+            if(min_radius2 <= d && d <= max_radius2)
+            {
+                ws->dist[nof_dist++] = sqrtf(d);
+            }
+        }
+        if(nof_dist == 0)
+        {
+            continue;
+        }
+        qsort(ws->dist, nof_dist, sizeof(float), compareDistances);
+
+        // groups of distances from small to large, the last group is not
+        // evaluated (as in opencv)
+        r_best = 0;
+        max_count = 0;
+        start = (int32_t)nof_dist - 1;
+        start_dist = ws->dist[start];
+        for(r = start - 1; r >= 0; r--)
+        {
+            d = ws->dist[r];
+            if(d > max_radius)
+            {
+                break;
+            }
+            if(d - start_dist > 1.0f)
+            {
+                r_cur = ws->dist[(r + start) / 2];
+                if((start - r) * r_best >= max_count * r_cur ||
+                   (r_best < FLT_EPSILON && start - r >= max_count))
+                {
+                    r_best = r_cur;
+                    max_count = start - r;
+                }
+                start_dist = d;
+                start = r;
+            }
+        }
+
+        if(max_count > acc_threshold)
+        {
+            circles[nof_circles].col = cx;
+            circles[nof_circles].row = cy;
+            circles[nof_circles].radius = r_best;
+            circles[nof_circles].votes = (uint32_t)ws->centers[i].votes;
+            nof_circles++;
+        }
+    }
+    return nof_circles;
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
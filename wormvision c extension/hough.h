@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the Hough circle transform
+ *
+ *              Same method as cv2.HoughCircles(img, cv2.HOUGH_GRADIENT, 1,
+ *              ...): Canny edges, every edge pixel votes for the centers on
+ *              the line along its gradient between the minimum and maximum
+ *              radius, the local maxima of the votes are the candidate
+ *              centers and the radius of a center is the distance to the
+ *              edge pixels with the most support.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _HOUGH_H_
+#define _HOUGH_H_
+
+#include "stdint.h"
+#include "operators.h"
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Parameters of houghCircles(), the names of cv2.HoughCircles() between
+// brackets
+typedef struct houghparams_t
+{
+    int32_t min_radius;       // (minRadius)
+    int32_t max_radius;       // (maxRadius) <= 0: the largest image size
+    int32_t min_distance;     // (minDist) between the centers of two circles
+    int32_t canny_threshold;  // (param1) high Canny threshold, low is half
+    int32_t acc_threshold;    // (param2) votes and support of a circle
+
+}houghparams_t;
+
+// A circle found by houghCircles(), in pixel coordinates: the center of the
+// top left pixel is (0.5, 0.5) as in opencv
+typedef struct houghcircle_t
+{
+    float    col;
+    float    row;
+    float    radius;
+    uint32_t votes;           // accumulator value of the center
+
+}houghcircle_t;
+
+// Candidate center, see houghCircles()
+typedef struct houghcenter_t
+{
+    int32_t  votes;
+    uint32_t index;           // index in the accumulator
+
+}houghcenter_t;
+
+// Workspace for houghCircles(), see newHoughWorkspace()
+typedef struct houghworkspace_t
+{
+    int32_t        cols;      // maximum image size
+    int32_t        rows;
+    image_t       *dx;        // int16 sobel gradients
+    image_t       *dy;
+    int32_t       *mag;       // (cols + 2) x (rows + 2) gradient magnitude with
+                              // a zero border
+    uint8_t       *edges;     // (cols + 2) x (rows + 2) Canny edge map
+    uint32_t      *points;    // cols * rows hysteresis stack and edge points
+    int32_t       *acc;       // (cols + 2) x (rows + 2) accumulator
+    houghcenter_t *centers;   // cols * rows / 2 candidate centers
+    float         *dist;      // cols * rows edge distances of one center
+
+}houghworkspace_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Create a workspace for images of at most cols x rows pixels
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling
+//                deleteHoughWorkspace(), returns NULL if memory could not be
+//                allocated
+houghworkspace_t *newHoughWorkspace( const int32_t cols, const int32_t rows );
+void deleteHoughWorkspace( houghworkspace_t *ws );
+
+// Find at most max_circles circles in img, the circle with the most votes
+// first. Returns the number of circles found. No memory is allocated.
+// A workspace must only be used by one thread at a time.
+//
+// Precondition : img is a basic image (or view) of at most ws->cols x ws->rows
+//                pixels
+// Postcondition: -
+uint32_t houghCircles( const image_t *img
+                     ,       houghworkspace_t *ws
+                     , const houghparams_t *params
+                     ,       houghcircle_t *circles
+                     , const uint32_t max_circles
+                     );
+
+#endif // _HOUGH_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
@@ -0,0 +1,396 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the binary morphology operators with
+ *              decomposed structuring elements
+ *
+ *              Only dilation is implemented on the packed rows, erosion is
+ *              the complement of the dilation of the complement. Pixels
+ *              outside the image are 0 in the dilation, so they are 1 in the
+ *              erosion. The packed rows are IMGTYPE_BINARY images, so a
+ *              binary source or destination is used without conversion.
+ *
+ *              The dilation with a rectangle of n columns at column offset a
+ *              is the OR of a run of n pixels that starts at column c + a. The
+ *              runs are built by doubling: OR the row with itself shifted by
+ *              1, 2, 4, ... columns. The rows of the rectangle are combined
+ *              the same way.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "morphology.h"
+#include "operators_binary.h"
+#include "string.h"
+#include "math.h"
+
+// Mask of the bits of the last word of a packed row that are columns
+static binary_word_t lastWordMask(const int32_t cols)
+{
+    return cols % BINARY_WORD_BITS ? ((binary_word_t)1 << (cols % BINARY_WORD_BITS)) - 1 : ~(binary_word_t)0;
+}
+
+// Header of an image of the size of src on the data of a workspace image
+static image_t workImage(const image_t *buf, const image_t *src)
+{
+    image_t img = *buf;
+    img.cols = src->cols;
+    img.rows = src->rows;
+    return img;
+}
+
+// src as an IMGTYPE_BINARY image, a basic image is packed in buf
+static const image_t *packedInput(const image_t *src, image_t *buf)
+{
+    if(src->type == IMGTYPE_BINARY)
+    {
+        return src;
+    }
+    toBinary_basic(src, buf);
+    return buf;
+}
+
+// dst = complement of src, packed
+static void packedComplement(const image_t *src, image_t *dst)
+{
+    if(src->type == IMGTYPE_BINARY)
+    {
+        invert_binary(src, dst);
+    }
+    else
+    {
+        toBinary_basic(src, dst);
+        invert_binary(dst, dst);
+    }
+}
+
+// Store the packed result res in the basic or IMGTYPE_BINARY image dst
+static void storeResult(const image_t *res, image_t *dst)
+{
+    if(dst->type == IMGTYPE_BINARY)
+    {
+        copy_binary(res, dst);
+    }
+    else
+    {
+        toBasic_binary(res, dst);
+    }
+}
+
+// dst[w] = the 64 pixels of line that start at column 64 * w + shift, for
+// w = first .. words - 1. dst can be line if shift > 0, the words are written
+// in ascending order. line must be readable from word first + shift / 64 - 1
+// up to word words + shift / 64.
+static void shiftWords(const binary_word_t *line, binary_word_t *dst, const int32_t first, const int32_t words,
+                       const int32_t shift, const int32_t or_dst)
+{
+    // split in words and bits, rounding down
+    register const int32_t q = shift >= 0 ? shift / BINARY_WORD_BITS : -((-shift + BINARY_WORD_BITS - 1) / BINARY_WORD_BITS);
+    register const int32_t s = shift - q * BINARY_WORD_BITS;
+    register const binary_word_t *l = line + q;
+    register int32_t w;
+
+    if(s == 0)
+    {
+        for(w = first; w < words; w++)
+        {
+            dst[w] = or_dst ? dst[w] | l[w] : l[w];
+        }
+    }
+    else
+    {
+        for(w = first; w < words; w++)
+        {
+            dst[w] = (or_dst ? dst[w] : 0) | (l[w] >> s) | (l[w + 1] << (BINARY_WORD_BITS - s));
+        }
+    }
+}
+
+// dst(c) = OR of src(c + col) .. src(c + col + cols - 1) for one packed row
+static void horizontalRun(morphworkspace_t *ws, const binary_word_t *src, binary_word_t *dst,
+                          const int32_t words, const binary_word_t mask, const morphrect_t *rect)
+{
+    register binary_word_t *line = ws->line + ws->halo_words;
+    register int32_t w;
+    register int32_t p;
+
+    // the halo before the row holds the runs that start left of the image, the
+    // halo after the row is 0
+    for(w = 0; w < ws->halo_words; w++)
+    {
+        line[w - ws->halo_words] = 0;
+        line[words + w] = 0;
+    }
+    memcpy(line, src, words * sizeof(binary_word_t));
+
+    // line(c) = OR of src(c) .. src(c + p - 1)
+    for(p = 1; p < rect->cols; p *= 2)
+    {
+        shiftWords(line, line, -ws->halo_words, words, p * 2 <= rect->cols ? p : rect->cols - p, 1);
+    }
+
+    shiftWords(line, dst, 0, words, rect->col, 0);
+    dst[words - 1] &= mask;
+}
+
+// dst = dilation of src with the structuring element of ws, src and dst are
+// different IMGTYPE_BINARY images
+static void dilateRows(morphworkspace_t *ws, const image_t *src, image_t *dst)
+{
+    register const int32_t cols = src->cols;
+    register const int32_t rows = src->rows;
+    register const int32_t words = BINARY_WORDS(cols);
+    register const binary_word_t mask = lastWordMask(cols);
+    register binary_word_t *lines = ws->lines + ws->halo_rows * words;
+    register binary_word_t *l;
+    register const binary_word_t *t;
+    register binary_word_t *d;
+    register int32_t row;
+    register int32_t w;
+    register int32_t p;
+    register int32_t shift;
+    register uint32_t i;
+    const morphrect_t *rect;
+
+    erase_binary(dst);
+    for(i = 0; i < ws->nof_rects; i++)
+    {
+        rect = &ws->rects[i];
+
+        // horizontal runs of each row, the halo rows above the image are 0
+        memset(ws->lines, 0, ws->halo_rows * words * sizeof(binary_word_t));
+        for(row = 0; row < rows; row++)
+        {
+            horizontalRun(ws, BINARY_ROW(src, row), lines + row * words, words, mask, rect);
+        }
+
+        // vertical runs of rect->rows rows, built by doubling like the
+        // horizontal runs
+        for(p = 1; p < rect->rows; p *= 2)
+        {
+            shift = p * 2 <= rect->rows ? p : rect->rows - p;
+            for(row = -ws->halo_rows; row + shift < rows; row++)
+            {
+                l = lines + row * words;
+                t = l + shift * words;
+                for(w = 0; w < words; w++)
+                {
+                    l[w] |= t[w];
+                }
+            }
+            if(p * 2 > rect->rows)
+            {
+                break;
+            }
+        }
+
+        // the run of row + rect->row is the dilation of row
+        for(row = 0; row < rows && row + rect->row < rows; row++)
+        {
+            t = lines + (row + rect->row) * words;
+            d = BINARY_ROW(dst, row);
+            for(w = 0; w < words; w++)
+            {
+                d[w] |= t[w];
+            }
+        }
+    }
+    dst->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void ellipseKernel(image_t *kernel)
+{
+    register const int32_t r = kernel->rows / 2;
+    register const int32_t c = kernel->cols / 2;
+    register const double inv_r2 = r ? 1.0 / ((double)r * r) : 0.0;
+    register int32_t row;
+    register int32_t col;
+    register int32_t dx;
+    register int32_t j1;
+    register int32_t j2;
+    register basic_pixel_t *d;
+
+    for(row = 0; row < kernel->rows; row++)
+    {
+        j1 = 0;
+        j2 = 0;
+        if(abs(row - r) <= r)
+        {
+            dx = (int32_t)floor(c * sqrt((r * r - (row - r) * (row - r)) * inv_r2) + 0.5);
+            j1 = c - dx > 0 ? c - dx : 0;
+            j2 = c + dx + 1 < kernel->cols ? c + dx + 1 : kernel->cols;
+        }
+        d = BASIC_ROW(kernel, row);
+        for(col = 0; col < kernel->cols; col++)
+        {
+            d[col] = col >= j1 && col < j2;
+        }
+    }
+    kernel->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+morphworkspace_t *newMorphWorkspace(const int32_t cols,
+                                    const int32_t rows,
+                                    const image_t *kernel)
+{
+    register const int32_t anchor_col = kernel->cols / 2;
+    register const int32_t anchor_row = kernel->rows / 2;
+    register const int32_t words = BINARY_WORDS(cols);
+    register int32_t row;
+    register int32_t col;
+    register int32_t start;
+    register uint32_t i;
+    register const basic_pixel_t *k;
+    morphrect_t *rect;
+
+    if(cols <= 0 || rows <= 0)
+    {
+        return NULL;
+    }
+    morphworkspace_t *ws = (morphworkspace_t *)calloc(1, sizeof(morphworkspace_t));
+    if(ws == NULL)
+    {
+        return NULL;
+    }
+    ws->cols = cols;
+    ws->rows = rows;
+    ws->halo_rows = anchor_row;
+    ws->halo_words = (kernel->cols - 1) / BINARY_WORD_BITS + 1;
+
+    // every run of kernel pixels in a row is a rectangle, unless the row above
+    // has the same run: then that rectangle gets one row longer
+    ws->rects = (morphrect_t *)malloc((kernel->rows * ((kernel->cols + 1) / 2) + 1) * sizeof(morphrect_t));
+    ws->packed = newBinaryImage(cols, rows);
+    ws->result = newBinaryImage(cols, rows);
+    ws->lines = (binary_word_t *)malloc((ws->halo_rows + rows) * words * sizeof(binary_word_t));
+    ws->line = (binary_word_t *)malloc((2 * ws->halo_words + words) * sizeof(binary_word_t));
+    if(ws->rects == NULL || ws->packed == NULL || ws->result == NULL || ws->lines == NULL || ws->line == NULL)
+    {
+        deleteMorphWorkspace(ws);
+        return NULL;
+    }
+
+    for(row = 0; row < kernel->rows; row++)
+    {
+        k = BASIC_ROW(kernel, row);
+        col = 0;
+        while(col < kernel->cols)
+        {
+            if(k[col] == 0)
+            {
+                col++;
+                continue;
+            }
+            start = col;
+            while(col < kernel->cols && k[col] != 0)
+            {
+                col++;
+            }
+            for(i = 0; i < ws->nof_rects; i++)
+            {
+                rect = &ws->rects[i];
+                if(rect->row + rect->rows == row - anchor_row &&
+                   rect->col == start - anchor_col && rect->cols == col - start)
+                {
+                    rect->rows++;
+                    break;
+                }
+            }
+            if(i == ws->nof_rects)
+            {
+                rect = &ws->rects[ws->nof_rects++];
+                rect->col = start - anchor_col;
+                rect->row = row - anchor_row;
+                rect->cols = col - start;
+                rect->rows = 1;
+            }
+        }
+    }
+    return ws;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteMorphWorkspace(morphworkspace_t *ws)
+{
+    if(ws == NULL)
+    {
+        return;
+    }
+    free(ws->rects);
+    if(ws->packed != NULL)
+    {
+        deleteBinaryImage(ws->packed);
+    }
+    if(ws->result != NULL)
+    {
+        deleteBinaryImage(ws->result);
+    }
+    free(ws->lines);
+    free(ws->line);
+    free(ws);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void morphErodeFast(const image_t *src, image_t *dst, morphworkspace_t *ws)
+{
+    image_t packed = workImage(ws->packed, src);
+    image_t result = workImage(ws->result, src);
+
+    packedComplement(src, &packed);
+    dilateRows(ws, &packed, &result);
+    invert_binary(&result, &result);
+    storeResult(&result, dst);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void morphDilateFast(const image_t *src, image_t *dst, morphworkspace_t *ws)
+{
+    image_t packed = workImage(ws->packed, src);
+    image_t result = workImage(ws->result, src);
+
+    dilateRows(ws, packedInput(src, &packed), &result);
+    storeResult(&result, dst);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void morphOpenFast(const image_t *src, image_t *dst, morphworkspace_t *ws)
+{
+    image_t packed = workImage(ws->packed, src);
+    image_t result = workImage(ws->result, src);
+
+    packedComplement(src, &packed);
+    dilateRows(ws, &packed, &result);
+    invert_binary(&result, &result);
+    dilateRows(ws, &result, &packed);
+    storeResult(&packed, dst);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void morphCloseFast(const image_t *src, image_t *dst, morphworkspace_t *ws)
+{
+    image_t packed = workImage(ws->packed, src);
+    image_t result = workImage(ws->result, src);
+
+    dilateRows(ws, packedInput(src, &packed), &result);
+    invert_binary(&result, &result);
+    dilateRows(ws, &result, &packed);
+    invert_binary(&packed, &packed);
+    storeResult(&packed, dst);
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
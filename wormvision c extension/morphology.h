@@ -0,0 +1,114 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the binary morphology operators with
+ *              decomposed structuring elements
+ *
+ *              A structuring element is split in rectangles of equal rows.
+ *              Every rectangle is applied as a horizontal and a vertical line
+ *              on bit-packed rows (IMGTYPE_BINARY), the lines are built by
+ *              doubling, so a line of n pixels takes about log2(n) word
+ *              operations per 64 pixels.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _MORPHOLOGY_H_
+#define _MORPHOLOGY_H_
+
+#include "stdint.h"
+#include "operators.h"
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Rectangle of a decomposed structuring element, the offsets are relative to
+// the anchor (kernel->cols / 2, kernel->rows / 2)
+typedef struct morphrect_t
+{
+    int32_t col;   // left column offset
+    int32_t row;   // top row offset
+    int32_t cols;
+    int32_t rows;
+
+}morphrect_t;
+
+// Workspace for the fast morphology operators, see newMorphWorkspace()
+typedef struct morphworkspace_t
+{
+    int32_t      cols;        // maximum image size
+    int32_t      rows;
+    uint32_t     nof_rects;
+    morphrect_t *rects;       // structuring element
+    int32_t      halo_rows;   // zero rows above the image in lines
+    int32_t      halo_words;  // zero words before and after the row in line
+    image_t     *packed;      // IMGTYPE_BINARY input image
+    image_t     *result;      // IMGTYPE_BINARY result image
+    binary_word_t *lines;     // horizontal lines of one rectangle
+    binary_word_t *line;      // one row with halo words
+
+}morphworkspace_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Fill kernel with the ellipse that fits in it, the same structuring element
+// as cv2.getStructuringElement(cv2.MORPH_ELLIPSE, (cols, rows))
+//
+// Precondition : kernel is a basic image
+// Postcondition: kernel is a binary image
+void ellipseKernel( image_t *kernel );
+
+// Create a workspace for images of at most cols x rows pixels and the
+// structuring element kernel: the non zero pixels, the anchor is
+// (kernel->cols / 2, kernel->rows / 2) as in opencv.
+// Memory is allocated within this function
+//
+// Precondition : kernel is a basic image
+// Postcondition: User must free allocated memory by calling
+//                deleteMorphWorkspace(), returns NULL if memory could not be
+//                allocated
+morphworkspace_t *newMorphWorkspace( const int32_t cols
+                                   , const int32_t rows
+                                   , const image_t *kernel
+                                   );
+void deleteMorphWorkspace( morphworkspace_t *ws );
+
+// Erosion, dilation, opening and closing with the structuring element of ws
+// Same result as erode_basic() etc. for odd kernel sizes: pixels outside the
+// image are not part of the window. src and dst can be the same image and no
+// memory is allocated.
+// A workspace must only be used by one thread at a time.
+//
+// Precondition : src is a binary basic image or an IMGTYPE_BINARY image (or
+//                view) of at most ws->cols x ws->rows pixels
+//                dst is a basic or IMGTYPE_BINARY image with the same size as
+//                src
+// Postcondition: dst is a binary image
+void morphErodeFast( const image_t *src
+                   ,       image_t *dst
+                   ,       morphworkspace_t *ws
+                   );
+void morphDilateFast( const image_t *src
+                    ,       image_t *dst
+                    ,       morphworkspace_t *ws
+                    );
+void morphOpenFast( const image_t *src
+                  ,       image_t *dst
+                  ,       morphworkspace_t *ws
+                  );
+void morphCloseFast( const image_t *src
+                   ,       image_t *dst
+                   ,       morphworkspace_t *ws
+                   );
+
+#endif // _MORPHOLOGY_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
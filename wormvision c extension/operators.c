@@ -20,6 +20,8 @@
 #include "operators_float.h"
 #include "operators_rgb888.h"
 #include "operators_rgb565.h"
+#include "operators_binary.h"
+#include "morphology.h"
 #include "math.h"
 
 // unique operator: watershed transformation
@@ -60,12 +62,125 @@ void deleteImage(image_t *img)
     case IMGTYPE_RGB565:
         deleteRGB565Image(img);
     break;
+    case IMGTYPE_BINARY:
+        deleteBinaryImage(img);
+    break;
     default:
         fprintf(stderr, "deleteImage(): image type %d not supported\n", img->type);
     break;
     }
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void subImage( const image_t *src
+             ,       image_t *view
+             , const int32_t col
+             , const int32_t row
+             , const int32_t cols
+             , const int32_t rows)
+{
+    view->cols = cols;
+    view->rows = rows;
+    view->stride = src->stride;
+    view->view = src->view;
+    view->type = src->type;
+    if(src->type == IMGTYPE_BINARY)
+    {
+        view->data = src->data + (row * src->stride + col / BINARY_WORD_BITS) * pixelSize(src->type);
+        return;
+    }
+    view->data = src->data + (row * src->stride + col) * pixelSize(src->type);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t pixelSize( const eImageType type )
+{
+    switch(type)
+    {
+    case IMGTYPE_BASIC:  return sizeof(basic_pixel_t);
+    case IMGTYPE_INT16:  return sizeof(int16_pixel_t);
+    case IMGTYPE_FLOAT:  return sizeof(float_pixel_t);
+    case IMGTYPE_RGB888: return sizeof(rgb888_pixel_t);
+    case IMGTYPE_RGB565: return sizeof(rgb565_pixel_t);
+    case IMGTYPE_BINARY: return sizeof(binary_word_t);
+    default:
+        fprintf(stderr, "pixelSize(): image type %d not supported\n", type);
+        return 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void packBinary( const image_t *src, image_t *dst )
+{
+    if(dst->type != IMGTYPE_BINARY)
+    {
+        fprintf(stderr, "packBinary(): dst is not a binary image\n");
+        return;
+    }
+
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        toBinary_basic(src, dst);
+    break;
+    case IMGTYPE_BINARY:
+        copy_binary(src, dst);
+    break;
+    default:
+        fprintf(stderr, "packBinary(): image type %d not supported\n", src->type);
+    break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void unpackBinary( const image_t *src, image_t *dst )
+{
+    if(src->type != IMGTYPE_BINARY)
+    {
+        fprintf(stderr, "unpackBinary(): src is not a binary image\n");
+        return;
+    }
+
+    switch(dst->type)
+    {
+    case IMGTYPE_BASIC:
+        toBasic_binary(src, dst);
+    break;
+    default:
+        fprintf(stderr, "unpackBinary(): image type %d not supported\n", dst->type);
+    break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void rgb888ToGray( const image_t *src
+                 ,       image_t *dst
+                 , const int32_t bgr
+                 , const eGrayWeights weights
+                 )
+{
+    if(src->type != IMGTYPE_RGB888)
+    {
+        fprintf(stderr, "rgb888ToGray(): src is not an RGB888 image\n");
+        return;
+    }
+
+    switch(dst->type)
+    {
+    case IMGTYPE_BASIC:
+        toBasic_rgb888(src, dst, bgr, weights);
+    break;
+    default:
+        fprintf(stderr, "rgb888ToGray(): image type %d not supported\n", dst->type);
+    break;
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Contrast stretching
 // ----------------------------------------------------------------------------
@@ -104,7 +219,7 @@ void contrastStretchFast( const image_t *src, image_t *dst )
     switch(src->type)
     {
     case IMGTYPE_BASIC:
-        contrastStretchFast_basic(src, dst);
+        contrastStretchFast_basic(src, dst, NULL);
     break;
     case IMGTYPE_INT16:
     case IMGTYPE_FLOAT:
@@ -118,6 +233,23 @@ void contrastStretchFast( const image_t *src, image_t *dst )
     }
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void contrastStretchFastStats( const image_t *src
+                             ,       image_t *dst
+                             , const pixelstats_t *stats)
+{
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        contrastStretchFast_basic(src, dst, stats);
+    break;
+    default:
+        fprintf(stderr, "contrastStretchFastStats(): image type %d not supported\n", src->type);
+    break;
+    }
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 void contrastStretchRGB888( const image_t *src
@@ -194,7 +326,7 @@ void threshold( const image_t *src
               , const int32_t low
               , const int32_t high)
 {
-    if(src->type != dst->type)
+    if(src->type != dst->type && !(src->type == IMGTYPE_BASIC && dst->type == IMGTYPE_BINARY))
     {
         fprintf(stderr, "threshold(): src and dst are of different type\n");
     }
@@ -202,6 +334,12 @@ void threshold( const image_t *src
     switch(src->type)
     {
     case IMGTYPE_BASIC:
+        if(dst->type == IMGTYPE_BINARY)
+        {
+            // the selected pixels are packed directly
+            threshold_binary(src, dst, low, high);
+            break;
+        }
         if(low < 0)
         {
             fprintf(stderr, "threshold(): low < 0 is invalid for IMGTYPE_BASIC\n");
@@ -250,7 +388,7 @@ void threshold2Means( const image_t *src
     switch(src->type)
     {
     case IMGTYPE_BASIC:
-        threshold2Means_basic(src, dst, brightness);
+        threshold2Means_basic(src, dst, brightness, NULL);
     break;
     case IMGTYPE_INT16:
     case IMGTYPE_FLOAT:
@@ -264,6 +402,24 @@ void threshold2Means( const image_t *src
     }
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void threshold2MeansStats( const image_t *src
+                         ,       image_t *dst
+                         , const eBrightness brightness
+                         , const pixelstats_t *stats)
+{
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        threshold2Means_basic(src, dst, brightness, stats);
+    break;
+    default:
+        fprintf(stderr, "threshold2MeansStats(): image type %d not supported\n", src->type);
+    break;
+    }
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 void thresholdOtsu( const image_t *src
@@ -273,7 +429,7 @@ void thresholdOtsu( const image_t *src
     switch(src->type)
     {
     case IMGTYPE_BASIC:
-        thresholdOtsu_basic(src, dst, brightness);
+        thresholdOtsu_basic(src, dst, brightness, NULL);
     break;
     case IMGTYPE_INT16:
     case IMGTYPE_FLOAT:
@@ -287,6 +443,24 @@ void thresholdOtsu( const image_t *src
     }
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void thresholdOtsuStats( const image_t *src
+                       ,       image_t *dst
+                       , const eBrightness brightness
+                       , const pixelstats_t *stats)
+{
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        thresholdOtsu_basic(src, dst, brightness, stats);
+    break;
+    default:
+        fprintf(stderr, "thresholdOtsuStats(): image type %d not supported\n", src->type);
+    break;
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Miscellaneous
 // ----------------------------------------------------------------------------
@@ -301,7 +475,8 @@ void erase(const image_t *img)
         erase_int16,
         erase_float,
         erase_rgb888,
-        erase_rgb565
+        erase_rgb565,
+        erase_binary
     };
 
     // Call the function
@@ -325,7 +500,8 @@ void copy(const image_t *src, image_t *dst)
         copy_int16,
         copy_float,
         copy_rgb888,
-        copy_rgb565
+        copy_rgb565,
+        copy_binary
     };
 
     // Call the function
@@ -372,6 +548,8 @@ uint32_t neighbourCount( const image_t *img
     {
     case IMGTYPE_BASIC:
         return neighbourCount_basic(img, c, r, (basic_pixel_t)pixel, connected);
+    case IMGTYPE_BINARY:
+        return neighbourCount_binary(img, c, r, pixel, connected);
     case IMGTYPE_INT16:
     case IMGTYPE_FLOAT:
         fprintf(stderr, "neighbourCount(): image type %d not yet implemented\n", img->type);
@@ -437,6 +615,12 @@ void add( const image_t *src, image_t *dst )
 // ----------------------------------------------------------------------------
 uint32_t sum( const image_t *img )
 {
+    if(img->type == IMGTYPE_BINARY)
+    {
+        // population count
+        return sum_binary(img);
+    }
+
     // Build function call table
     // (make sure order matches the order in eImageType)
     uint32_t (*fp[])(const image_t *) =
@@ -485,6 +669,12 @@ void invert( const image_t *src, image_t *dst)
         fprintf(stderr, "invert(): src and dst are of different type\n");
     }
 
+    if(src->type == IMGTYPE_BINARY)
+    {
+        invert_binary(src, dst);
+        return;
+    }
+
     // Build function call table
     // (make sure order matches the order in eImageType)
     void (*fp[])(const image_t *, image_t *) =
@@ -510,6 +700,49 @@ void gamma_evdk( const image_t *src, image_t *dst, const float c, const float g)
     }
 }
 
+void applyLUT( const image_t *src, image_t *dst, const basic_pixel_t *LUT) {
+    switch(src->type) {
+    case IMGTYPE_BASIC:
+        applyLUT_basic(src, dst, LUT);
+        break;
+    default:
+        fprintf(stderr, "applyLUT(): image type %d not yet implemented\n", src->type);
+    }
+}
+
+void stretchLUTThreshold( const image_t *src
+                        ,       image_t *dst
+                        , const basic_pixel_t *LUT
+                        , const int32_t low
+                        , const int32_t high)
+{
+    stretchLUTThresholdStats(src, dst, LUT, low, high, NULL);
+}
+
+void stretchLUTThresholdStats( const image_t *src
+                             ,       image_t *dst
+                             , const basic_pixel_t *LUT
+                             , const int32_t low
+                             , const int32_t high
+                             , const pixelstats_t *stats)
+{
+    if(dst->type != IMGTYPE_BASIC && dst->type != IMGTYPE_BINARY)
+    {
+        fprintf(stderr, "stretchLUTThreshold(): dst must be IMGTYPE_BASIC or IMGTYPE_BINARY\n");
+        return;
+    }
+
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        stretchLUTThreshold_basic(src, dst, LUT, low, high, stats);
+    break;
+    default:
+        fprintf(stderr, "stretchLUTThreshold(): image type %d not yet implemented\n", src->type);
+    break;
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Filters
 // ----------------------------------------------------------------------------
@@ -552,22 +785,129 @@ void gaussianBlur( const image_t *src
 void convolution( const image_t *src
                 ,       image_t *dst
                   , const image_t *kernel) {
+    convolutionStats(src, dst, kernel, NULL);
+}
+
+void convolutionStats( const image_t *src
+                     ,       image_t *dst
+                     , const image_t *kernel
+                     ,       pixelstats_t *stats) {
     switch(src->type) {
     case IMGTYPE_BASIC:
-        convolution_basic(src, dst, kernel);
+        convolution_basic(src, dst, kernel, stats);
         break;
     default:
         fprintf(stderr, "convolution(): image type %d not yet implemented\n", src->type);
     }
 }
 
+void gaussianBlurSeparable( const image_t *src
+                          ,       image_t *dst
+                          , const int32_t kernelSize
+                          , const double sigma) {
+    switch(src->type) {
+    case IMGTYPE_BASIC:
+        gaussianBlurSeparable_basic(src, dst, kernelSize, sigma);
+        break;
+    default:
+        fprintf(stderr, "gaussianBlurSeparable(): image type %d not yet implemented\n", src->type);
+    }
+}
+
+void gaussianKernel1D( image_t *kernel, const double sigma ) {
+    switch(kernel->type) {
+    case IMGTYPE_INT16:
+        gaussianKernel1D_basic(kernel, sigma);
+        break;
+    default:
+        fprintf(stderr, "gaussianKernel1D(): image type %d not supported\n", kernel->type);
+    }
+}
+
+void separableConvolution( const image_t *src
+                         ,       image_t *dst
+                         ,       image_t *tmp
+                         , const image_t *kernel) {
+    separableConvolutionStats(src, dst, tmp, kernel, NULL);
+}
+
+void separableConvolutionStats( const image_t *src
+                              ,       image_t *dst
+                              ,       image_t *tmp
+                              , const image_t *kernel
+                              ,       pixelstats_t *stats) {
+    if(tmp->type != IMGTYPE_INT16 || kernel->type != IMGTYPE_INT16) {
+        fprintf(stderr, "separableConvolution(): tmp and kernel must be int16 images\n");
+        return;
+    }
+    switch(src->type) {
+    case IMGTYPE_BASIC:
+        separableConvolution_basic(src, dst, tmp, kernel, stats);
+        break;
+    default:
+        fprintf(stderr, "separableConvolution(): image type %d not yet implemented\n", src->type);
+    }
+}
+
+void pyramidDown( const image_t *src
+                ,       image_t *dst
+                ,       image_t *tmp) {
+    if(dst->type != src->type || tmp->type != IMGTYPE_INT16) {
+        fprintf(stderr, "pyramidDown(): dst must have the type of src and tmp must be an int16 image\n");
+        return;
+    }
+    if(dst->cols != (src->cols + 1) / 2 || dst->rows != (src->rows + 1) / 2 ||
+       tmp->cols < src->cols) {
+        fprintf(stderr, "pyramidDown(): dst or tmp has the wrong size\n");
+        return;
+    }
+    switch(src->type) {
+    case IMGTYPE_BASIC:
+        pyramidDown_basic(src, dst, tmp);
+        break;
+    default:
+        fprintf(stderr, "pyramidDown(): image type %d not yet implemented\n", src->type);
+    }
+}
+
+void gaussianKernel( image_t *kernel, const double sigma ) {
+    switch(kernel->type) {
+    case IMGTYPE_FLOAT:
+        gaussianKernel_float(kernel, sigma);
+        break;
+    default:
+        fprintf(stderr, "gaussianKernel(): image type %d not supported\n", kernel->type);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Morphology
 // ----------------------------------------------------------------------------
+
+// Run one of the fast morphology operators of morphology.h with a temporary
+// workspace, returns 0 if the workspace could not be allocated
+static int morphFast(const image_t *src, image_t *dst, const image_t *kernel,
+                     void (*op)(const image_t *, image_t *, morphworkspace_t *)) {
+    morphworkspace_t *ws = newMorphWorkspace(src->cols, src->rows, kernel);
+    if(ws == NULL) {
+        return 0;
+    }
+    op(src, dst, ws);
+    deleteMorphWorkspace(ws);
+    return 1;
+}
+
 void morph_erode(const image_t *src, image_t *dst, const image_t *kernel) {
     switch(src->type) {
     case IMGTYPE_BASIC:
-        erode_basic(src, dst, kernel);
+        if(!morphFast(src, dst, kernel, morphErodeFast)) {
+            erode_basic(src, dst, kernel);
+        }
+        break;
+    case IMGTYPE_BINARY:
+        if(!morphFast(src, dst, kernel, morphErodeFast)) {
+            fprintf(stderr, "erode(): unable to allocate memory\n");
+        }
         break;
     default:
         fprintf(stderr, "erode(): image type %d not yet implemented\n", src->type);
@@ -577,7 +917,14 @@ void morph_erode(const image_t *src, image_t *dst, const image_t *kernel) {
 void morph_dilate(const image_t *src, image_t *dst, const image_t *kernel) {
     switch(src->type) {
     case IMGTYPE_BASIC:
-        dilate_basic(src, dst, kernel);
+        if(!morphFast(src, dst, kernel, morphDilateFast)) {
+            dilate_basic(src, dst, kernel);
+        }
+        break;
+    case IMGTYPE_BINARY:
+        if(!morphFast(src, dst, kernel, morphDilateFast)) {
+            fprintf(stderr, "dilate(): unable to allocate memory\n");
+        }
         break;
     default:
         fprintf(stderr, "dilate(): image type %d not yet implemented\n", src->type);
@@ -587,7 +934,14 @@ void morph_dilate(const image_t *src, image_t *dst, const image_t *kernel) {
 void morph_open(const image_t *src, image_t *dst, const image_t *kernel) {
     switch(src->type) {
     case IMGTYPE_BASIC:
-        open_basic(src, dst, kernel);
+        if(!morphFast(src, dst, kernel, morphOpenFast)) {
+            open_basic(src, dst, kernel);
+        }
+        break;
+    case IMGTYPE_BINARY:
+        if(!morphFast(src, dst, kernel, morphOpenFast)) {
+            fprintf(stderr, "open(): unable to allocate memory\n");
+        }
         break;
     default:
         fprintf(stderr, "open(): image type %d not yet implemented\n", src->type);
@@ -597,7 +951,14 @@ void morph_open(const image_t *src, image_t *dst, const image_t *kernel) {
 void morph_close(const image_t *src, image_t *dst, const image_t *kernel) {
     switch(src->type) {
     case IMGTYPE_BASIC:
-        close_basic(src, dst, kernel);
+        if(!morphFast(src, dst, kernel, morphCloseFast)) {
+            close_basic(src, dst, kernel);
+        }
+        break;
+    case IMGTYPE_BINARY:
+        if(!morphFast(src, dst, kernel, morphCloseFast)) {
+            fprintf(stderr, "close(): unable to allocate memory\n");
+        }
         break;
     default:
         fprintf(stderr, "close(): image type %d not yet implemented\n", src->type);
@@ -662,6 +1023,49 @@ void fillHoles( const image_t *src
     }
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void fillHolesFast( const image_t *src
+                  ,       image_t *dst
+                  , const eConnected connected
+                  ,       uint32_t *queue)
+{
+    if(src->type != dst->type)
+    {
+        fprintf(stderr, "fillHolesFast(): src and dst are of different type\n");
+    }
+
+    uint32_t *tmp_queue = NULL;
+    if(queue == NULL)
+    {
+        tmp_queue = (uint32_t *)malloc(src->cols * src->rows * sizeof(uint32_t));
+        if(tmp_queue == NULL)
+        {
+            fprintf(stderr, "fillHolesFast(): unable to allocate queue\n");
+            return;
+        }
+        queue = tmp_queue;
+    }
+
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        fillHolesFast_basic(src, dst, connected, queue);
+    break;
+    case IMGTYPE_INT16:
+    case IMGTYPE_FLOAT:
+        fprintf(stderr, "fillHolesFast(): image type %d not yet implemented\n", src->type);
+    break;
+    case IMGTYPE_RGB888:
+    case IMGTYPE_RGB565:
+    default:
+        fprintf(stderr, "fillHolesFast(): image type %d not supported\n", src->type);
+    break;
+    }
+
+    free(tmp_queue);
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 uint32_t labelBlobs( const image_t *src
@@ -691,6 +1095,94 @@ uint32_t labelBlobs( const image_t *src
     return 0;
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t labelBlobsFast( const image_t *src
+                       ,       image_t *dst
+                       , const eConnected connected
+                       ,       labelworkspace_t *ws)
+{
+    if(dst->type != IMGTYPE_INT16 || src->cols != dst->cols || src->rows != dst->rows)
+    {
+        fprintf(stderr, "labelBlobsFast(): dst must be an int16 image with the same size as src\n");
+        return 0;
+    }
+
+    labelworkspace_t *tmp_ws = NULL;
+    uint32_t blobCount = 0;
+    if(ws == NULL || ws->max_runs < (uint32_t)(src->rows * ((src->cols + 1) / 2)))
+    {
+        tmp_ws = newLabelWorkspace(src->cols, src->rows);
+        if(tmp_ws == NULL)
+        {
+            fprintf(stderr, "labelBlobsFast(): unable to allocate workspace\n");
+            return 0;
+        }
+        ws = tmp_ws;
+    }
+
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+        blobCount = labelBlobsFast_basic(src, dst, connected, ws);
+        if(blobCount > MAX_INT16_LABELS)
+        {
+            fprintf(stderr, "labelBlobsFast(): %u blobs found, maximum is %d\n", blobCount, MAX_INT16_LABELS);
+            blobCount = 0;
+        }
+    break;
+    case IMGTYPE_INT16:
+    case IMGTYPE_FLOAT:
+        fprintf(stderr, "labelBlobsFast(): image type %d not yet implemented\n", src->type);
+    break;
+    case IMGTYPE_RGB888:
+    case IMGTYPE_RGB565:
+    default:
+        fprintf(stderr, "labelBlobsFast(): image type %d not supported\n", src->type);
+    break;
+    }
+
+    deleteLabelWorkspace(tmp_ws);
+    return blobCount;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+labelworkspace_t *newLabelWorkspace( const uint32_t cols, const uint32_t rows )
+{
+    labelworkspace_t *ws = (labelworkspace_t *)malloc(sizeof(labelworkspace_t));
+    if(ws == NULL)
+    {
+        // Unable to allocate memory for workspace
+        return NULL;
+    }
+
+    // A row can hold at most (cols + 1) / 2 runs
+    ws->max_runs = rows * ((cols + 1) / 2);
+    ws->runs = (labelrun_t *)malloc(ws->max_runs * sizeof(labelrun_t));
+    ws->parent = (uint32_t *)malloc(ws->max_runs * sizeof(uint32_t));
+    if(ws->runs == NULL || ws->parent == NULL)
+    {
+        // Unable to allocate memory for runs
+        deleteLabelWorkspace(ws);
+        return NULL;
+    }
+    return ws;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteLabelWorkspace( labelworkspace_t *ws )
+{
+    if(ws == NULL)
+    {
+        return;
+    }
+    free(ws->runs);
+    free(ws->parent);
+    free(ws);
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 void binaryEdgeDetect( const image_t *src
@@ -724,7 +1216,7 @@ void binaryEdgeDetect( const image_t *src
 // ----------------------------------------------------------------------------
 
 void blobAnalyse( const image_t *img
-                , const uint8_t blobnr
+                , const uint32_t blobnr
                 ,       blobinfo_t *blobInfo)
 {
     switch(img->type)
@@ -733,6 +1225,8 @@ void blobAnalyse( const image_t *img
         blobAnalyse_basic(img, blobnr, blobInfo);
     break;
     case IMGTYPE_INT16:
+        blobAnalyse_int16(img, blobnr, blobInfo);
+    break;
     case IMGTYPE_FLOAT:
         fprintf(stderr, "blobAnalyse(): image type %d not yet implemented\n", img->type);
     break;
@@ -747,7 +1241,7 @@ void blobAnalyse( const image_t *img
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 void centroid( const image_t *img
-             , const uint8_t blobnr
+             , const uint32_t blobnr
              ,       int32_t *cc
              ,       int32_t *rc)
 {
@@ -757,6 +1251,8 @@ void centroid( const image_t *img
         centroid_basic(img, blobnr, cc, rc);
     break;
     case IMGTYPE_INT16:
+        centroid_int16(img, blobnr, cc, rc);
+    break;
     case IMGTYPE_FLOAT:
         fprintf(stderr, "centroid(): image type %d not yet implemented\n", img->type);
     break;
@@ -771,7 +1267,7 @@ void centroid( const image_t *img
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 float normalizedCentralMoments( const image_t *img
-                              , const uint8_t blobnr
+                              , const uint32_t blobnr
                               , const int32_t p
                               , const int32_t q)
 {
@@ -780,6 +1276,7 @@ float normalizedCentralMoments( const image_t *img
     case IMGTYPE_BASIC:
         return normalizedCentralMoments_basic(img, blobnr, p, q);
     case IMGTYPE_INT16:
+        return normalizedCentralMoments_int16(img, blobnr, p, q);
     case IMGTYPE_FLOAT:
         fprintf(stderr, "normalizedCentralMoments(): image type %d not yet implemented\n", img->type);
     break;
@@ -793,6 +1290,71 @@ float normalizedCentralMoments( const image_t *img
     return 0.0f;
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void blobStatistics( const image_t *img
+                   ,       blobstats_t *stats
+                   , const uint32_t nof_blobs)
+{
+    switch(img->type)
+    {
+    case IMGTYPE_BASIC:
+        blobStatistics_basic(img, stats, nof_blobs);
+    break;
+    case IMGTYPE_INT16:
+        blobStatistics_int16(img, stats, nof_blobs);
+    break;
+    case IMGTYPE_FLOAT:
+        fprintf(stderr, "blobStatistics(): image type %d not yet implemented\n", img->type);
+    break;
+    case IMGTYPE_RGB888:
+    case IMGTYPE_RGB565:
+    default:
+        fprintf(stderr, "blobStatistics(): image type %d not supported\n", img->type);
+    break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void blobStatsCentroid( const blobstats_t *stats
+                      ,       int32_t *cc
+                      ,       int32_t *rc)
+{
+    *cc = (int32_t) ((double) stats->m10 / stats->m00 + 0.5);
+    *rc = (int32_t) ((double) stats->m01 / stats->m00 + 0.5);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// mu_20 = m_20 - m_10^2 / m_00, mu_02 = m_02 - m_01^2 / m_00
+// mu_11 = m_11 - m_10 * m_01 / m_00, eta_pq = mu_pq / m_00^2 for p + q == 2
+float blobStatsNormalizedCentralMoment( const blobstats_t *stats
+                                      , const int32_t p
+                                      , const int32_t q)
+{
+    double m00 = (double) stats->m00;
+    double mu;
+    if(p == 2 && q == 0)
+    {
+        mu = (double) stats->m20 - (double) stats->m10 * stats->m10 / m00;
+    }
+    else if(p == 0 && q == 2)
+    {
+        mu = (double) stats->m02 - (double) stats->m01 * stats->m01 / m00;
+    }
+    else if(p == 1 && q == 1)
+    {
+        mu = (double) stats->m11 - (double) stats->m10 * stats->m01 / m00;
+    }
+    else
+    {
+        fprintf(stderr, "blobStatsNormalizedCentralMoment(): only second order moments are supported\n");
+        return 0.0f;
+    }
+    return (float) (mu / (m00 * m00));
+}
+
 // ----------------------------------------------------------------------------
 // EOF
 // ----------------------------------------------------------------------------
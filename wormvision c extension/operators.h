@@ -23,6 +23,14 @@
 // Defines
 // ----------------------------------------------------------------------------
 
+// Fixed point format of the separable convolution kernels and the
+// intermediate result of the horizontal pass
+#define SEPARABLE_KERNEL_BITS 14
+#define SEPARABLE_TMP_BITS    7
+
+// Maximum number of blobs labelBlobsFast() can store in an int16 label image
+#define MAX_INT16_LABELS      32767
+
 // ----------------------------------------------------------------------------
 // Type definitions
 // ----------------------------------------------------------------------------
@@ -33,6 +41,7 @@ typedef enum
     IMGTYPE_FLOAT  = 2,  // Float
     IMGTYPE_RGB888 = 3,  // RGB 8-bit per pixel
     IMGTYPE_RGB565 = 4,
+    IMGTYPE_BINARY = 5,  // Bit-packed binary, see binary_word_t
   
     IMGTYPE_MAX    = 2147483647 // Max 32-bit int value,
                                 // forces enum to be 4 bytes
@@ -64,6 +73,11 @@ typedef struct rgb888_pixel_t
 
 typedef uint16_t rgb565_pixel_t;
 
+// IMGTYPE_BINARY images store 64 pixels in a word: bit b of word w of a row is
+// column 64 * w + b. The stride is in words and the bits after the last column
+// of a row are always 0, so rows can be processed word by word.
+typedef uint64_t binary_word_t;
+
 typedef struct complex_pixel_t
 {
     float real;
@@ -83,13 +97,35 @@ union pixel
 typedef union pixel pixel_t;
 
 // Get a single pixel given the image pointer, a column and a row
-#define BASIC_PIXEL(img,c,r)  (*(((basic_pixel_t  *)(img->data)) + ((r) * (img->cols) + (c))))
-#define INT16_PIXEL(img,c,r)  (*(((int16_pixel_t  *)(img->data)) + ((r) * (img->cols) + (c))))
-#define FLOAT_PIXEL(img,c,r)  (*(((float_pixel_t  *)(img->data)) + ((r) * (img->cols) + (c))))
-#define RGB888_PIXEL(img,c,r) (*(((rgb888_pixel_t *)(img->data)) + ((r) * (img->cols) + (c))))
-#define RGB565_PIXEL(img,c,r) (*(((rgb565_pixel_t *)(img->data)) + ((r) * (img->cols) + (c))))
+#define BASIC_PIXEL(img,c,r)  (*(((basic_pixel_t  *)(img->data)) + ((r) * (img->stride) + (c))))
+#define INT16_PIXEL(img,c,r)  (*(((int16_pixel_t  *)(img->data)) + ((r) * (img->stride) + (c))))
+#define FLOAT_PIXEL(img,c,r)  (*(((float_pixel_t  *)(img->data)) + ((r) * (img->stride) + (c))))
+#define RGB888_PIXEL(img,c,r) (*(((rgb888_pixel_t *)(img->data)) + ((r) * (img->stride) + (c))))
+#define RGB565_PIXEL(img,c,r) (*(((rgb565_pixel_t *)(img->data)) + ((r) * (img->stride) + (c))))
+
+#define BINARY_PIXEL(img,c,r) ((BINARY_ROW(img,r)[(c) / BINARY_WORD_BITS] >> ((c) % BINARY_WORD_BITS)) & 1)
+
+// Get a pointer to the first pixel of a row
+#define BASIC_ROW(img,r)      (((basic_pixel_t  *)((img)->data)) + (r) * (img)->stride)
+#define INT16_ROW(img,r)      (((int16_pixel_t  *)((img)->data)) + (r) * (img)->stride)
+#define FLOAT_ROW(img,r)      (((float_pixel_t  *)((img)->data)) + (r) * (img)->stride)
+#define BINARY_ROW(img,r)     (((binary_word_t  *)((img)->data)) + (r) * (img)->stride)
+
+// Pixels per word of an IMGTYPE_BINARY image and words per row of cols pixels
+#define BINARY_WORD_BITS      64
+#define BINARY_WORDS(cols)    (((cols) + BINARY_WORD_BITS - 1) / BINARY_WORD_BITS)
+
+// Rows are stored without padding, the image can be processed as a single
+// row of cols * rows pixels
+// (IMGTYPE_BINARY images as a single row of rows * BINARY_WORDS(cols) words,
+// see binary_word_t)
+#define IMG_IS_CONTIGUOUS(img) ((img)->stride == ((img)->type == IMGTYPE_BINARY ? \
+                                BINARY_WORDS((img)->cols) : (img)->cols))
 
 // Image type
+// stride is the distance between the first pixels of two rows in pixels, it
+// equals cols unless the image is a view into a larger image (see subImage())
+// For IMGTYPE_BINARY images the stride is in words, BINARY_WORDS(cols)
 typedef struct
 {
     int32_t     cols;
@@ -97,9 +133,21 @@ typedef struct
     eImageView  view;
     eImageType  type;
     uint8_t    *data;
+    int32_t     stride;
     
 }image_t;
 
+// Pixel statistics of a basic image: the min and max pixel value and the
+// histogram. The blur operators can produce them as a side output for the
+// contrast stretch and the automatic thresholds, see separableConvolutionStats()
+typedef struct pixelstats_t
+{
+    basic_pixel_t min;
+    basic_pixel_t max;
+    uint32_t      hist[256];
+
+}pixelstats_t;
+
 // Brightness
 typedef enum
 {
@@ -129,16 +177,61 @@ typedef enum
     
 }eFilterOperation;
 
+// Grayscale weights of the RGB888 conversion
+typedef enum
+{
+    GRAY_BT709 = 0,  // 0.212671 r + 0.715160 g + 0.072169 b, toBasicImage()
+    GRAY_BT601       // 0.299 r + 0.587 g + 0.114 b, cv2.cvtColor()
+
+}eGrayWeights;
+
 // BLOB info structure
 typedef struct blobinfo_t
 {
     uint16_t height;
     uint16_t width;
-    uint16_t nof_pixels;
+    uint32_t nof_pixels;
     float    perimeter;
     
 }blobinfo_t;
 
+// Per blob statistics, filled by blobStatistics()
+// Moments are the raw moments m_pq = sum(col^p * row^q)
+typedef struct blobstats_t
+{
+    uint32_t m00;        // number of pixels
+    uint64_t m10;
+    uint64_t m01;
+    uint64_t m20;
+    uint64_t m02;
+    uint64_t m11;
+    uint16_t min_col;    // bounding box
+    uint16_t max_col;
+    uint16_t min_row;
+    uint16_t max_row;
+    float    perimeter;  // same weights as blobAnalyse()
+    
+}blobstats_t;
+
+// Horizontal run of object pixels, used by labelBlobsFast()
+typedef struct labelrun_t
+{
+    int32_t  row;
+    int32_t  start;   // first column of the run
+    int32_t  end;     // last column of the run
+    uint32_t label;
+    
+}labelrun_t;
+
+// Workspace for labelBlobsFast(), see newLabelWorkspace()
+typedef struct labelworkspace_t
+{
+    uint32_t    max_runs;
+    labelrun_t *runs;
+    uint32_t   *parent;  // union-find forest of the runs
+    
+}labelworkspace_t;
+
 // ----------------------------------------------------------------------------
 // Function prototypes
 // ----------------------------------------------------------------------------
@@ -165,6 +258,7 @@ image_t *newInt16Image( const uint32_t cols, const uint32_t rows );
 image_t *newFloatImage( const uint32_t cols, const uint32_t rows );
 image_t *newRGB888Image( const uint32_t cols, const uint32_t rows );
 image_t *newRGB565Image( const uint32_t cols, const uint32_t rows );
+image_t *newBinaryImage( const uint32_t cols, const uint32_t rows );
 
 // These functions can be used for copying images
 // Memory is allocated within these functions
@@ -177,6 +271,7 @@ image_t *toInt16Image( image_t *src );
 image_t *toFloatImage( image_t *src );
 image_t *toRGB888Image( image_t *src );
 image_t *toRGB565Image( image_t *src );
+image_t *toBinaryImage( image_t *src );
 
 // Use the function deleteImage() for freeing memory
 // This function will automatically call the appropriate function based on the
@@ -190,6 +285,57 @@ void deleteInt16Image( image_t *img );
 void deleteFloatImage( image_t *img );
 void deleteRGB888Image( image_t *img );
 void deleteRGB565Image( image_t *img );
+void deleteBinaryImage( image_t *img );
+
+// Convert between binary basic images and bit-packed IMGTYPE_BINARY images,
+// without allocating memory. Non zero basic pixels are 1 in the binary image.
+//
+// Precondition : packBinary(): src is a basic image, dst is an IMGTYPE_BINARY
+//                image with the same size
+//                unpackBinary(): src is an IMGTYPE_BINARY image, dst is a
+//                basic image with the same size
+// Postcondition: dst is a binary image
+void packBinary( const image_t *src, image_t *dst );
+void unpackBinary( const image_t *src, image_t *dst );
+
+// Convert an RGB888 image (or view) to a grayscale basic image (or view),
+// without allocating memory. Set bgr if the channels are stored in b, g, r
+// order (opencv and the picamera 'bgr' format). GRAY_BT601 gives the same
+// pixels as cv2.cvtColor(src, cv2.COLOR_BGR2GRAY), GRAY_BT709 differs by 1
+// from the float conversion of toBasicImage() for about 0.01% of the colours.
+//
+// Precondition : src is an RGB888 image, dst is a basic image with the same
+//                size
+// Postcondition: -
+void rgb888ToGray( const image_t *src
+                 ,       image_t *dst
+                 , const int32_t bgr
+                 , const eGrayWeights weights
+                 );
+
+// Make view a cols x rows image that starts at (col, row) in src, without
+// copying pixel data. The view shares the pixel memory of src, so it must
+// not be deleted.
+// The basic operators that support views are the memory operators, point
+// operators, convolutions, labelBlobsFast(), fillHolesFast() and the blob
+// statistics. The other operators require IMG_IS_CONTIGUOUS(img).
+// All IMGTYPE_BINARY operators support views.
+//
+// Precondition : The rectangle lies within src
+//                IMGTYPE_BINARY: col is a multiple of BINARY_WORD_BITS and the
+//                rectangle ends at the last column of src
+// Postcondition: view->stride == src->stride
+void subImage( const image_t *src
+             ,       image_t *view
+             , const int32_t col
+             , const int32_t row
+             , const int32_t cols
+             , const int32_t rows
+             );
+
+// Returns the size of a single pixel in bytes
+// For IMGTYPE_BINARY: the size of a word of BINARY_WORD_BITS pixels
+uint32_t pixelSize( const eImageType type );
 
 // ----------------------------------------------------------------------------
 // Contrast stretching
@@ -214,6 +360,15 @@ void contrastStretch( const image_t *src
 // Postcondition: dst is a single channel image
 void contrastStretchFast( const image_t *src, image_t *dst );
 
+// Same as contrastStretchFast(), with the min and max of src taken from stats
+//
+// Precondition : img is a single channel image, stats are the statistics of src
+// Postcondition: dst is a single channel image
+void contrastStretchFastStats( const image_t *src
+                             ,       image_t *dst
+                             , const pixelstats_t *stats
+                             );
+
 // This function stretches the contrast for the R, G, and B channels
 // separately
 //
@@ -255,6 +410,9 @@ void rotate180( const image_t *img );
 // This function is used in all VisionSets. Without it, initially nothing will
 // seem to happen.
 //
+// dst can be an IMGTYPE_BINARY image for a basic src, low and high are then
+// clipped to 0 .. 255
+//
 // Precondition : img is a single channel image
 // Postcondition: dst is a binary image
 void threshold( const image_t *src
@@ -264,6 +422,8 @@ void threshold( const image_t *src
               );
 
 // Threshold values are automatically generated based on the 2-means method
+// The Stats variant uses the histogram and min/max of stats instead of
+// computing them
 //
 // Precondition : img is a single channel image
 // Postcondition: dst is a binary image
@@ -271,8 +431,14 @@ void threshold2Means( const image_t *src
                     ,       image_t *dst
                     , const eBrightness brightness
                     );
+void threshold2MeansStats( const image_t *src
+                         ,       image_t *dst
+                         , const eBrightness brightness
+                         , const pixelstats_t *stats
+                         );
 
 // Threshold values are automatically generated based on Otsu's method
+// The Stats variant uses the histogram of stats instead of computing it
 //
 // Precondition : img is a single channel image
 // Postcondition: dst is a binary image
@@ -280,6 +446,11 @@ void thresholdOtsu( const image_t *src
                   ,       image_t *dst
                   , const eBrightness brightness
                   );
+void thresholdOtsuStats( const image_t *src
+                       ,       image_t *dst
+                       , const eBrightness brightness
+                       , const pixelstats_t *stats
+                       );
 
 // ----------------------------------------------------------------------------
 // Miscellaneous
@@ -357,6 +528,36 @@ void invert( const image_t *src, image_t *dst);
 
 void gamma_evdk( const image_t *src, image_t *dst, const float c, const float g);
 
+// All pixels in src are mapped through a look up table with 256 entries
+// The look up table for gamma_evdk() can be created with gammaLUT_basic()
+//
+// Precondition : img is a single channel image
+// Postcondition: dst is a single channel image
+void applyLUT( const image_t *src, image_t *dst, const basic_pixel_t *LUT);
+
+// Same result as contrastStretchFast(src, tmp), applyLUT(tmp, tmp, LUT) and
+// threshold(tmp, dst, low, high), but src is read twice (min and max, then the
+// output) and dst written once: the three maps are composed in one look up
+// table. src and dst can be the same basic image.
+//
+// Precondition : src is a basic image, dst is a basic or IMGTYPE_BINARY image
+//                with the same size
+// Postcondition: dst is a binary image
+void stretchLUTThreshold( const image_t *src
+                        ,       image_t *dst
+                        , const basic_pixel_t *LUT
+                        , const int32_t low
+                        , const int32_t high
+                        );
+// With the min and max of src taken from stats, src is read once
+void stretchLUTThresholdStats( const image_t *src
+                             ,       image_t *dst
+                             , const basic_pixel_t *LUT
+                             , const int32_t low
+                             , const int32_t high
+                             , const pixelstats_t *stats
+                             );
+
 
 // ----------------------------------------------------------------------------
 // Filters
@@ -364,6 +565,7 @@ void gamma_evdk( const image_t *src, image_t *dst, const float c, const float g)
 
 // A set of nonlinear filters
 // n equals the mask size
+// Except for HARMONIC the time per pixel does not depend on n
 //
 // Precondition : img is a single channel image
 //                n must be an odd number
@@ -382,7 +584,85 @@ void gaussianBlur( const image_t *src
 void convolution( const image_t *src
                       , image_t *dst
                         , const image_t *kernel);
+// Same as convolution(), stats is filled with the statistics of dst
+void convolutionStats( const image_t *src
+                     ,       image_t *dst
+                     , const image_t *kernel
+                     ,       pixelstats_t *stats);
+
+// The kernel image is filled with a normalized gaussian kernel
+// Can be used to create the kernel for convolution() once, instead of
+// creating it in every gaussianBlur() call
+//
+// Precondition : kernel is a square float image with an odd size
+// Postcondition: -
+void gaussianKernel( image_t *kernel, const double sigma );
 
+// Gaussian blur implemented as a horizontal and a vertical pass with fixed
+// point kernels. The result is within +-1 of gaussianBlur(), but the cost per
+// pixel grows linearly instead of quadratically with the kernel size.
+//
+// Precondition : img is a single channel image
+//                kernelSize must be an odd number
+// Postcondition: dst is a single channel image
+void gaussianBlurSeparable( const image_t *src
+                          ,       image_t *dst
+                          , const int32_t kernelSize
+                          , const double sigma);
+
+// The kernel image is filled with a normalized fixed point 1D gaussian kernel
+// for separableConvolution(), with SEPARABLE_KERNEL_BITS fractional bits
+//
+// Precondition : kernel is an int16 image of kernelSize x 1 pixels
+// Postcondition: -
+void gaussianKernel1D( image_t *kernel, const double sigma );
+
+// Convolution with a separable kernel, the 1D kernel is applied horizontally
+// and then vertically. tmp holds the result of the horizontal pass, so no
+// memory is allocated. src and dst can be the same image.
+//
+// Precondition : img is a single channel image
+//                tmp is an int16 image with the same size as src
+//                kernel is an int16 image created by gaussianKernel1D()
+// Postcondition: dst is a single channel image
+void separableConvolution( const image_t *src
+                         ,       image_t *dst
+                         ,       image_t *tmp
+                         , const image_t *kernel);
+
+// Same as separableConvolution(), stats is filled with the min, max and
+// histogram of dst while the rows are written. Pass them to the Stats variants
+// of the stretch and threshold operators to skip their scans of dst, as long
+// as dst is not changed in between.
+//
+// Precondition : see separableConvolution()
+// Postcondition: dst is a single channel image, stats are its statistics
+void separableConvolutionStats( const image_t *src
+                              ,       image_t *dst
+                              ,       image_t *tmp
+                              , const image_t *kernel
+                              ,       pixelstats_t *stats);
+
+// Gaussian pyramid downsample: dst is src blurred with the 5 x 5 binomial
+// kernel and sampled at every second column and row (the same as
+// cv2.pyrDown()). tmp holds one filtered row, so no memory is allocated.
+//
+// Precondition : src is a basic image (or view), dst is a basic image of
+//                (src->cols + 1) / 2 x (src->rows + 1) / 2 pixels
+//                tmp is an int16 image of at least src->cols x 1 pixels
+// Postcondition: -
+void pyramidDown( const image_t *src
+                ,       image_t *dst
+                ,       image_t *tmp);
+
+// Binary morphology with the non zero pixels of kernel as structuring element
+// The structuring element is decomposed in rectangles on bit-packed rows, see
+// morphology.h. Use a morphworkspace_t to avoid the allocations when the
+// same structuring element is used for every frame.
+//
+// Precondition : src is a binary basic or IMGTYPE_BINARY image, kernel is a
+//                basic image
+// Postcondition: dst is a binary basic or IMGTYPE_BINARY image
 void morph_erode(const image_t *src, image_t *dst, const image_t *kernel);
 
 void morph_dilate(const image_t *src, image_t *dst, const image_t *kernel);
@@ -413,6 +693,19 @@ void fillHoles( const image_t *src
               , const eConnected connected
               );
 
+// Fill holes in a single flood fill from the background pixels on the image
+// border, same result as fillHoles(). connected is the connectivity of the
+// background. queue must hold src->cols * src->rows entries, or be NULL to
+// allocate a temporary queue.
+//
+// Precondition : img is a binary image
+// Postcondition: dst is a binary image
+void fillHolesFast( const image_t *src
+                  ,       image_t *dst
+                  , const eConnected connected
+                  ,       uint32_t *queue
+                  );
+
 // Label all blobs, returns the number of labeled blobs
 //
 // Precondition : img is a binary image
@@ -422,6 +715,33 @@ uint32_t labelBlobs( const image_t *src
                    , const eConnected connected
                    );
 
+// Label all blobs in a single scan of the image, returns the number of labeled
+// blobs. Object pixels are collected in horizontal runs, runs that touch a run
+// in the previous row are merged with union-find. Blobs are numbered 1..n in
+// the order of their first pixel (left top to right bottom), background is 0.
+// Returns 0 and prints an error if more than MAX_INT16_LABELS blobs are found.
+// ws is a workspace created by newLabelWorkspace() for images of at least the
+// size of src, or NULL to allocate a temporary workspace.
+//
+// Precondition : src is a binary basic image
+//                dst is an int16 image with the same size as src
+// Postcondition: dst is a labeled int16 image
+uint32_t labelBlobsFast( const image_t *src
+                       ,       image_t *dst
+                       , const eConnected connected
+                       ,       labelworkspace_t *ws
+                       );
+
+// Create a workspace for labelBlobsFast() for images of cols x rows pixels
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling
+//                deleteLabelWorkspace(), returns NULL if memory could not be
+//                allocated
+labelworkspace_t *newLabelWorkspace( const uint32_t cols, const uint32_t rows );
+void deleteLabelWorkspace( labelworkspace_t *ws );
+
 // Find the edges of binary objects
 //
 // Precondition : img is a binary image
@@ -437,20 +757,20 @@ void binaryEdgeDetect( const image_t *src
 
 // Analyse blobs
 //
-// Precondition : img is a labeled image
+// Precondition : img is a labeled basic or int16 image
 //                pBlobInfo points to a blobinfo_t struct declared by the
 //                calling program
 // Postcondition: -
 void blobAnalyse( const image_t *img
-                , const uint8_t blobnr
+                , const uint32_t blobnr
                 ,       blobinfo_t *blobInfo);
 
 // Calculates the centroid of a blob
 //
-// Precondition : img is a labeled image
+// Precondition : img is a labeled basic or int16 image
 // Postcondition: -
 void centroid( const image_t *img
-             , const uint8_t blobnr
+             , const uint32_t blobnr
              ,       int32_t *cc
              ,       int32_t *rc
              );
@@ -460,15 +780,48 @@ void centroid( const image_t *img
 //       In Digital Image Processing. pp. 839-842.
 //       New Jersey: Pearson Prentice Hall.
 //
-// Precondition : img is a binary or labeled image
+// Precondition : img is a binary or labeled basic or int16 image
 //                blobnr must be '1' if img is binary
 // Postcondition: -
 float normalizedCentralMoments( const image_t *img
-                              , const uint8_t blobnr
+                              , const uint32_t blobnr
                               , const int32_t p
                               , const int32_t q
                               );
 
+// Calculates the statistics of all blobs in a single scan of the image
+// stats[i] is filled with the statistics of blob i + 1, labels above
+// nof_blobs are ignored. Blobs without pixels get m00 = 0.
+//
+// Precondition : img is a labeled basic or int16 image
+//                stats points to an array of nof_blobs elements
+// Postcondition: -
+void blobStatistics( const image_t *img
+                   ,       blobstats_t *stats
+                   , const uint32_t nof_blobs
+                   );
+
+// Calculates the centroid of a blob from its statistics, rounded to the
+// nearest pixel like centroid()
+//
+// Precondition : stats->m00 > 0
+// Postcondition: -
+void blobStatsCentroid( const blobstats_t *stats
+                      ,       int32_t *cc
+                      ,       int32_t *rc
+                      );
+
+// Calculates a second order (p + q == 2) normalized central moment of a blob
+// from its statistics, see normalizedCentralMoments()
+//
+// Precondition : stats->m00 > 0
+//                p + q == 2
+// Postcondition: -
+float blobStatsNormalizedCentralMoment( const blobstats_t *stats
+                                      , const int32_t p
+                                      , const int32_t q
+                                      );
+
 #endif // _OPERATORS_H_
 // ----------------------------------------------------------------------------
 // EOF
@@ -35,8 +35,19 @@ void contrastStretch_basic( const image_t *src
                           , const basic_pixel_t top
                           );
 
+// The statistics operators compute stats themselves if it is NULL
 void contrastStretchFast_basic( const image_t *src
                               ,       image_t *dst
+                              , const pixelstats_t *stats
+                              );
+
+// dst is a basic or IMGTYPE_BINARY image
+void stretchLUTThreshold_basic( const image_t *src
+                              ,       image_t *dst
+                              , const basic_pixel_t *LUT
+                              , const int32_t low
+                              , const int32_t high
+                              , const pixelstats_t *stats
                               );
 
 // ----------------------------------------------------------------------------
@@ -59,11 +70,13 @@ void threshold_basic( const image_t *src
 void threshold2Means_basic( const image_t *src
                           ,       image_t *dst
                           , const eBrightness brightness
+                          , const pixelstats_t *stats
                           );
 
 void thresholdOtsu_basic( const image_t *src
                         ,       image_t *dst
                         , const eBrightness brightness
+                        , const pixelstats_t *stats
                         );
 
 // ----------------------------------------------------------------------------
@@ -103,6 +116,10 @@ void invert_basic( const image_t *src, image_t *dst);
 
 void gamma_basic( const image_t *src, image_t *dst, const float c, const float g);
 
+void gammaLUT_basic( basic_pixel_t *LUT, const float c, const float g);
+
+void applyLUT_basic( const image_t *src, image_t *dst, const basic_pixel_t *LUT);
+
 
 // ----------------------------------------------------------------------------
 // Filters
@@ -119,9 +136,28 @@ void gaussianBlur_basic( const image_t *src
                        , const int32_t kernelSize
                        , const double sigma);
 
+// stats is NULL or filled with the statistics of dst
 void convolution_basic( const image_t *src
                       , const image_t *dst
-                        , const image_t *kernel);
+                      , const image_t *kernel
+                      ,       pixelstats_t *stats);
+
+void gaussianBlurSeparable_basic( const image_t *src
+                                ,       image_t *dst
+                                , const int32_t kernelSize
+                                , const double sigma);
+
+void gaussianKernel1D_basic( image_t *kernel, const double sigma );
+
+void separableConvolution_basic( const image_t *src
+                               ,       image_t *dst
+                               ,       image_t *tmp
+                               , const image_t *kernel
+                               ,       pixelstats_t *stats);
+
+void pyramidDown_basic( const image_t *src
+                      ,       image_t *dst
+                      ,       image_t *tmp);
 
 // ----------------------------------------------------------------------------
 // Morphology
@@ -148,6 +184,12 @@ void fillHoles_basic( const image_t *src
                     , const eConnected connected
                     );
 
+void fillHolesFast_basic( const image_t *src
+                        ,       image_t *dst
+                        , const eConnected connected
+                        ,       uint32_t *queue
+                        );
+
 uint32_t labelBlobs_basic( const image_t *src
                          ,       image_t *dst
                          , const eConnected connected);
@@ -161,6 +203,12 @@ void binaryEdgeDetect_basic( const image_t *src
 // Analysis
 // ----------------------------------------------------------------------------
 
+uint32_t labelBlobsFast_basic( const image_t *src
+                             ,       image_t *dst
+                             , const eConnected connected
+                             ,       labelworkspace_t *ws
+                             );
+
 void blobAnalyse_basic( const image_t *img
                       , const uint8_t blobnr
                       ,       blobinfo_t *blobInfo);
@@ -171,6 +219,11 @@ void centroid_basic( const image_t *img
                    ,       int32_t *rc
                    );
 
+void blobStatistics_basic( const image_t *img
+                         ,       blobstats_t *stats
+                         , const uint32_t nof_blobs
+                         );
+
 float normalizedCentralMoments_basic( const image_t *img
                                     , const uint8_t blobnr
                                     , const int32_t p
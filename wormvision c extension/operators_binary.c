@@ -0,0 +1,396 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for bit-packed binary image processing
+ *              operators
+ *
+ *              All operators process the rows word by word and keep the bits
+ *              after the last column of a row 0.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "operators_binary.h"
+#include "string.h"
+
+// Mask of the bits of the last word of a row that are columns
+#define LAST_WORD_MASK(cols) ((cols) % BINARY_WORD_BITS ? \
+                              ((binary_word_t)1 << ((cols) % BINARY_WORD_BITS)) - 1 : ~(binary_word_t)0)
+
+// Number of 1 bits in a word
+static uint32_t popcount64(binary_word_t x)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (uint32_t)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Pixels c - 1, c and c + 1 of a row in bits 0, 1 and 2, columns outside the
+// row are 0
+static uint32_t rowWindow(const binary_word_t *row, const int32_t c, const int32_t cols)
+{
+    register const int32_t start = c - 1;
+    register binary_word_t bits;
+
+    if(start < 0)
+    {
+        bits = row[0] << 1;
+    }
+    else
+    {
+        bits = row[start / BINARY_WORD_BITS] >> (start % BINARY_WORD_BITS);
+        if(start % BINARY_WORD_BITS > BINARY_WORD_BITS - 3 && start / BINARY_WORD_BITS + 1 < BINARY_WORDS(cols))
+        {
+            bits |= row[start / BINARY_WORD_BITS + 1] << (BINARY_WORD_BITS - start % BINARY_WORD_BITS);
+        }
+    }
+    return (uint32_t)(bits & 7);
+}
+
+// ----------------------------------------------------------------------------
+// Function implementations
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+image_t *newBinaryImage(const uint32_t cols, const uint32_t rows)
+{
+    image_t *img = (image_t *)malloc(sizeof(image_t));
+    if(img == NULL)
+    {
+        // Unable to allocate memory for new image
+        return NULL;
+    }
+
+    // calloc: the bits after the last column must be 0
+    img->data = (unsigned char *)calloc(rows * BINARY_WORDS(cols), sizeof(binary_word_t));
+    if(img->data == NULL)
+    {
+        // Unable to allocate memory for data
+        free(img);
+        return NULL;
+    }
+
+    img->cols = cols;
+    img->rows = rows;
+    img->stride = BINARY_WORDS(cols);
+    img->view = IMGVIEW_BINARY;
+    img->type = IMGTYPE_BINARY;
+    return(img);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+image_t *toBinaryImage(image_t *src)
+{
+    image_t *dst = newBinaryImage(src->cols, src->rows);
+    if(dst == NULL)
+        return NULL;
+
+    switch(src->type)
+    {
+    case IMGTYPE_BASIC:
+    {
+        toBinary_basic(src, dst);
+
+    }break;
+    case IMGTYPE_BINARY:
+    {
+        copy_binary(src, dst);
+
+    }break;
+    default:
+    break;
+    }
+
+    return dst;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteBinaryImage(image_t *img)
+{
+    free(img->data);
+    free(img);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void toBinary_basic(const image_t *src, image_t *dst)
+{
+    register int32_t row;
+    register int32_t col;
+    register uint32_t bits;
+    register const basic_pixel_t *s;
+    register binary_word_t *d;
+
+    for(row = 0; row < src->rows; row++)
+    {
+        s = BASIC_ROW(src, row);
+        d = BINARY_ROW(dst, row);
+        memset(d, 0, BINARY_WORDS(src->cols) * sizeof(binary_word_t));
+        // 8 pixels at a time
+        for(col = 0; col + 8 <= src->cols; col += 8)
+        {
+            bits = (s[col] != 0)          | (s[col + 1] != 0) << 1 |
+                   (s[col + 2] != 0) << 2 | (s[col + 3] != 0) << 3 |
+                   (s[col + 4] != 0) << 4 | (s[col + 5] != 0) << 5 |
+                   (s[col + 6] != 0) << 6 | (s[col + 7] != 0) << 7;
+            d[col / BINARY_WORD_BITS] |= (binary_word_t)bits << (col % BINARY_WORD_BITS);
+        }
+        for(; col < src->cols; col++)
+        {
+            d[col / BINARY_WORD_BITS] |= (binary_word_t)(s[col] != 0) << (col % BINARY_WORD_BITS);
+        }
+    }
+    dst->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void toBasic_binary(const image_t *src, image_t *dst)
+{
+    register int32_t row;
+    register int32_t col;
+    register uint32_t bits;
+    register const binary_word_t *s;
+    register basic_pixel_t *d;
+
+    for(row = 0; row < src->rows; row++)
+    {
+        s = BINARY_ROW(src, row);
+        d = BASIC_ROW(dst, row);
+        // 8 pixels at a time
+        for(col = 0; col + 8 <= src->cols; col += 8)
+        {
+            bits = (uint32_t)(s[col / BINARY_WORD_BITS] >> (col % BINARY_WORD_BITS));
+            d[col]     = bits & 1;        d[col + 1] = (bits >> 1) & 1;
+            d[col + 2] = (bits >> 2) & 1; d[col + 3] = (bits >> 3) & 1;
+            d[col + 4] = (bits >> 4) & 1; d[col + 5] = (bits >> 5) & 1;
+            d[col + 6] = (bits >> 6) & 1; d[col + 7] = (bits >> 7) & 1;
+        }
+        for(; col < src->cols; col++)
+        {
+            d[col] = (basic_pixel_t)((s[col / BINARY_WORD_BITS] >> (col % BINARY_WORD_BITS)) & 1);
+        }
+    }
+    dst->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void threshold_binary(const image_t *src,
+                            image_t *dst,
+                      const int32_t low,
+                      const int32_t high)
+{
+    register const int32_t lo = low < 0 ? 0 : low;
+    register const int32_t hi = high > 255 ? 255 : high;
+    // one compare per pixel: p - lo wraps around for p < lo
+    register const basic_pixel_t range = (basic_pixel_t)(hi - lo);
+    register int32_t row;
+    register int32_t col;
+    register uint32_t bits;
+    register const basic_pixel_t *s;
+    register binary_word_t *d;
+
+    if(lo > hi)
+    {
+        erase_binary(dst);
+        return;
+    }
+    for(row = 0; row < src->rows; row++)
+    {
+        s = BASIC_ROW(src, row);
+        d = BINARY_ROW(dst, row);
+        memset(d, 0, BINARY_WORDS(src->cols) * sizeof(binary_word_t));
+        // 8 pixels at a time
+        for(col = 0; col + 8 <= src->cols; col += 8)
+        {
+            bits = ((basic_pixel_t)(s[col] - lo) <= range)          |
+                   ((basic_pixel_t)(s[col + 1] - lo) <= range) << 1 |
+                   ((basic_pixel_t)(s[col + 2] - lo) <= range) << 2 |
+                   ((basic_pixel_t)(s[col + 3] - lo) <= range) << 3 |
+                   ((basic_pixel_t)(s[col + 4] - lo) <= range) << 4 |
+                   ((basic_pixel_t)(s[col + 5] - lo) <= range) << 5 |
+                   ((basic_pixel_t)(s[col + 6] - lo) <= range) << 6 |
+                   ((basic_pixel_t)(s[col + 7] - lo) <= range) << 7;
+            d[col / BINARY_WORD_BITS] |= (binary_word_t)bits << (col % BINARY_WORD_BITS);
+        }
+        for(; col < src->cols; col++)
+        {
+            d[col / BINARY_WORD_BITS] |= (binary_word_t)((basic_pixel_t)(s[col] - lo) <= range)
+                                         << (col % BINARY_WORD_BITS);
+        }
+    }
+    dst->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void applyLUT_binary(const image_t *src, image_t *dst, const basic_pixel_t *LUT)
+{
+    register int32_t row;
+    register int32_t col;
+    register uint32_t bits;
+    register const basic_pixel_t *s;
+    register binary_word_t *d;
+
+    for(row = 0; row < src->rows; row++)
+    {
+        s = BASIC_ROW(src, row);
+        d = BINARY_ROW(dst, row);
+        memset(d, 0, BINARY_WORDS(src->cols) * sizeof(binary_word_t));
+        // 8 pixels at a time
+        for(col = 0; col + 8 <= src->cols; col += 8)
+        {
+            bits = (LUT[s[col]] != 0)          | (LUT[s[col + 1]] != 0) << 1 |
+                   (LUT[s[col + 2]] != 0) << 2 | (LUT[s[col + 3]] != 0) << 3 |
+                   (LUT[s[col + 4]] != 0) << 4 | (LUT[s[col + 5]] != 0) << 5 |
+                   (LUT[s[col + 6]] != 0) << 6 | (LUT[s[col + 7]] != 0) << 7;
+            d[col / BINARY_WORD_BITS] |= (binary_word_t)bits << (col % BINARY_WORD_BITS);
+        }
+        for(; col < src->cols; col++)
+        {
+            d[col / BINARY_WORD_BITS] |= (binary_word_t)(LUT[s[col]] != 0) << (col % BINARY_WORD_BITS);
+        }
+    }
+    dst->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void erase_binary(const image_t *img)
+{
+    register int32_t row;
+    for(row = 0; row < img->rows; row++)
+    {
+        memset(BINARY_ROW(img, row), 0, BINARY_WORDS(img->cols) * sizeof(binary_word_t));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// src and dst have the same size
+void copy_binary(const image_t *src, image_t *dst)
+{
+    register int32_t row;
+    if(src->data != dst->data && IMG_IS_CONTIGUOUS(src) && IMG_IS_CONTIGUOUS(dst))
+    {
+        memcpy(dst->data, src->data, src->rows * BINARY_WORDS(src->cols) * sizeof(binary_word_t));
+    }
+    else if(src->data != dst->data)
+    {
+        for(row = 0; row < src->rows; row++)
+        {
+            memcpy(BINARY_ROW(dst, row), BINARY_ROW(src, row), BINARY_WORDS(src->cols) * sizeof(binary_word_t));
+        }
+    }
+    dst->view = src->view;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void invert_binary(const image_t *src, image_t *dst)
+{
+    register const int32_t words = BINARY_WORDS(src->cols);
+    register const binary_word_t mask = LAST_WORD_MASK(src->cols);
+    register int32_t row;
+    register int32_t w;
+    register const binary_word_t *s;
+    register binary_word_t *d;
+
+    for(row = 0; row < src->rows; row++)
+    {
+        s = BINARY_ROW(src, row);
+        d = BINARY_ROW(dst, row);
+        for(w = 0; w < words; w++)
+        {
+            d[w] = ~s[w];
+        }
+        d[words - 1] &= mask;
+    }
+    dst->view = IMGVIEW_BINARY;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// number of pixels with value 1
+uint32_t sum_binary(const image_t *img)
+{
+    register const int32_t words = BINARY_WORDS(img->cols);
+    register int32_t row;
+    register int32_t w;
+    register const binary_word_t *s;
+    register uint32_t sum = 0;
+
+    for(row = 0; row < img->rows; row++)
+    {
+        s = BINARY_ROW(img, row);
+        for(w = 0; w < words; w++)
+        {
+            sum += popcount64(s[w]);
+        }
+    }
+    return sum;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// Same result as neighbourCount_basic(), the 3 pixels of each row of the
+// neighbourhood are counted at once
+uint32_t neighbourCount_binary(const image_t *img,
+                               const int32_t c,
+                               const int32_t r,
+                               const int32_t pixel,
+                               const eConnected connected)
+{
+    // neighbours in the row above/below and in the row itself
+    register const uint32_t outer = connected == EIGHT ? 7 : 2;
+    register const uint32_t inner = 5;
+    // columns that are in the image
+    register uint32_t valid = 7;
+    register uint32_t count = 0;
+    register uint32_t bits;
+
+    if(pixel != 0 && pixel != 1)
+    {
+        return 0;
+    }
+    if(c == 0)
+    {
+        valid &= ~1u;
+    }
+    if(c + 1 >= img->cols)
+    {
+        valid &= ~4u;
+    }
+
+    // pixel 0 counts the 0 bits of the neighbours
+    bits = rowWindow(BINARY_ROW(img, r), c, img->cols);
+    count += popcount64((pixel ? bits : ~bits) & inner & valid);
+    if(r - 1 >= 0)
+    {
+        bits = rowWindow(BINARY_ROW(img, r - 1), c, img->cols);
+        count += popcount64((pixel ? bits : ~bits) & outer & valid);
+    }
+    if(r + 1 < img->rows)
+    {
+        bits = rowWindow(BINARY_ROW(img, r + 1), c, img->cols);
+        count += popcount64((pixel ? bits : ~bits) & outer & valid);
+    }
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
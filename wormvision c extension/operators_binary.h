@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for bit-packed binary image processing operators
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _OPERATORS_BINARY_H_
+#define _OPERATORS_BINARY_H_
+
+#include "stdint.h"
+#include "operators.h"
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// src is a basic image, dst is a binary image
+void toBinary_basic( const image_t *src, image_t *dst );
+
+// src is a binary image, dst is a basic image
+void toBasic_binary( const image_t *src, image_t *dst );
+
+// src is a basic image, dst is a binary image
+void threshold_binary( const image_t *src
+                     ,       image_t *dst
+                     , const int32_t low
+                     , const int32_t high
+                     );
+
+// src is a basic image, dst is a binary image: the pixels with LUT[pixel] != 0
+// are set
+void applyLUT_binary( const image_t *src
+                    ,       image_t *dst
+                    , const basic_pixel_t *LUT
+                    );
+
+void erase_binary( const image_t *img );
+
+void copy_binary( const image_t *src, image_t *dst );
+
+void invert_binary( const image_t *src, image_t *dst );
+
+uint32_t sum_binary( const image_t *img );
+
+uint32_t neighbourCount_binary( const image_t *img
+                              , const int32_t c
+                              , const int32_t r
+                              , const int32_t pixel
+                              , const eConnected connected
+                              );
+
+#endif // _OPERATORS_BINARY_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
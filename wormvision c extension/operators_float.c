@@ -16,6 +16,10 @@
 #include "float.h"
 #include "math.h"
 
+#ifndef M_PI
+#define M_PI		3.14159265358979323846
+#endif
+
 // ----------------------------------------------------------------------------
 // Function implementations
 // ----------------------------------------------------------------------------
@@ -41,6 +45,7 @@ image_t *newFloatImage(const uint32_t cols, const uint32_t rows)
 
     img->cols = cols;
     img->rows = rows;
+    img->stride = cols;
     img->view = IMGVIEW_CLIP;
     img->type = IMGTYPE_FLOAT;
     return(img);
@@ -180,6 +185,7 @@ void copy_float(const image_t *src, image_t *dst)
 
     dst->rows = src->rows;
     dst->cols = src->cols;
+    dst->stride = src->cols;
     dst->type = src->type;
     dst->view = src->view;
 
@@ -208,6 +214,36 @@ void setSelectedToValue_float(const image_t *src,
 
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// kernel -> square float image with an odd size, filled with a normalized kernel
+void gaussianKernel_float(image_t *kernel, const double sigma)
+{
+    // implementation taken from https://www.geeksforgeeks.org/gaussian-filter-generation-c/
+    register float_pixel_t *k = (float_pixel_t *) kernel->data;
+    register double s = 2.0 * sigma * sigma;
+    register double r;
+    register double sum = 0.0; // sum used for normalization
+    register int32_t kernelSize = kernel->cols;
+
+    // generate kernel
+    for (int x = -kernelSize / 2; x <= kernelSize / 2; x++) {
+        for (int y = -kernelSize / 2; y <= kernelSize / 2; y++) {
+            r = sqrt(x * x + y * y);
+            *k = (float_pixel_t) ((exp(-(r * r) / s)) / (M_PI * s));
+            sum += *k++;
+        }
+    }
+
+    // normalising the Kernel
+    k = (float_pixel_t *) kernel->data;
+    for (int i = 0; i < kernelSize; ++i) {
+        for (int j = 0; j < kernelSize; ++j) {
+            *k++ /= (float_pixel_t) sum;
+        }
+    }
+}
+
 // ----------------------------------------------------------------------------
 // EOF
 // ----------------------------------------------------------------------------
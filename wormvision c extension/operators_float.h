@@ -44,6 +44,8 @@ void setSelectedToValue_float( const image_t *src
                              , const float_pixel_t value
                              );
 
+void gaussianKernel_float( image_t *kernel, const double sigma );
+
 #endif // _OPERATORS_FLOAT_H_
 // ----------------------------------------------------------------------------
 // EOF
@@ -40,6 +40,7 @@ image_t *newInt16Image(const uint32_t cols, const uint32_t rows)
 
     img->cols = cols;
     img->rows = rows;
+    img->stride = cols;
     img->view = IMGVIEW_CLIP;
     img->type = IMGTYPE_INT16;
     return(img);
@@ -140,12 +141,18 @@ void contrastStretch_int16(const image_t *src,
 // ----------------------------------------------------------------------------
 void erase_int16(const image_t *img)
 {
-    register long int  i = img->rows * img->cols;
-    register int16_pixel_t *s = (int16_pixel_t *)img->data;
+    register long int  i;
+    register int16_pixel_t *s;
+    register int32_t row;
 
     // Loop through the image and set all pixels to the value 0
-    while(i-- > 0)
-        *s++ = 0;
+    for(row = 0; row < img->rows; row++)
+    {
+        i = img->cols;
+        s = INT16_ROW(img, row);
+        while(i-- > 0)
+            *s++ = 0;
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -178,6 +185,7 @@ void copy_int16(const image_t *src, image_t *dst)
 
     dst->rows = src->rows;
     dst->cols = src->cols;
+    dst->stride = src->cols;
     dst->type = src->type;
     dst->view = src->view;
 
@@ -207,6 +215,244 @@ void setSelectedToValue_int16(const image_t *src,
 
 }
 
+// ----------------------------------------------------------------------------
+// Analysis of int16 label images, see labelBlobsFast()
+// ----------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// returns the number of 4 connected background neighbours of pixel (c, r)
+static uint32_t backgroundCount_int16(const image_t *img,
+                                      const int32_t c,
+                                      const int32_t r)
+{
+    register uint32_t count = 0;
+    if(r - 1 >= 0 && INT16_PIXEL(img, c, r-1) == 0)
+        count++;
+    if(c - 1 >= 0 && INT16_PIXEL(img, c-1, r) == 0)
+        count++;
+    if(r + 1 < img->rows && INT16_PIXEL(img, c, r+1) == 0)
+        count++;
+    if(c + 1 < img->cols && INT16_PIXEL(img, c+1, r) == 0)
+        count++;
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void blobAnalyse_int16(const image_t *img,
+                       const uint32_t blobnr,
+                             blobinfo_t *blobInfo)
+{
+    register int32_t min_row = img->rows - 1;
+    register int32_t max_row = 0;
+    register int32_t min_col = img->cols - 1;
+    register int32_t max_col = 0;
+    register uint32_t pixel_count = 0;
+    register int16_pixel_t *ip = (int16_pixel_t *)img->data;
+    register int32_t row;
+    register int32_t col;
+    register float perimeter = 0.0f;
+    register uint32_t neighbours;
+
+    for(row = 0; row < img->rows; row++)
+    {
+        ip = INT16_ROW(img, row);
+        for(col = 0; col < img->cols; col++)
+        {
+            if((uint32_t)*ip++ != blobnr)
+                continue;
+
+            // track bounding rows / columns
+            if(col < min_col)
+                min_col = col;
+            if(col > max_col)
+                max_col = col;
+            if(row < min_row)
+                min_row = row;
+            if(row > max_row)
+                max_row = row;
+
+            pixel_count++;
+
+            // keep track of perimeter, same weights as blobAnalyse_basic()
+            neighbours = backgroundCount_int16(img, col, row);
+            if(neighbours == 1)
+                perimeter += 1.0f;
+            else if(neighbours == 2)
+                perimeter += (float)sqrt(2);
+            else if(neighbours == 3)
+                perimeter += (float)0.5f / (1.0f + (float)sqrt(2));
+        }
+    }
+    blobInfo->height = max_row - min_row + 1;
+    blobInfo->width = max_col - min_col + 1;
+    blobInfo->nof_pixels = pixel_count;
+    blobInfo->perimeter = perimeter;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void centroid_int16(const image_t *img,
+                    const uint32_t blobnr,
+                          int32_t *cc,
+                          int32_t *rc)
+{
+    register uint32_t m_00 = 0;
+    register uint32_t m_01 = 0;
+    register uint32_t m_10 = 0;
+    register int16_pixel_t *ip = (int16_pixel_t *)img->data;
+    register int32_t row;
+    register int32_t col;
+
+    for(row = 0; row < img->rows; row++)
+    {
+        ip = INT16_ROW(img, row);
+        for(col = 0; col < img->cols; col++)
+        {
+            if((uint32_t)*ip++ == blobnr)
+            {
+                m_00 += 1;
+                m_01 += row;
+                m_10 += col;
+            }
+        }
+    }
+    *cc = (int32_t)((float)m_10 / (float)m_00 + 0.5f);
+    *rc = (int32_t)((float)m_01 / (float)m_00 + 0.5f);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+float normalizedCentralMoments_int16(const image_t *img,
+                                     const uint32_t blobnr,
+                                     const int32_t p,
+                                     const int32_t q)
+{
+    if((p == 0 && q == 1) || (p == 1 && q == 0))
+        return 0.0f;
+    if(p == 0 && q == 0)
+        return 1.0f;
+
+    register uint32_t m_00 = 0;
+    register uint32_t m_01 = 0;
+    register uint32_t m_10 = 0;
+    register int16_pixel_t *ip = (int16_pixel_t *)img->data;
+    register int32_t row;
+    register int32_t col;
+
+    // calculate m_00, m_01 and m_10
+    for(row = 0; row < img->rows; row++)
+    {
+        ip = INT16_ROW(img, row);
+        for(col = 0; col < img->cols; col++)
+        {
+            if((uint32_t)*ip++ == blobnr)
+            {
+                m_00 += 1;
+                m_01 += row;
+                m_10 += col;
+            }
+        }
+    }
+
+    // calculate centroid
+    register float cc = (float)m_10 / (float)m_00;
+    register float rc = (float)m_01 / (float)m_00;
+
+    // calculate central moment
+    register float central_moment = 0.0f;
+    ip = (int16_pixel_t *)img->data;
+    for(row = 0; row < img->rows; row++)
+    {
+        ip = INT16_ROW(img, row);
+        for(col = 0; col < img->cols; col++)
+        {
+            if((uint32_t)*ip++ == blobnr)
+                central_moment += powf(col - cc, p) * powf(row - rc, q);
+        }
+    }
+    return central_moment / powf(m_00, (p + q) / 2.0f + 1.0f);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+// single raster pass: moments, bounding box and perimeter of all blobs
+void blobStatistics_int16(const image_t *img,
+                                blobstats_t *stats,
+                          const uint32_t nof_blobs)
+{
+    register const int32_t cols = img->cols;
+    register const int32_t rows = img->rows;
+    register const int32_t stride = img->stride;
+    register const int16_pixel_t *ip;
+    register blobstats_t *bs;
+    register int32_t label;
+    register uint32_t neighbours;
+    register int32_t row;
+    register int32_t col;
+    register uint32_t i = nof_blobs;
+
+    while(i-- > 0)
+    {
+        stats[i].m00 = 0;
+        stats[i].m10 = 0;
+        stats[i].m01 = 0;
+        stats[i].m20 = 0;
+        stats[i].m02 = 0;
+        stats[i].m11 = 0;
+        stats[i].min_col = UINT16_MAX;
+        stats[i].max_col = 0;
+        stats[i].min_row = UINT16_MAX;
+        stats[i].max_row = 0;
+        stats[i].perimeter = 0.0f;
+    }
+
+    for(row = 0; row < rows; row++)
+    {
+        ip = INT16_ROW(img, row);
+        for(col = 0; col < cols; col++, ip++)
+        {
+            label = *ip;
+            if(label <= 0 || (uint32_t)label > nof_blobs)
+                continue;
+
+            bs = &stats[label - 1];
+            bs->m00++;
+            bs->m10 += col;
+            bs->m01 += row;
+            bs->m20 += (uint64_t)col * col;
+            bs->m02 += (uint64_t)row * row;
+            bs->m11 += (uint64_t)col * row;
+            if(col < bs->min_col)
+                bs->min_col = col;
+            if(col > bs->max_col)
+                bs->max_col = col;
+            if(row < bs->min_row)
+                bs->min_row = row;
+            if(row > bs->max_row)
+                bs->max_row = row;
+
+            // 4 connected background neighbours, see blobAnalyse_int16()
+            neighbours = 0;
+            if(row > 0 && *(ip - stride) == 0)
+                neighbours++;
+            if(col > 0 && *(ip - 1) == 0)
+                neighbours++;
+            if(row < rows - 1 && *(ip + stride) == 0)
+                neighbours++;
+            if(col < cols - 1 && *(ip + 1) == 0)
+                neighbours++;
+            if(neighbours == 1)
+                bs->perimeter += 1.0f;
+            else if(neighbours == 2)
+                bs->perimeter += (float)sqrt(2);
+            else if(neighbours == 3)
+                bs->perimeter += (float)0.5f / (1.0f + (float)sqrt(2));
+        }
+    }
+}
+
 // ----------------------------------------------------------------------------
 // EOF
 // ----------------------------------------------------------------------------
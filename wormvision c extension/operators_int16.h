@@ -44,6 +44,28 @@ void setSelectedToValue_int16( const image_t *src
                              , const int16_pixel_t value
                              );
 
+void blobAnalyse_int16( const image_t *img
+                      , const uint32_t blobnr
+                      ,       blobinfo_t *blobInfo
+                      );
+
+void centroid_int16( const image_t *img
+                   , const uint32_t blobnr
+                   ,       int32_t *cc
+                   ,       int32_t *rc
+                   );
+
+void blobStatistics_int16( const image_t *img
+                         ,       blobstats_t *stats
+                         , const uint32_t nof_blobs
+                         );
+
+float normalizedCentralMoments_int16( const image_t *img
+                                    , const uint32_t blobnr
+                                    , const int32_t p
+                                    , const int32_t q
+                                    );
+
 #endif // _OPERATORS_INT_H_
 // ----------------------------------------------------------------------------
 // EOF
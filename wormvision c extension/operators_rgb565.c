@@ -40,6 +40,7 @@ image_t *newRGB565Image(const uint32_t cols, const uint32_t rows)
 
     img->cols = cols;
     img->rows = rows;
+    img->stride = cols;
     img->view = IMGVIEW_CLIP;
     img->type = IMGTYPE_RGB565;
     return(img);
@@ -161,6 +162,7 @@ void copy_rgb565(const image_t *src, image_t *dst)
 
     dst->rows = src->rows;
     dst->cols = src->cols;
+    dst->stride = src->cols;
     dst->type = src->type;
     dst->view = src->view;
 
@@ -15,6 +15,23 @@
 #include "operators_rgb888.h"
 #include "math.h"
 
+// NEON conversion to grayscale, 8 pixels per instruction
+// WORMVISION_NEON is defined by setup.py when building for an ARM target
+#ifdef WORMVISION_NEON
+#include <arm_neon.h>
+#endif
+
+// Fixed point grayscale weights r, g, b and rounding, GRAY_SHIFT fraction
+// bits, indexed by eGrayWeights. BT709 truncates like the float conversion
+// of toBasicImage(), BT601 are the 14 bit weights of cv2.cvtColor() * 64.
+#define GRAY_SHIFT  (20)
+
+static const uint32_t gray_weights[2][4] =
+{
+    { 223002u, 749900u,  75675u,       0u },
+    { 313536u, 615488u, 119552u, 1u << 19 },
+};
+
 // ----------------------------------------------------------------------------
 // Function implementations
 // ----------------------------------------------------------------------------
@@ -40,6 +57,7 @@ image_t *newRGB888Image(const uint32_t cols, const uint32_t rows)
 
     img->cols = cols;
     img->rows = rows;
+    img->stride = cols;
     img->view = IMGVIEW_CLIP;
     img->type = IMGTYPE_RGB888;
     return(img);
@@ -164,6 +182,62 @@ void threshold_rgb888(const image_t *src,
 
 }
 
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void toBasic_rgb888(const image_t *src,
+                          image_t *dst,
+                    const int32_t bgr,
+                    const eGrayWeights weights)
+{
+    register const uint32_t *w = gray_weights[weights == GRAY_BT601];
+    register const uint32_t wr = bgr ? w[2] : w[0];
+    register const uint32_t wg = w[1];
+    register const uint32_t wb = bgr ? w[0] : w[2];
+    register const uint32_t round = w[3];
+    register int32_t row;
+    register int32_t i;
+    register const uint8_t *s;
+    register basic_pixel_t *d;
+#ifdef WORMVISION_NEON
+    uint8x8x3_t v;
+    uint16x8_t c0, c1, c2;
+    uint32x4_t lo, hi;
+#endif
+
+    for(row = 0; row < src->rows; row++)
+    {
+        // the first channel is r, or b if bgr
+        s = (const uint8_t *)&RGB888_PIXEL(src, 0, row);
+        d = BASIC_ROW(dst, row);
+        i = src->cols;
+#ifdef WORMVISION_NEON
+        for(; i >= 8; i -= 8)
+        {
+            v = vld3_u8(s);
+            c0 = vmovl_u8(v.val[0]);
+            c1 = vmovl_u8(v.val[1]);
+            c2 = vmovl_u8(v.val[2]);
+            lo = vmlaq_n_u32(vdupq_n_u32(round), vmovl_u16(vget_low_u16(c0)), wr);
+            lo = vmlaq_n_u32(lo, vmovl_u16(vget_low_u16(c1)), wg);
+            lo = vmlaq_n_u32(lo, vmovl_u16(vget_low_u16(c2)), wb);
+            hi = vmlaq_n_u32(vdupq_n_u32(round), vmovl_u16(vget_high_u16(c0)), wr);
+            hi = vmlaq_n_u32(hi, vmovl_u16(vget_high_u16(c1)), wg);
+            hi = vmlaq_n_u32(hi, vmovl_u16(vget_high_u16(c2)), wb);
+            vst1_u8(d, vmovn_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(lo, GRAY_SHIFT)),
+                                               vmovn_u32(vshrq_n_u32(hi, GRAY_SHIFT)))));
+            s += 24;
+            d += 8;
+        }
+#endif
+        // integer only, so the compiler can vectorize it as well
+        for(; i > 0; i--)
+        {
+            *d++ = (basic_pixel_t)((wr * s[0] + wg * s[1] + wb * s[2] + round) >> GRAY_SHIFT);
+            s += 3;
+        }
+    }
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 void copy_rgb888(const image_t *src, image_t *dst)
@@ -174,6 +248,7 @@ void copy_rgb888(const image_t *src, image_t *dst)
 
     dst->rows = src->rows;
     dst->cols = src->cols;
+    dst->stride = src->cols;
     dst->type = src->type;
     dst->view = src->view;
 
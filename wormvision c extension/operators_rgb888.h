@@ -37,6 +37,11 @@ void threshold_rgb888( const image_t *src
 void erase_rgb888( const image_t *img );
 
 void copy_rgb888( const image_t *src, image_t *dst );
+void toBasic_rgb888( const image_t *src
+                   ,       image_t *dst
+                   , const int32_t bgr
+                   , const eGrayWeights weights
+                   );
 
 #endif // _OPERATORS_RGB888_H_
 // ----------------------------------------------------------------------------
@@ -0,0 +1,243 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the frame preprocessing cache
+ *
+ *              An entry is claimed under the cache lock: its key is set and
+ *              its own lock is acquired before the cache lock is released, so
+ *              a thread that finds the entry and acquires the entry lock waits
+ *              until the result is calculated. Entries are never reused
+ *              within a frame, so a result can be read without a lock.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "prepcache.h"
+#include "stdlib.h"
+
+// Same stage, parameters and source
+static int sameKey(const prepentry_t *entry,
+                   const ePrepStage stage,
+                   const prepparams_t *params,
+                   const image_t *src)
+{
+    if(entry->stage != stage || entry->src.data != src->data || entry->src.cols != src->cols ||
+       entry->src.rows != src->rows || entry->src.stride != src->stride ||
+       entry->params.kernel_size != params->kernel_size || entry->params.sigma != params->sigma ||
+       entry->params.separable != params->separable)
+    {
+        return 0;
+    }
+    return stage == PREP_STAGE_BLUR || (entry->params.c == params->c && entry->params.g == params->g);
+}
+
+// Entry of the stage, claimed and locked if it was not in the cache:
+// *claimed is then 1 and the caller must calculate the result, set the frame
+// and release the lock. Returns NULL if the stage can not be cached.
+static prepentry_t *findEntry(prepcache_t *cache,
+                              const ePrepStage stage,
+                              const prepparams_t *params,
+                              const image_t *src,
+                              int *claimed)
+{
+    register uint32_t i;
+    prepentry_t *entry = NULL;
+
+    *claimed = 0;
+    if(src->cols > cache->cols || src->rows > cache->rows)
+    {
+        return NULL;
+    }
+    acquireLock(cache->lock);
+    for(i = 0; i < PREPCACHE_ENTRIES; i++)
+    {
+        if(cache->entries[i].frame == cache->frame && sameKey(&cache->entries[i], stage, params, src))
+        {
+            entry = &cache->entries[i];
+            cache->hits++;
+            releaseLock(cache->lock);
+            // wait for the thread that calculates the result
+            acquireLock(entry->lock);
+            releaseLock(entry->lock);
+            return entry->img != NULL ? entry : NULL;
+        }
+    }
+    for(i = 0; i < PREPCACHE_ENTRIES; i++)
+    {
+        if(cache->entries[i].frame != cache->frame)
+        {
+            entry = &cache->entries[i];
+            break;
+        }
+    }
+    if(entry != NULL && entry->img == NULL)
+    {
+        entry->img = newBasicImage(cache->cols, cache->rows);
+    }
+    if(entry == NULL || entry->img == NULL)
+    {
+        releaseLock(cache->lock);
+        return NULL;
+    }
+    cache->misses++;
+    entry->stage = stage;
+    entry->params = *params;
+    entry->src = *src;
+    entry->frame = cache->frame;
+    entry->img->cols = src->cols;
+    entry->img->rows = src->rows;
+    entry->img->stride = src->cols;
+    acquireLock(entry->lock);
+    releaseLock(cache->lock);
+    *claimed = 1;
+    return entry;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+prepcache_t *newPrepCache(const int32_t cols, const int32_t rows)
+{
+    register uint32_t i;
+
+    if(cols <= 0 || rows <= 0)
+    {
+        return NULL;
+    }
+    prepcache_t *cache = (prepcache_t *)calloc(1, sizeof(prepcache_t));
+    if(cache == NULL)
+    {
+        return NULL;
+    }
+    cache->cols = cols;
+    cache->rows = rows;
+    // frame 0 is never used, so the entries start invalid
+    cache->frame = 1;
+    cache->lock = newLock();
+    if(cache->lock == NULL)
+    {
+        deletePrepCache(cache);
+        return NULL;
+    }
+    for(i = 0; i < PREPCACHE_ENTRIES; i++)
+    {
+        cache->entries[i].lock = newLock();
+        if(cache->entries[i].lock == NULL)
+        {
+            deletePrepCache(cache);
+            return NULL;
+        }
+    }
+    return cache;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deletePrepCache(prepcache_t *cache)
+{
+    register uint32_t i;
+
+    if(cache == NULL)
+    {
+        return;
+    }
+    for(i = 0; i < PREPCACHE_ENTRIES; i++)
+    {
+        if(cache->entries[i].img != NULL)
+        {
+            deleteImage(cache->entries[i].img);
+        }
+        deleteLock(cache->entries[i].lock);
+    }
+    deleteLock(cache->lock);
+    free(cache);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void prepCacheNewFrame(prepcache_t *cache)
+{
+    acquireLock(cache->lock);
+    if(++cache->frame == 0)
+    {
+        cache->frame = 1;
+    }
+    releaseLock(cache->lock);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+const image_t *prepCacheBlur(prepcache_t *cache,
+                             const image_t *src,
+                             const prepparams_t *params,
+                             const image_t *kernel,
+                                   image_t *tmp,
+                             const pixelstats_t **stats)
+{
+    int claimed;
+    prepentry_t *entry = findEntry(cache, PREP_STAGE_BLUR, params, src, &claimed);
+
+    if(entry == NULL)
+    {
+        return NULL;
+    }
+    if(claimed)
+    {
+        if(params->separable)
+        {
+            separableConvolutionStats(src, entry->img, tmp, kernel, &entry->stats);
+        }
+        else
+        {
+            convolutionStats(src, entry->img, kernel, &entry->stats);
+        }
+        releaseLock(entry->lock);
+    }
+    *stats = &entry->stats;
+    return entry->img;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+const image_t *prepCacheGamma(prepcache_t *cache,
+                              const image_t *src,
+                              const prepparams_t *params,
+                              const image_t *kernel,
+                                    image_t *tmp,
+                              const basic_pixel_t *LUT)
+{
+    int claimed;
+    const image_t *blurred;
+    const pixelstats_t *stats;
+    prepentry_t *entry = findEntry(cache, PREP_STAGE_GAMMA, params, src, &claimed);
+
+    if(entry == NULL || !claimed)
+    {
+        return entry != NULL ? entry->img : NULL;
+    }
+    blurred = prepCacheBlur(cache, src, params, kernel, tmp, &stats);
+    if(blurred != NULL)
+    {
+        contrastStretchFastStats(blurred, entry->img, stats);
+    }
+    else if(params->separable)
+    {
+        separableConvolutionStats(src, entry->img, tmp, kernel, &entry->stats);
+        contrastStretchFastStats(entry->img, entry->img, &entry->stats);
+    }
+    else
+    {
+        convolutionStats(src, entry->img, kernel, &entry->stats);
+        contrastStretchFastStats(entry->img, entry->img, &entry->stats);
+    }
+    applyLUT(entry->img, entry->img, LUT);
+    releaseLock(entry->lock);
+    return entry->img;
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
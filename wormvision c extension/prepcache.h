@@ -0,0 +1,141 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the frame preprocessing cache
+ *
+ *              Evaluators that preprocess the same frame with the same early
+ *              stages share the results: the blur (and its statistics) is
+ *              keyed by the kernel size, sigma and blur type, the contrast
+ *              stretch and gamma by the blur key and c and gamma. The entries
+ *              are only valid for the current frame, see prepCacheNewFrame().
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _PREPCACHE_H_
+#define _PREPCACHE_H_
+
+#include "stdint.h"
+#include "operators.h"
+#include "threads.h"
+
+// ----------------------------------------------------------------------------
+// Defines
+// ----------------------------------------------------------------------------
+
+// Number of cached images per frame, further stages are not cached
+#define PREPCACHE_ENTRIES    8
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Cached preprocessing stages
+typedef enum
+{
+    PREP_STAGE_BLUR = 0,  // gaussian blur
+    PREP_STAGE_GAMMA,     // blur, contrast stretch and gamma
+
+}ePrepStage;
+
+// Parameters of the preprocessing stages (the cache key)
+typedef struct prepparams_t
+{
+    int32_t kernel_size;  // gaussian blur kernel size (odd)
+    double  sigma;        // gaussian blur sigma
+    int32_t separable;    // 1: separable fixed point blur, 0: 2D float convolution
+    float   c;            // gamma constant, PREP_STAGE_GAMMA only
+    float   g;            // gamma, PREP_STAGE_GAMMA only
+
+}prepparams_t;
+
+// Cached result of one stage
+typedef struct prepentry_t
+{
+    ePrepStage    stage;
+    prepparams_t  params;
+    image_t       src;         // frame (or view) the stage was applied to
+    uint32_t      frame;       // valid if equal to the frame of the cache
+    image_t      *img;         // result, allocated on first use
+    pixelstats_t  stats;       // statistics of the blur output
+    lock_t       *lock;        // held while the result is calculated
+
+}prepentry_t;
+
+// Frame preprocessing cache, see newPrepCache()
+typedef struct prepcache_t
+{
+    int32_t      cols;         // maximum frame size
+    int32_t      rows;
+    uint32_t     frame;        // incremented by prepCacheNewFrame()
+    uint32_t     hits;         // statistics since the cache was created
+    uint32_t     misses;
+    lock_t      *lock;         // protects the entry keys and the statistics
+    prepentry_t  entries[PREPCACHE_ENTRIES];
+
+}prepcache_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Create a cache for frames of at most cols x rows pixels
+// Memory is allocated within this function, the entry images are allocated
+// when they are used for the first time
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling deletePrepCache()
+//                Returns NULL if memory could not be allocated
+prepcache_t *newPrepCache( const int32_t cols, const int32_t rows );
+void deletePrepCache( prepcache_t *cache );
+
+// Invalidate all entries, must be called when the frame changes (the frame
+// is identified by its data pointer and size, so a new frame in the same
+// buffer is not detected) and not while the cache is used by another thread
+//
+// Precondition : -
+// Postcondition: -
+void prepCacheNewFrame( prepcache_t *cache );
+
+// Blur of src with kernel (an int16 1D kernel if params->separable, tmp is
+// then the int16 image for the horizontal pass), calculated if it is not in
+// the cache. *stats is set to the statistics of the blur.
+// Returns NULL if the stage can not be cached (the cache is full, src is too
+// large or memory could not be allocated), the caller must then calculate it.
+// The result is read only and valid until the next prepCacheNewFrame().
+// The cache can be used by multiple threads at the same time, threads that
+// need a result that is being calculated wait for it.
+//
+// Precondition : src is a basic image (or view), kernel and tmp as for
+//                convolutionStats() and separableConvolutionStats()
+// Postcondition: -
+const image_t *prepCacheBlur( prepcache_t *cache
+                            , const image_t *src
+                            , const prepparams_t *params
+                            , const image_t *kernel
+                            ,       image_t *tmp
+                            , const pixelstats_t **stats
+                            );
+
+// Contrast stretch and gamma (gamma look up table LUT) of the blur of src,
+// see prepCacheBlur()
+//
+// Precondition : see prepCacheBlur(), LUT is the gammaLUT_basic() table of
+//                params->c and params->g
+// Postcondition: -
+const image_t *prepCacheGamma( prepcache_t *cache
+                             , const image_t *src
+                             , const prepparams_t *params
+                             , const image_t *kernel
+                             ,       image_t *tmp
+                             , const basic_pixel_t *LUT
+                             );
+
+#endif // _PREPCACHE_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
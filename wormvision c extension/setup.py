@@ -1,4 +1,24 @@
 from setuptools import setup, Extension
+import os
+import platform
+
+# NEON point operators are compiled in on ARM targets (raspberry pi), set WORMVISION_NO_NEON=1 to build the
+# scalar versions instead
+define_macros = []
+extra_compile_args = []
+machine = platform.machine().lower()
+if not os.environ.get("WORMVISION_NO_NEON"):
+    if machine in ("aarch64", "arm64"):
+        define_macros.append(("WORMVISION_NEON", None))
+    elif machine.startswith("armv7"):
+        define_macros.append(("WORMVISION_NEON", None))
+        extra_compile_args.append("-mfpu=neon")
+
+# the neighbourhood operators run on a pthread pool (win32 threads on windows), see threads.h
+extra_link_args = []
+if os.name != "nt":
+    extra_compile_args.append("-pthread")
+    extra_link_args.append("-pthread")
 
 setup(
     name="wormvision",
@@ -8,12 +28,24 @@ setup(
         Extension(
             "wormvision",
             sources=["wormvision.c",
+                     "evaluators.c",
                      "operators_basic.c",
+                     "operators_binary.c",
                      "operators.c",
                      "operators_float.c",
                      "operators_int16.c",
                      "operators_rgb565.c",
-                     "operators_rgb888.c"],
+                     "operators_rgb888.c",
+                     "threads.c",
+                     "morphology.c",
+                     "hough.c",
+                     "prepcache.c",
+                     "framering.c",
+                     "framearchive.c",
+                     "watershed.c"],
+            define_macros=define_macros,
+            extra_compile_args=extra_compile_args,
+            extra_link_args=extra_link_args,
             py_limited_api=True)
     ]
 )
@@ -25,3 +57,4 @@ setup(
 # install (from within venv) with "python setup.py install" in this folder
 # visual studio build tools need to be installed and cl.exe added to the system path
 # on raspberry pi: "sudo python3 setup.py install" in this folder
+# native benchmark of the operators and the pipeline without python: see benchmark.c
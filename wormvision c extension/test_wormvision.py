@@ -1,14 +1,154 @@
 import wormvision
 import timeit
+import os
+import struct
+import tempfile
 
 if __name__ == "__main__":
     rows = 10
     cols = 10
     data = list(range(rows*cols))
     target = (20, 10)
+    # blur kernel size, blur sigma, c, gamma, threshold, area threshold
+    params = (5, 1.0, 0.5, 8.0, 20, 5)
 
     start = timeit.default_timer()
-    wormvision.WBFE_evaluate(data, cols, rows, target)
+    wormvision.WBFE_evaluate(data, cols, rows, target, *params)
     stop = timeit.default_timer()
 
-    print('Time: ', stop - start)
+    print('Time (list): ', stop - start)
+
+    start = timeit.default_timer()
+    wormvision.WBFE_evaluate_buffer(bytes(data), cols, rows, target, *params)
+    stop = timeit.default_timer()
+
+    print('Time (buffer): ', stop - start)
+
+    start = timeit.default_timer()
+    wormvision.WBFE_evaluate_buffer(bytes(data), cols, rows, target, *params, separable=True)
+    stop = timeit.default_timer()
+
+    print('Time (buffer, separable blur): ', stop - start)
+
+    timings = {}
+    wormvision.WBFE_evaluate_buffer(bytes(data), cols, rows, target, *params, timings=timings)
+    print('Stage timings (ms): ', timings)
+
+    start = timeit.default_timer()
+    print(wormvision.WBFE_evaluate_buffer(bytes(data), cols, rows, target, *params, open_kernelsize=10))
+    stop = timeit.default_timer()
+    print('Time (buffer, elliptical opening): ', stop - start)
+
+    start = timeit.default_timer()
+    # blur kernel size, blur sigma, c, gamma, min radius, max radius, min distance, param1, param2
+    print(wormvision.HT_evaluate(bytes(data), cols, rows, target, 5, 100.0, 1.0, 5.0, 2, 4, 2, 25, 50, separable=True))
+    stop = timeit.default_timer()
+    print('Time (hough transform): ', stop - start)
+
+    # evaluators of the same frame share the blur through a frame cache
+    cache = wormvision.FrameCache(cols, rows)
+    cache.new_frame()
+    evaluator = wormvision.Evaluator(cols, rows, *params)
+    frame = bytes(data)
+    print(evaluator.evaluate(frame, target, cache=cache), evaluator.evaluate(frame, target, cache=cache))
+    print('Frame cache (hits, misses): ', cache.stats())
+    try:
+        cache.__init__(cols, rows)  # the cache may be in use by other threads, it is never replaced
+        raise AssertionError('FrameCache was initialised twice')
+    except RuntimeError:
+        pass
+
+    # camera frame conversion, same pixels as cv2.cvtColor(img, cv2.COLOR_BGR2GRAY)
+    bgr = bytes(v for v in data[:cols * rows] for _ in range(3))
+    print(wormvision.to_gray(bgr, cols, rows, 'bgr') == bytearray(data[:cols * rows]))
+
+    # camera frames are pushed into a ring of preallocated slots, the newest frame is evaluated in place
+    ring = wormvision.FrameRing(cols, rows)
+    ring.push(bgr, 'bgr')
+    print(evaluator.evaluate(ring.latest(), target), 'Frame ring (frames, dropped): ', ring.stats())
+
+    start = timeit.default_timer()
+    # coarse to fine: the blobs are searched at half resolution, the centroid at full resolution
+    print(wormvision.Evaluator(cols, rows, *params, pyramid_levels=1).evaluate(frame, target))
+    stop = timeit.default_timer()
+    print('Time (pyramid): ', stop - start)
+
+    # tracking: the second evaluation only searches near the blob of the first one
+    evaluator.evaluate(frame, target, track=True)
+    start = timeit.default_timer()
+    print(evaluator.evaluate(frame, target, track=True), 'Tracking (hits, misses): ', evaluator.track_stats())
+    stop = timeit.default_timer()
+    print('Time (tracked): ', stop - start)
+
+    # parameter sweep: every combination of the thresholds and gammas for a stack of frames
+    stack = bytes(frame) * 4
+    start = timeit.default_timer()
+    offsets, found = wormvision.evaluate_batch(memoryview(stack).cast('B', (4, rows, cols)), target, *params,
+                                               thresholds=(15, 20, 25), gammas=(6.0, 8.0))
+    stop = timeit.default_timer()
+    print(list(memoryview(offsets).cast('i')[:2]), sum(found), 'found of', len(found))
+    print('Time (batch of 24): ', stop - start)
+
+    # the frames x parameter sets of a small batch are split over the threads, the result does not depend on them
+    bcols, brows = 48, 36
+    discs = [bytes(200 if (c - 14 - 6 * k) ** 2 + (r - 16 - 2 * k) ** 2 <= 36 else 40
+                   for r in range(brows) for c in range(bcols)) for k in range(3)]
+    single = [wormvision.WBFE_evaluate_buffer(d, bcols, brows, (24, 18), *params) for d in discs]
+    batches = []
+    for nof_threads in (1, 4):
+        wormvision.set_threads(nof_threads)
+        batches.append(wormvision.evaluate_batch(memoryview(b''.join(discs)).cast('B', (3, brows, bcols)), (24, 18),
+                                                 *params, thresholds=(15, 20, 250), gammas=(1.0, 8.0)))
+    wormvision.set_threads(1)
+    assert batches[0] == batches[1], 'evaluate_batch depends on the number of threads'
+    pairs = memoryview(batches[0][0]).cast('i')
+    assert [tuple(pairs[2 * i:2 * i + 2]) for i in range(3)] == single and list(batches[0][1][-3:]) == [0, 0, 0]
+
+    # raw frame archive (see framearchive.h and frame_archive.py): the frames are read from the mapped file
+    record_size = (64 + cols * rows + 63) // 64 * 64
+    path = os.path.join(tempfile.mkdtemp(), 'test.wva')
+    with open(path, 'wb') as f:
+        f.write(struct.pack('<IIiiiII36x', 0x41465657, 1, cols, rows, 0, cols * rows, record_size))
+        for i in range(3):
+            f.write(struct.pack('<dffiiffffI20x', i, 1.0, 2.0, target[0], target[1], 0, 0, 0, 0, 1) + bytes(frame)
+                    + bytes(record_size - 64 - cols * rows))
+    archive = wormvision.FrameArchive(path)
+    start = timeit.default_timer()
+    offsets, found = wormvision.evaluate_batch(archive, target, *params)
+    stop = timeit.default_timer()
+    print(len(archive), archive.meta(2), list(memoryview(offsets).cast('i')), list(found))
+    print('Time (archive of 3): ', stop - start)
+
+    # distance transform and watershed, checked against a brute force distance and the watershed invariants
+    dcols, drows = 23, 17
+    blobs = [(5, 8, 5), (16, 8, 5), (21, 1, 1)]  # touching discs and a small one near the edge
+    mask = bytes(1 if any((c - x) ** 2 + (r - y) ** 2 <= s * s for x, y, s in blobs) else 0
+                 for r in range(drows) for c in range(dcols))
+    dist = memoryview(wormvision.distance_transform(mask, dcols, drows)).cast('f')
+    background = [(c, r) for r in range(drows) for c in range(dcols) if not mask[r * dcols + c]]
+    for r in range(drows):
+        for c in range(dcols):
+            exact = min(((c - x) ** 2 + (r - y) ** 2) ** 0.5 for x, y in background)
+            assert abs(dist[r * dcols + c] - exact) < 1e-4, ('distance_transform', c, r, dist[r * dcols + c], exact)
+    heights = bytes(255 - min(254, int(d + 0.5)) for d in dist)
+    labels, n = wormvision.watershed(heights, dcols, drows, 255 - 4, 254)
+    labels = memoryview(labels).cast('h')
+    assert n == 2 and labels[8 * dcols + 5] == 1 and labels[8 * dcols + 16] == 2, ('watershed', n)
+    for r in range(drows):
+        for c in range(dcols):
+            near = [labels[y * dcols + x] for y in range(max(r - 1, 0), min(r + 2, drows))
+                    for x in range(max(c - 1, 0), min(c + 2, dcols))]
+            assert labels[r * dcols + c] == 0 or all(l in (0, labels[r * dcols + c]) for l in near), ('adjacent', c, r)
+    try:
+        import numpy
+    except ImportError:
+        numpy = None
+    if numpy is not None:
+        # a view into a padded image gives the same labels as the contiguous image
+        padded = numpy.zeros((drows, dcols + 7), numpy.uint8)
+        padded[:, 3:dcols + 3] = numpy.frombuffer(heights, numpy.uint8).reshape(drows, dcols)
+        assert wormvision.watershed(padded[:, 3:dcols + 3], dcols, drows, 255 - 4, 254) == (bytearray(labels), n)
+    print('Watershed basins: ', n)
+
+    # binary images have a stride in words, a view of part of the words of the rows is not contiguous
+    wormvision._check_binary_views()
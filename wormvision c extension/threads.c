@@ -0,0 +1,434 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the thread pool that runs the
+ *              neighbourhood operators in row bands on multiple cores
+ *
+ *              The workers sleep until parallelRows() publishes a job. The
+ *              bands of a job are claimed one by one by the workers and the
+ *              calling thread, so a job always finishes even if a worker is
+ *              slow to wake up.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "threads.h"
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef WORMVISION_NO_THREADS
+#ifdef _WIN32
+typedef HANDLE             thread_t;
+typedef SRWLOCK            mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+#define MUTEX_INIT         SRWLOCK_INIT
+#define COND_INIT          CONDITION_VARIABLE_INIT
+#define mutexLock(m)       AcquireSRWLockExclusive(m)
+#define mutexUnlock(m)     ReleaseSRWLockExclusive(m)
+#define condWait(c,m)      SleepConditionVariableSRW(c, m, INFINITE, 0)
+#define condBroadcast(c)   WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+#include <unistd.h>
+typedef pthread_t          thread_t;
+typedef pthread_mutex_t    mutex_t;
+typedef pthread_cond_t     cond_t;
+#define MUTEX_INIT         PTHREAD_MUTEX_INITIALIZER
+#define COND_INIT          PTHREAD_COND_INITIALIZER
+#define mutexLock(m)       pthread_mutex_lock(m)
+#define mutexUnlock(m)     pthread_mutex_unlock(m)
+#define condWait(c,m)      pthread_cond_wait(c, m)
+#define condBroadcast(c)   pthread_cond_broadcast(c)
+#endif
+
+// Pool state, all fields are protected by mutex
+static struct
+{
+    mutex_t      mutex;
+    cond_t       start;          // a job was published or the workers must quit
+    cond_t       done;           // a job finished
+    thread_t     workers[MAX_THREADS - 1];
+    uint32_t     nof_workers;
+    uint32_t     quit;
+    uint32_t     busy;           // a job is running or the workers are replaced
+    uint32_t     generation;     // incremented for every job
+
+    rowband_fn_t fn;             // current job
+    void        *arg;
+    int32_t      rows;
+    uint32_t     nof_bands;
+    uint32_t     next_band;      // first band that is not claimed yet
+    uint32_t     bands_done;
+
+}pool = {MUTEX_INIT, COND_INIT, COND_INIT};
+
+// See lockBandMerge()
+static mutex_t band_merge = MUTEX_INIT;
+
+// Claim and run bands of the current job until all are claimed
+// Precondition: mutex is locked
+static void runBands(void)
+{
+    uint32_t band;
+    while(pool.next_band < pool.nof_bands)
+    {
+        band = pool.next_band++;
+        mutexUnlock(&pool.mutex);
+        pool.fn(pool.arg, (int32_t)((int64_t)pool.rows * band / pool.nof_bands),
+                          (int32_t)((int64_t)pool.rows * (band + 1) / pool.nof_bands));
+        mutexLock(&pool.mutex);
+        if(++pool.bands_done == pool.nof_bands)
+        {
+            condBroadcast(&pool.done);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID unused)
+#else
+static void *worker(void *unused)
+#endif
+{
+    uint32_t generation;
+    (void)unused;
+
+    mutexLock(&pool.mutex);
+    generation = pool.generation;
+    while(!pool.quit)
+    {
+        if(generation == pool.generation)
+        {
+            condWait(&pool.start, &pool.mutex);
+            continue;
+        }
+        generation = pool.generation;
+        runBands();
+    }
+    mutexUnlock(&pool.mutex);
+    return 0;
+}
+
+// Start a worker thread, returns 0 on failure
+static int startWorker(thread_t *thread)
+{
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, worker, NULL, 0, NULL);
+    return *thread != NULL;
+#else
+    return pthread_create(thread, NULL, worker, NULL) == 0;
+#endif
+}
+
+static void joinWorker(thread_t thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+#endif // WORMVISION_NO_THREADS
+
+// See newLock()
+struct lock_t
+{
+#ifndef WORMVISION_NO_THREADS
+    mutex_t mutex;
+    cond_t  changed;             // see waitLock()
+#else
+    int32_t unused;
+#endif
+};
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t setThreadCount(const uint32_t nof_threads)
+{
+#ifdef WORMVISION_NO_THREADS
+    (void)nof_threads;
+    return 1;
+#else
+    register uint32_t i;
+    register uint32_t nof_workers = nof_threads > MAX_THREADS ? MAX_THREADS - 1 :
+                                    nof_threads > 0 ? nof_threads - 1 : 0;
+
+    // Wait for the running job and keep new jobs in their calling thread
+    mutexLock(&pool.mutex);
+    while(pool.busy)
+    {
+        condWait(&pool.done, &pool.mutex);
+    }
+    pool.busy = 1;
+    pool.quit = 1;
+    condBroadcast(&pool.start);
+    mutexUnlock(&pool.mutex);
+
+    for(i = 0; i < pool.nof_workers; i++)
+    {
+        joinWorker(pool.workers[i]);
+    }
+
+    mutexLock(&pool.mutex);
+    pool.quit = 0;
+    for(pool.nof_workers = 0; pool.nof_workers < nof_workers; pool.nof_workers++)
+    {
+        if(!startWorker(&pool.workers[pool.nof_workers]))
+        {
+            break;
+        }
+    }
+    pool.busy = 0;
+    condBroadcast(&pool.done);
+    i = pool.nof_workers + 1;
+    mutexUnlock(&pool.mutex);
+    return i;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t getThreadCount(void)
+{
+#ifdef WORMVISION_NO_THREADS
+    return 1;
+#else
+    register uint32_t n;
+    mutexLock(&pool.mutex);
+    n = pool.nof_workers + 1;
+    mutexUnlock(&pool.mutex);
+    return n;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t processorCount(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+#else
+    return 1;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+double monotonicMs(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return count.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+
+// Split rows in bands of at least min_rows rows, see parallelRows()
+static void parallelBands(const int32_t rows, const int32_t min_rows, rowband_fn_t fn, void *arg)
+{
+#ifndef WORMVISION_NO_THREADS
+    register uint32_t nof_bands = rows > 0 ? (uint32_t)(rows / min_rows) : 0;
+
+    mutexLock(&pool.mutex);
+    if(nof_bands > pool.nof_workers + 1)
+    {
+        nof_bands = pool.nof_workers + 1;
+    }
+    if(!pool.busy && nof_bands > 1)
+    {
+        pool.busy = 1;
+        pool.fn = fn;
+        pool.arg = arg;
+        pool.rows = rows;
+        pool.nof_bands = nof_bands;
+        pool.next_band = 0;
+        pool.bands_done = 0;
+        pool.generation++;
+        condBroadcast(&pool.start);
+
+        runBands();
+        while(pool.bands_done < pool.nof_bands)
+        {
+            condWait(&pool.done, &pool.mutex);
+        }
+        pool.busy = 0;
+        condBroadcast(&pool.done);
+        mutexUnlock(&pool.mutex);
+        return;
+    }
+    mutexUnlock(&pool.mutex);
+#else
+    (void)min_rows;
+#endif
+    fn(arg, 0, rows);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void parallelRows(const int32_t rows, rowband_fn_t fn, void *arg)
+{
+    parallelBands(rows, PARALLEL_MIN_ROWS, fn, arg);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void parallelItems(const int32_t items, rowband_fn_t fn, void *arg)
+{
+    parallelBands(items, 1, fn, arg);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void lockBandMerge(void)
+{
+#ifndef WORMVISION_NO_THREADS
+    mutexLock(&band_merge);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void unlockBandMerge(void)
+{
+#ifndef WORMVISION_NO_THREADS
+    mutexUnlock(&band_merge);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+lock_t *newLock(void)
+{
+    lock_t *lock = (lock_t *)malloc(sizeof(lock_t));
+    if(lock == NULL)
+    {
+        return NULL;
+    }
+#ifndef WORMVISION_NO_THREADS
+#ifdef _WIN32
+    InitializeSRWLock(&lock->mutex);
+    InitializeConditionVariable(&lock->changed);
+#else
+    if(pthread_mutex_init(&lock->mutex, NULL) != 0)
+    {
+        free(lock);
+        return NULL;
+    }
+    // the deadlines of waitLock() are on the monotonic clock
+    pthread_condattr_t attr;
+    if(pthread_condattr_init(&attr) != 0)
+    {
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+        return NULL;
+    }
+    if(pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 ||
+       pthread_cond_init(&lock->changed, &attr) != 0)
+    {
+        pthread_condattr_destroy(&attr);
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+        return NULL;
+    }
+    pthread_condattr_destroy(&attr);
+#endif
+#endif
+    return lock;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteLock(lock_t *lock)
+{
+    if(lock == NULL)
+    {
+        return;
+    }
+#if !defined(WORMVISION_NO_THREADS) && !defined(_WIN32)
+    pthread_cond_destroy(&lock->changed);
+    pthread_mutex_destroy(&lock->mutex);
+#endif
+    free(lock);
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void acquireLock(lock_t *lock)
+{
+#ifndef WORMVISION_NO_THREADS
+    mutexLock(&lock->mutex);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void releaseLock(lock_t *lock)
+{
+#ifndef WORMVISION_NO_THREADS
+    mutexUnlock(&lock->mutex);
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int32_t waitLock(lock_t *lock, const int32_t timeout_ms)
+{
+#ifdef WORMVISION_NO_THREADS
+    (void)lock;
+    (void)timeout_ms;
+    return 0;
+#elif defined(_WIN32)
+    return SleepConditionVariableSRW(&lock->changed, &lock->mutex,
+                                     timeout_ms < 0 ? INFINITE : (DWORD)timeout_ms, 0) ? 1 : 0;
+#else
+    struct timespec deadline;
+
+    if(timeout_ms < 0)
+    {
+        return pthread_cond_wait(&lock->changed, &lock->mutex) == 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&lock->changed, &lock->mutex, &deadline) == 0;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void notifyLock(lock_t *lock)
+{
+#ifndef WORMVISION_NO_THREADS
+    condBroadcast(&lock->changed);
+#else
+    (void)lock;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
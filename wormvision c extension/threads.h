@@ -0,0 +1,147 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the thread pool that runs the neighbourhood
+ *              operators in row bands on multiple cores
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _THREADS_H_
+#define _THREADS_H_
+
+#include "stdint.h"
+
+// ----------------------------------------------------------------------------
+// Defines
+// ----------------------------------------------------------------------------
+
+// Maximum number of threads, including the calling thread
+#define MAX_THREADS          16
+
+// Images are not split in bands of less rows than this
+#define PARALLEL_MIN_ROWS    8
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Mutex for data that is shared between threads outside the thread pool,
+// eg. a cache, see newLock()
+typedef struct lock_t lock_t;
+
+// Processes rows row_begin up to (not including) row_end of an image
+// arg points to the operator arguments
+typedef void (*rowband_fn_t)( void *arg
+                            , const int32_t row_begin
+                            , const int32_t row_end
+                            );
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Set the number of threads used by parallelRows(), including the calling
+// thread. 1 (the default) runs everything in the calling thread. Waits for a
+// running parallelRows() call to finish.
+// Has no effect if the library is built with WORMVISION_NO_THREADS.
+//
+// Precondition : -
+// Postcondition: Returns the number of threads that is used, this can be less
+//                than requested if the threads could not be created
+uint32_t setThreadCount( const uint32_t nof_threads );
+uint32_t getThreadCount( void );
+
+// Number of online processor cores, 1 if it is not known
+//
+// Precondition : -
+// Postcondition: -
+uint32_t processorCount( void );
+
+// Monotonic clock in milliseconds, only differences are meaningful. It does
+// not jump when the wall clock is set (eg. by NTP on a board without a real
+// time clock), so it is used for timeouts and timing.
+//
+// Precondition : -
+// Postcondition: -
+double monotonicMs( void );
+
+// Split rows 0..rows-1 in bands of at least PARALLEL_MIN_ROWS rows and call fn
+// for each band, on the worker threads and the calling thread. Returns when all
+// bands are done. The result must not depend on the order of the bands: every
+// band may read all input rows (the halo rows of a neighbourhood operator), but
+// only writes its own output rows.
+// If another thread is already running a parallelRows() call, fn is called for
+// all rows in the calling thread, so operators can be used from multiple
+// threads at the same time.
+//
+// Precondition : -
+// Postcondition: -
+void parallelRows( const int32_t rows
+                 , rowband_fn_t fn
+                 , void *arg
+                 );
+
+// Same as parallelRows(), but items 0..items-1 are split in bands of at least
+// one item, for work items that are much larger than a row, eg. the frames of
+// a batch evaluation. There are at most as many bands as threads, so the items
+// of a band are consecutive.
+//
+// Precondition : -
+// Postcondition: -
+void parallelItems( const int32_t items
+                  , rowband_fn_t fn
+                  , void *arg
+                  );
+
+// Serialise the merge of per band results, e.g. the histogram of each band,
+// into the shared result of a parallelRows() call. Do not call parallelRows()
+// while the lock is held.
+//
+// Precondition : -
+// Postcondition: -
+void lockBandMerge( void );
+void unlockBandMerge( void );
+
+// Create a mutex
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling deleteLock(),
+//                returns NULL if memory could not be allocated
+lock_t *newLock( void );
+void deleteLock( lock_t *lock );
+
+// Acquire and release a lock, a thread must not acquire a lock it holds
+// Do nothing if the library is built with WORMVISION_NO_THREADS.
+//
+// Precondition : lock was created with newLock()
+// Postcondition: -
+void acquireLock( lock_t *lock );
+void releaseLock( lock_t *lock );
+
+// Wait until another thread calls notifyLock(), the lock is released while
+// waiting and held again when waitLock() returns. Waits at most timeout_ms
+// milliseconds (forever if it is negative) of the monotonic clock, see
+// monotonicMs(), returns 0 on a timeout. Spurious wakeups are possible, so
+// check the shared state again.
+// Returns 0 immediately if the library is built with WORMVISION_NO_THREADS.
+//
+// Precondition : the calling thread holds the lock
+// Postcondition: the calling thread holds the lock
+int32_t waitLock( lock_t *lock, const int32_t timeout_ms );
+
+// Wake all threads that wait for the lock, see waitLock()
+//
+// Precondition : the calling thread holds the lock
+// Postcondition: -
+void notifyLock( lock_t *lock );
+
+#endif // _THREADS_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
@@ -0,0 +1,542 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Implementation file for the euclidean distance transform and
+ *              the marker based watershed transformation
+ *
+ *              Distance transform: the first pass writes the squared distance
+ *              to the nearest background pixel in the same column into dst
+ *              (one scan down and one scan up per column). The second pass
+ *              replaces every row by the lower envelope of the parabolas
+ *              (x - v)^2 + f(v) of its column distances f, which is the exact
+ *              squared euclidean distance. Both passes are linear.
+ *
+ *              Watershed: the levels and labels are copied into arrays with a
+ *              border of one pixel that is never flooded, so the neighbours of
+ *              a pixel are at fixed offsets without bounds checks. The markers
+ *              are labeled with a breadth first fill, their neighbours are the
+ *              first pixels in the queue. The queue is a FIFO list of pixels
+ *              per level (linked through ws->next), the lowest non empty level
+ *              is served first and a pixel is never queued below the level
+ *              that is being flooded.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#include "watershed.h"
+#include "threads.h"
+#include "stdio.h"
+#include "string.h"
+#include "math.h"
+
+// Squared distance of pixels without a background pixel in their column
+#define EDT_INF          1e20f
+
+// States of the padded labels, basins are 1..MAX_INT16_LABELS
+#define WS_UNVISITED     0
+#define WS_QUEUED        -1
+#define WS_LINE          -2
+#define WS_BORDER        -3   // border, and pixels above maxh
+
+#define WS_LEVELS        256
+#define WS_NONE          UINT32_MAX
+
+typedef struct edt_args_t
+{
+    const image_t *src;
+    image_t       *dst;
+    watershedworkspace_t *ws;
+    int32_t        failed;   // a band did not get an envelope buffer
+
+}edt_args_t;
+
+// ----------------------------------------------------------------------------
+// Distance transform
+// ----------------------------------------------------------------------------
+
+// First pass, squared distance to the nearest background pixel in the column
+static void distanceCols(void *arg, const int32_t col_begin, const int32_t col_end)
+{
+    const edt_args_t *a = (const edt_args_t *)arg;
+    register const int32_t rows = a->src->rows;
+    register const int32_t src_stride = a->src->stride;
+    register const int32_t dst_stride = a->dst->stride;
+    register const basic_pixel_t *s;
+    register float_pixel_t *d;
+    register int32_t row;
+    register int32_t col;
+    register int32_t dist;
+
+    for(col = col_begin; col < col_end; col++)
+    {
+        // down: distance to the background pixel above, rows + 1 if there is
+        // none yet
+        s = (const basic_pixel_t *)a->src->data + col;
+        d = (float_pixel_t *)a->dst->data + col;
+        dist = rows + 1;
+        for(row = 0; row < rows; row++)
+        {
+            dist = *s == 0 ? 0 : dist + 1;
+            *d = (float_pixel_t)dist;
+            s += src_stride;
+            d += dst_stride;
+        }
+        if(dist > rows)
+        {
+            // no background pixel in the column
+            d = (float_pixel_t *)a->dst->data + col;
+            for(row = 0; row < rows; row++)
+            {
+                *d = EDT_INF;
+                d += dst_stride;
+            }
+            continue;
+        }
+        // up: the background pixel below if it is closer, then square
+        d -= dst_stride;
+        dist = rows + 1;
+        for(row = rows - 1; row >= 0; row--)
+        {
+            dist = *d == 0.0f ? 0 : dist + 1;
+            if((float_pixel_t)dist < *d)
+            {
+                *d = (float_pixel_t)dist;
+            }
+            *d = *d * *d;
+            d -= dst_stride;
+        }
+    }
+}
+
+// Second pass, lower envelope of the parabolas of the column distances f of a
+// row: v are the columns of the parabolas of the envelope and z the columns
+// where they start. Every band takes a free envelope buffer of the workspace,
+// no more than MAX_THREADS bands run at the same time.
+static void distanceRows(void *arg, const int32_t row_begin, const int32_t row_end)
+{
+    edt_args_t *a = (edt_args_t *)arg;
+    register const int32_t cols = a->dst->cols;
+    register float_pixel_t *d;
+    register int32_t row;
+    register int32_t q;
+    register int32_t k;
+    register float s;
+    uint32_t buffer;
+
+    lockBandMerge();
+    for(buffer = 0; buffer < MAX_THREADS && (a->ws->envelopes_used >> buffer) & 1; buffer++)
+    {
+    }
+    if(buffer < MAX_THREADS)
+    {
+        a->ws->envelopes_used |= 1u << buffer;
+    }
+    else
+    {
+        a->failed = 1;
+    }
+    unlockBandMerge();
+    if(buffer == MAX_THREADS)
+    {
+        return;
+    }
+    float *f = a->ws->envelopes + (size_t)buffer * (3 * a->ws->cols + 1);
+    float *z = f + cols;
+    int32_t *v = (int32_t *)(z + cols + 1);
+
+    for(row = row_begin; row < row_end; row++)
+    {
+        d = FLOAT_ROW(a->dst, row);
+        memcpy(f, d, cols * sizeof(float));
+        k = -1;
+        for(q = 0; q < cols; q++)
+        {
+            // the columns without background pixels are not part of the
+            // envelope
+            if(f[q] >= EDT_INF)
+            {
+                continue;
+            }
+            if(k < 0)
+            {
+                k = 0;
+                v[0] = q;
+                z[0] = -EDT_INF;
+                z[1] = EDT_INF;
+                continue;
+            }
+            s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) / (float)(2 * (q - v[k]));
+            while(s <= z[k])
+            {
+                k--;
+                s = ((f[q] + (float)q * q) - (f[v[k]] + (float)v[k] * v[k])) / (float)(2 * (q - v[k]));
+            }
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = EDT_INF;
+        }
+        if(k < 0)
+        {
+            // no background pixel in the image
+            for(q = 0; q < cols; q++)
+            {
+                d[q] = sqrtf(EDT_INF);
+            }
+            continue;
+        }
+        k = 0;
+        for(q = 0; q < cols; q++)
+        {
+            while(z[k + 1] < (float)q)
+            {
+                k++;
+            }
+            d[q] = sqrtf((float)(q - v[k]) * (q - v[k]) + f[v[k]]);
+        }
+    }
+    lockBandMerge();
+    a->ws->envelopes_used &= ~(1u << buffer);
+    unlockBandMerge();
+}
+
+// Returns 1 if src fits in the workspace and dst has the size of src
+static int checkSize(const char *name, const image_t *src, const image_t *dst, const watershedworkspace_t *ws)
+{
+    if(src->cols > ws->cols || src->rows > ws->rows || dst->cols != src->cols || dst->rows != src->rows)
+    {
+        fprintf(stderr, "%s(): image of %dx%d pixels (dst %dx%d) does not fit the workspace of %dx%d pixels\n",
+                name, src->cols, src->rows, dst->cols, dst->rows, ws->cols, ws->rows);
+        return 0;
+    }
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+int distanceTransform(const image_t *src,
+                      image_t *dst,
+                      watershedworkspace_t *ws)
+{
+    edt_args_t a = {src, dst, ws, 0};
+    if(!checkSize("distanceTransform", src, dst, ws))
+    {
+        return 0;
+    }
+    parallelRows(src->cols, distanceCols, &a);
+    parallelRows(src->rows, distanceRows, &a);
+    if(a.failed)
+    {
+        fprintf(stderr, "distanceTransform(): the workspace is used by another thread\n");
+        return 0;
+    }
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+watershedworkspace_t *newWatershedWorkspace(const int32_t cols,
+                                            const int32_t rows)
+{
+    if(cols <= 0 || rows <= 0)
+    {
+        return NULL;
+    }
+    watershedworkspace_t *ws = (watershedworkspace_t *)calloc(1, sizeof(watershedworkspace_t));
+    if(ws == NULL)
+    {
+        return NULL;
+    }
+    const size_t padded = (size_t)(cols + 2) * (rows + 2);
+    ws->cols = cols;
+    ws->rows = rows;
+    ws->labels = (int16_t *)malloc(padded * sizeof(int16_t));
+    ws->levels = (basic_pixel_t *)malloc(padded * sizeof(basic_pixel_t));
+    ws->next = (uint32_t *)malloc(padded * sizeof(uint32_t));
+    ws->envelopes = (float *)malloc((size_t)MAX_THREADS * (3 * cols + 1) * sizeof(float));
+    ws->dist = newFloatImage(cols, rows);
+    ws->height = newBasicImage(cols, rows);
+    if(ws->labels == NULL || ws->levels == NULL || ws->next == NULL || ws->envelopes == NULL || ws->dist == NULL ||
+       ws->height == NULL)
+    {
+        deleteWatershedWorkspace(ws);
+        return NULL;
+    }
+    return ws;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void deleteWatershedWorkspace(watershedworkspace_t *ws)
+{
+    if(ws == NULL)
+    {
+        return;
+    }
+    free(ws->labels);
+    free(ws->levels);
+    free(ws->next);
+    free(ws->envelopes);
+    if(ws->dist != NULL)
+    {
+        deleteImage(ws->dist);
+    }
+    if(ws->height != NULL)
+    {
+        deleteImage(ws->height);
+    }
+    free(ws);
+}
+
+// ----------------------------------------------------------------------------
+// Watershed
+// ----------------------------------------------------------------------------
+
+// Header of an image of the size of src on the data of a workspace image
+static image_t workImage(const image_t *buf, const image_t *src)
+{
+    image_t img = *buf;
+    img.cols = src->cols;
+    img.rows = src->rows;
+    img.stride = src->cols;
+    return img;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t waterShedFast(const image_t *src,
+                       image_t *dst,
+                       const eConnected connected,
+                       const basic_pixel_t minh,
+                       const basic_pixel_t maxh,
+                       watershedworkspace_t *ws)
+{
+    register const int32_t cols = src->cols;
+    register const int32_t rows = src->rows;
+    register const int32_t w = cols + 2;
+    register int16_t *labels = ws->labels;
+    register basic_pixel_t *levels = ws->levels;
+    register uint32_t *next = ws->next;
+    register uint32_t p;
+    register uint32_t q;
+    register int32_t row;
+    register int32_t col;
+    register int32_t level;
+    register int32_t i;
+    register int16_t label;
+    const int32_t offsets[8] = {-1, 1, -w, w, -w - 1, -w + 1, w - 1, w + 1};
+    const int32_t nof_offsets = connected == FOUR ? 4 : 8;
+    uint32_t head[WS_LEVELS];
+    uint32_t tail[WS_LEVELS];
+    uint32_t nof_basins = 0;
+    uint32_t first;
+    uint32_t last;
+
+    if(!checkSize("waterShedFast", src, dst, ws))
+    {
+        return 0;
+    }
+
+    // padded copy, the border and the pixels above maxh are never flooded
+    for(p = 0; p < (uint32_t)w; p++)
+    {
+        labels[p] = WS_BORDER;
+        labels[(size_t)(rows + 1) * w + p] = WS_BORDER;
+    }
+    for(row = 0; row < rows; row++)
+    {
+        const basic_pixel_t *s = BASIC_ROW(src, row);
+        p = (row + 1) * w;
+        labels[p] = WS_BORDER;
+        labels[p + cols + 1] = WS_BORDER;
+        memcpy(levels + p + 1, s, cols);
+        for(col = 0; col < cols; col++)
+        {
+            labels[p + 1 + col] = s[col] > maxh ? WS_BORDER : WS_UNVISITED;
+        }
+    }
+
+    // markers, next is the queue of the fill
+    for(row = 0; row < rows; row++)
+    {
+        for(p = (row + 1) * w + 1; p <= (uint32_t)((row + 1) * w + cols); p++)
+        {
+            if(labels[p] != WS_UNVISITED || levels[p] > minh)
+            {
+                continue;
+            }
+            if(++nof_basins > MAX_INT16_LABELS)
+            {
+                fprintf(stderr, "waterShedFast(): more than %d markers\n", MAX_INT16_LABELS);
+                erase(dst);
+                dst->view = IMGVIEW_LABELED;
+                return 0;
+            }
+            label = (int16_t)nof_basins;
+            labels[p] = label;
+            first = 0;
+            last = 0;
+            next[last++] = p;
+            while(first < last)
+            {
+                q = next[first++];
+                for(i = 0; i < nof_offsets; i++)
+                {
+                    if(labels[q + offsets[i]] == WS_UNVISITED && levels[q + offsets[i]] <= minh)
+                    {
+                        labels[q + offsets[i]] = label;
+                        next[last++] = q + offsets[i];
+                    }
+                }
+            }
+        }
+    }
+
+    // the unvisited neighbours of the markers are the first pixels in the
+    // queue, the markers hold every pixel up to minh so they are above it
+    for(level = 0; level < WS_LEVELS; level++)
+    {
+        head[level] = WS_NONE;
+        tail[level] = WS_NONE;
+    }
+#define WS_PUSH(px, lv)                       \
+    do {                                      \
+        next[px] = WS_NONE;                   \
+        if(tail[lv] == WS_NONE)               \
+            head[lv] = (px);                  \
+        else                                  \
+            next[tail[lv]] = (px);            \
+        tail[lv] = (px);                      \
+    } while(0)
+    for(row = 0; row < rows; row++)
+    {
+        for(p = (row + 1) * w + 1; p <= (uint32_t)((row + 1) * w + cols); p++)
+        {
+            if(labels[p] <= 0)
+            {
+                continue;
+            }
+            for(i = 0; i < nof_offsets; i++)
+            {
+                q = p + offsets[i];
+                if(labels[q] == WS_UNVISITED)
+                {
+                    labels[q] = WS_QUEUED;
+                    WS_PUSH(q, levels[q]);
+                }
+            }
+        }
+    }
+
+    // flood, a pixel joins the basin of its labeled neighbours or is a line
+    // if they belong to different basins
+    for(level = (int32_t)minh + 1; level <= (int32_t)maxh; level++)
+    {
+        while(head[level] != WS_NONE)
+        {
+            p = head[level];
+            head[level] = next[p];
+            if(head[level] == WS_NONE)
+            {
+                tail[level] = WS_NONE;
+            }
+            label = 0;
+            for(i = 0; i < nof_offsets; i++)
+            {
+                if(labels[p + offsets[i]] > 0)
+                {
+                    if(label == 0)
+                    {
+                        label = labels[p + offsets[i]];
+                    }
+                    else if(labels[p + offsets[i]] != label)
+                    {
+                        label = WS_LINE;
+                        break;
+                    }
+                }
+            }
+            labels[p] = label;
+            if(label == WS_LINE)
+            {
+                continue;
+            }
+            for(i = 0; i < nof_offsets; i++)
+            {
+                q = p + offsets[i];
+                if(labels[q] == WS_UNVISITED)
+                {
+                    labels[q] = WS_QUEUED;
+                    if(levels[q] > level)
+                    {
+                        WS_PUSH(q, levels[q]);
+                    }
+                    else
+                    {
+                        WS_PUSH(q, level);
+                    }
+                }
+            }
+        }
+    }
+#undef WS_PUSH
+
+    // lines, unreached pixels and pixels above maxh are background
+    for(row = 0; row < rows; row++)
+    {
+        int16_pixel_t *d = INT16_ROW(dst, row);
+        const int16_t *l = labels + (row + 1) * w + 1;
+        for(col = 0; col < cols; col++)
+        {
+            d[col] = l[col] > 0 ? l[col] : 0;
+        }
+    }
+    dst->view = IMGVIEW_LABELED;
+    return nof_basins;
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+uint32_t splitBlobs(const image_t *src,
+                    image_t *dst,
+                    const eConnected connected,
+                    const int32_t seed_distance,
+                    watershedworkspace_t *ws)
+{
+    image_t dist = workImage(ws->dist, src);
+    image_t height = workImage(ws->height, src);
+    register int32_t row;
+    register int32_t col;
+    register int32_t r;
+
+    if(seed_distance < 1 || seed_distance > 254)
+    {
+        fprintf(stderr, "splitBlobs(): seed_distance %d is not in 1..254\n", seed_distance);
+        return 0;
+    }
+    if(!checkSize("splitBlobs", src, dst, ws) || !distanceTransform(src, &dist, ws))
+    {
+        return 0;
+    }
+    // the flooding starts at the largest distances, the background is above
+    // maxh
+    for(row = 0; row < src->rows; row++)
+    {
+        const float_pixel_t *d = FLOAT_ROW(&dist, row);
+        basic_pixel_t *h = BASIC_ROW(&height, row);
+        for(col = 0; col < src->cols; col++)
+        {
+            r = d[col] < 254.0f ? (int32_t)(d[col] + 0.5f) : 254;
+            h[col] = (basic_pixel_t)(255 - r);
+        }
+    }
+    return waterShedFast(&height, dst, connected, (basic_pixel_t)(255 - seed_distance), 254, ws);
+}
+
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
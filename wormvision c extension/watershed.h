@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Project    : Well position controller
+ *
+ * Description: Header file for the euclidean distance transform and the
+ *              marker based watershed transformation
+ *
+ *              The distance transform is exact and linear in the number of
+ *              pixels: the distance along every column is found in two scans,
+ *              then every row is the lower envelope of the parabolas of its
+ *              column distances (Felzenszwalb and Huttenlocher).
+ *
+ *              The watershed floods the image from its markers with a
+ *              hierarchical queue: one FIFO bucket per grey level, every pixel
+ *              is queued at most once, so it is linear in the number of pixels
+ *              as well (Meyer). The labels are int16, so up to
+ *              MAX_INT16_LABELS basins.
+ *
+ ******************************************************************************
+  Change History:
+
+    Version 1.0
+    > Initial revision
+
+******************************************************************************/
+#ifndef _WATERSHED_H_
+#define _WATERSHED_H_
+
+#include "stdint.h"
+#include "operators.h"
+
+// ----------------------------------------------------------------------------
+// Type definitions
+// ----------------------------------------------------------------------------
+
+// Workspace for distanceTransform(), waterShedFast() and splitBlobs(), see
+// newWatershedWorkspace(). The queue and the state are padded with a border
+// of one pixel, so the neighbours of a pixel are at fixed offsets.
+typedef struct watershedworkspace_t
+{
+    int32_t        cols;      // maximum image size
+    int32_t        rows;
+    int16_t       *labels;    // (cols + 2) x (rows + 2) labels and states
+    basic_pixel_t *levels;    // (cols + 2) x (rows + 2) grey levels
+    uint32_t      *next;      // next pixel in the bucket of each pixel
+    float         *envelopes; // MAX_THREADS lower envelope buffers of
+                              // 3 * cols + 1 values, one per row band
+    uint32_t       envelopes_used;  // bit mask of the buffers in use
+    image_t       *dist;      // float distances of splitBlobs()
+    image_t       *height;    // basic heights of splitBlobs()
+
+}watershedworkspace_t;
+
+// ----------------------------------------------------------------------------
+// Function prototypes
+// ----------------------------------------------------------------------------
+
+// Euclidean distance of every object pixel (not 0) of src to the nearest
+// background pixel (0), background pixels are 0. Pixels outside the image are
+// not background: if src has no background pixel at all the distances are
+// larger than any image. The columns and rows are processed in parallel
+// bands, see parallelRows(), no memory is allocated.
+// Returns 0 and prints an error if src does not fit in the workspace or dst
+// does not have the size of src.
+// A workspace must only be used by one thread at a time.
+//
+// Precondition : src is a basic image (or view)
+//                dst is a float image with the same size as src
+// Postcondition: -
+int distanceTransform( const image_t *src
+                     ,       image_t *dst
+                     ,       watershedworkspace_t *ws
+                     );
+
+// Create a workspace for images of at most cols x rows pixels
+// Memory is allocated within this function
+//
+// Precondition : -
+// Postcondition: User must free allocated memory by calling
+//                deleteWatershedWorkspace(), returns NULL if memory could not
+//                be allocated
+watershedworkspace_t *newWatershedWorkspace( const int32_t cols
+                                           , const int32_t rows
+                                           );
+void deleteWatershedWorkspace( watershedworkspace_t *ws );
+
+// Watershed transformation of the grey levels of src. The markers are the
+// connected regions of pixels with a level of at most minh, they are numbered
+// 1..n in the order of their first pixel (left top to right bottom). The
+// basins are flooded from the markers in order of level up to level maxh, a
+// pixel that would join two basins is a watershed line. Pixels above maxh and
+// pixels that are not reached from a marker are 0, as the lines.
+// Returns the number of basins, or 0 and prints an error if there are more
+// than MAX_INT16_LABELS markers, src does not fit in the workspace or dst does
+// not have the size of src.
+// A workspace must only be used by one thread at a time.
+//
+// Precondition : src is a basic image (or view) of at most ws->cols x
+//                ws->rows pixels
+//                dst is an int16 image with the same size as src
+// Postcondition: dst is a labeled int16 image
+uint32_t waterShedFast( const image_t *src
+                      ,       image_t *dst
+                      , const eConnected connected
+                      , const basic_pixel_t minh
+                      , const basic_pixel_t maxh
+                      ,       watershedworkspace_t *ws
+                      );
+
+// Split touching objects of a binary image, eg. two worms or clumped debris
+// that are one blob after thresholding. The markers are the parts of the
+// objects that are at least seed_distance pixels from the background; the
+// objects are flooded from the markers over their distance transform, so they
+// are split at their narrow necks. Objects that are nowhere seed_distance
+// pixels from the background keep label 0.
+// Returns the number of labeled objects, see waterShedFast().
+//
+// Precondition : src is a binary basic image (or view) of at most ws->cols x
+//                ws->rows pixels
+//                dst is an int16 image with the same size as src
+//                1 <= seed_distance <= 254
+// Postcondition: dst is a labeled int16 image
+uint32_t splitBlobs( const image_t *src
+                   ,       image_t *dst
+                   , const eConnected connected
+                   , const int32_t seed_distance
+                   ,       watershedworkspace_t *ws
+                   );
+
+#endif // _WATERSHED_H_
+// ----------------------------------------------------------------------------
+// EOF
+// ----------------------------------------------------------------------------
@@ -8,7 +8,16 @@
 
 // raspberry pi includes
 #include "Python.h"
+#include "pythread.h"
 #include "operators_basic.h"
+#include "operators_binary.h"
+#include "evaluators.h"
+#include "threads.h"
+#include "framering.h"
+#include "framearchive.h"
+#include "watershed.h"
+#include <string.h>
+#include <stdlib.h>
 
 // Manually define M_PI
 #define M_PI		3.14159265358979323846
@@ -19,10 +28,14 @@
 //         rows -> image row count
 // Returns: pointer to image_t struct with given imgdata, cols and rows
 image_t *newBasicImagePython(PyObject *data, int32_t cols, int32_t rows) {
+    if(PyList_Size(data) < (Py_ssize_t) rows * cols) {
+        PyErr_SetString(PyExc_ValueError, "image data list is smaller than cols * rows");
+        return NULL;
+    }
     // Create image_t struct
     image_t *img = newBasicImage(cols, rows);
 
-    if(img == NULL) { return NULL; }
+    if(img == NULL) { PyErr_NoMemory(); return NULL; }
     // Parse data from python list to c array
     for(int32_t i=0; i<rows*cols; i++) {
         img->data[i] = (basic_pixel_t) PyLong_AsLong(PyList_GetItem(data, i));
@@ -30,6 +43,309 @@ image_t *newBasicImagePython(PyObject *data, int32_t cols, int32_t rows) {
     return(img);
 }
 
+// Wrap a python object that supports the buffer protocol in an image_t struct, without copying the pixel data
+// Inputs: data -> any C-contiguous object with 8-bit grayscale pixel values from LT to BR (numpy array, bytes, memoryview...)
+//                 or a 2d rows x cols buffer with padded rows, eg. a slice of a larger numpy array
+//         view -> Py_buffer struct to fill, release with PyBuffer_Release when img is no longer used
+//         img -> image_t struct to fill, its data pointer will point into the buffer memory
+//         cols -> image col count
+//         rows -> image row count
+//         flags -> buffer request flags, PyBUF_WRITABLE for an output image
+// Returns: 0 on success, -1 with a python exception set on failure
+static int wrapBufferPython(PyObject *data, Py_buffer *view, image_t *img, int32_t cols, int32_t rows, int flags) {
+    if(PyObject_GetBuffer(data, view, flags) < 0) { return -1; }
+    if(view->itemsize != 1 || (view->format != NULL && strcmp(view->format, "B") != 0 && strcmp(view->format, "b") != 0
+                                                     && strcmp(view->format, "c") != 0)) {
+        PyErr_SetString(PyExc_TypeError, "image buffer must contain 8-bit pixels");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    img->stride = cols;
+    if(view->ndim == 2) {
+        // 2d buffer (numpy array), the rows can be padded but the pixels within a row must be adjacent
+        if(view->shape[0] != rows || view->shape[1] != cols || view->strides[1] != 1 || view->strides[0] < cols) {
+            PyErr_SetString(PyExc_ValueError, "image buffer must be rows x cols with adjacent pixels in a row");
+            PyBuffer_Release(view);
+            return -1;
+        }
+        img->stride = (int32_t) view->strides[0];
+    } else if(!PyBuffer_IsContiguous(view, 'C') || cols <= 0 || rows <= 0 || view->len != (Py_ssize_t) rows * cols) {
+        PyErr_SetString(PyExc_ValueError, "image buffer size does not match cols * rows");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    img->cols = cols;
+    img->rows = rows;
+    img->view = IMGVIEW_CLIP;
+    img->type = IMGTYPE_BASIC;
+    img->data = (uint8_t *) view->buf;
+    return 0;
+}
+
+// Wrap a python buffer in an image_t struct, see wrapBufferPython
+int wrapBasicImagePython(PyObject *data, Py_buffer *view, image_t *img, int32_t cols, int32_t rows) {
+    return wrapBufferPython(data, view, img, cols, rows, PyBUF_STRIDES | PyBUF_FORMAT);
+}
+
+// Pixel formats of the frames, see parseFormatPython
+typedef enum { FRAME_GRAY = 0, FRAME_YUV420, FRAME_RGB, FRAME_BGR } eFrameFormat;
+
+// Parse a frame format name
+// Inputs: name -> NULL or "gray": 8-bit grayscale, see wrapBasicImagePython
+//                 "yuv420": raw picamera yuv capture, only the Y plane is used, see wrapFramePython
+//                 "rgb", "bgr": 8-bit per channel colour frame, see wrapRGBImagePython
+// Returns: 0 on success, -1 with a python exception set on failure
+static int parseFormatPython(const char *name, eFrameFormat *format) {
+    if(name == NULL || strcmp(name, "gray") == 0) { *format = FRAME_GRAY; }
+    else if(strcmp(name, "yuv420") == 0) { *format = FRAME_YUV420; }
+    else if(strcmp(name, "rgb") == 0) { *format = FRAME_RGB; }
+    else if(strcmp(name, "bgr") == 0) { *format = FRAME_BGR; }
+    else {
+        PyErr_SetString(PyExc_ValueError, "format must be 'gray', 'yuv420', 'rgb' or 'bgr'");
+        return -1;
+    }
+    return 0;
+}
+
+// Wrap the grayscale pixels of a frame in an image_t struct, without copying the pixel data
+// Inputs: data -> FRAME_GRAY: see wrapBasicImagePython
+//                 FRAME_YUV420: C-contiguous yuv420 capture as written by picamera: a Y plane of
+//                 ((cols + 31) & ~31) x ((rows + 15) & ~15) pixels followed by the U and V planes
+//         format -> FRAME_GRAY or FRAME_YUV420, colour frames must be converted with to_gray first
+//         other parameters -> see wrapBasicImagePython
+// Returns: 0 on success, -1 with a python exception set on failure
+static int wrapFramePython(PyObject *data, Py_buffer *view, image_t *img, int32_t cols, int32_t rows,
+                           eFrameFormat format) {
+    if(format == FRAME_GRAY) { return wrapBasicImagePython(data, view, img, cols, rows); }
+    if(format != FRAME_YUV420) {
+        PyErr_SetString(PyExc_ValueError, "colour frames must be converted with to_gray first");
+        return -1;
+    }
+    if(PyObject_GetBuffer(data, view, PyBUF_SIMPLE) < 0) { return -1; }
+    int32_t stride = (cols + 31) & ~31;
+    int32_t height = (rows + 15) & ~15;
+    if(cols <= 0 || rows <= 0 || view->len < (Py_ssize_t) stride * height) {
+        PyErr_SetString(PyExc_ValueError, "yuv420 buffer is smaller than the Y plane of cols x rows pixels");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    img->cols = cols;
+    img->rows = rows;
+    img->stride = stride;
+    img->view = IMGVIEW_CLIP;
+    img->type = IMGTYPE_BASIC;
+    img->data = (uint8_t *) view->buf;
+    return 0;
+}
+
+// Wrap a colour frame in an IMGTYPE_RGB888 image_t struct, without copying the pixel data
+// Inputs: data -> rows x cols x 3 buffer with 8-bit channels (numpy array from picamera or cv2), the rows can be
+//                 padded, or a C-contiguous buffer of rows * cols * 3 bytes
+//         other parameters -> see wrapBasicImagePython
+// Returns: 0 on success, -1 with a python exception set on failure
+static int wrapRGBImagePython(PyObject *data, Py_buffer *view, image_t *img, int32_t cols, int32_t rows) {
+    if(PyObject_GetBuffer(data, view, PyBUF_STRIDES | PyBUF_FORMAT) < 0) { return -1; }
+    if(view->itemsize != 1) {
+        PyErr_SetString(PyExc_TypeError, "image buffer must contain 8-bit channels");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    img->stride = cols;
+    if(view->ndim == 3) {
+        if(view->shape[0] != rows || view->shape[1] != cols || view->shape[2] != 3 || view->strides[2] != 1 ||
+           view->strides[1] != 3 || view->strides[0] < (Py_ssize_t) cols * 3 || view->strides[0] % 3 != 0) {
+            PyErr_SetString(PyExc_ValueError, "image buffer must be rows x cols x 3 with adjacent pixels in a row");
+            PyBuffer_Release(view);
+            return -1;
+        }
+        img->stride = (int32_t) (view->strides[0] / 3);
+    } else if(!PyBuffer_IsContiguous(view, 'C') || cols <= 0 || rows <= 0 ||
+              view->len != (Py_ssize_t) rows * cols * 3) {
+        PyErr_SetString(PyExc_ValueError, "image buffer size does not match cols * rows * 3");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    img->cols = cols;
+    img->rows = rows;
+    img->view = IMGVIEW_CLIP;
+    img->type = IMGTYPE_RGB888;
+    img->data = (uint8_t *) view->buf;
+    return 0;
+}
+
+// Parse target from python tuple to array
+// Returns: 0 on success, -1 with a python exception set on failure
+static int parseTargetPython(PyObject *target_tuple, int32_t target[2]) {
+    if(PyTuple_Size(target_tuple) != 2) {
+        PyErr_SetString(PyExc_ValueError, "target must be an (x, y) tuple");
+        return -1;
+    }
+    target[0] = (int32_t) PyLong_AsLong(PyTuple_GetItem(target_tuple, 0));
+    target[1] = (int32_t) PyLong_AsLong(PyTuple_GetItem(target_tuple, 1));
+    if(PyErr_Occurred()) { return -1; }
+    return 0;
+}
+
+// Parse the optional region of interest arguments
+// Inputs: roi_obj -> None or (x, y, width, height) tuple
+//         search_radius -> 0 or radius in pixels of an roi around target
+// Returns: 1 if roi was set, 0 to evaluate the full frame, -1 with a python exception set on failure
+static int parseROIPython(PyObject *roi_obj, int32_t search_radius, const int32_t target[2], wbfe_roi_t *roi) {
+    if(roi_obj != NULL && roi_obj != Py_None) {
+        if(search_radius > 0) {
+            PyErr_SetString(PyExc_ValueError, "roi and search_radius can not be combined");
+            return -1;
+        }
+        if(!PyTuple_Check(roi_obj) || PyTuple_Size(roi_obj) != 4) {
+            PyErr_SetString(PyExc_ValueError, "roi must be an (x, y, width, height) tuple");
+            return -1;
+        }
+        roi->col = (int32_t) PyLong_AsLong(PyTuple_GetItem(roi_obj, 0));
+        roi->row = (int32_t) PyLong_AsLong(PyTuple_GetItem(roi_obj, 1));
+        roi->cols = (int32_t) PyLong_AsLong(PyTuple_GetItem(roi_obj, 2));
+        roi->rows = (int32_t) PyLong_AsLong(PyTuple_GetItem(roi_obj, 3));
+        if(PyErr_Occurred()) { return -1; }
+        return 1;
+    }
+    if(search_radius < 0) {
+        PyErr_SetString(PyExc_ValueError, "search_radius can not be negative");
+        return -1;
+    }
+    if(search_radius > 0) {
+        WBFE_autoROI(target, search_radius, roi);
+        return 1;
+    }
+    return 0;
+}
+
+// Parse the optional timings argument
+// Inputs: timings -> None, not given (NULL) or a dict to store the stage timings in, set to NULL if None
+// Returns: 0 on success, -1 with a python exception set on failure
+static int parseTimingsPython(PyObject **timings) {
+    if(*timings == Py_None) { *timings = NULL; }
+    if(*timings != NULL && !PyDict_Check(*timings)) {
+        PyErr_SetString(PyExc_TypeError, "timings must be a dict");
+        return -1;
+    }
+    return 0;
+}
+
+// Frame preprocessing cache shared by evaluators, see the wormvision.FrameCache type below
+typedef struct {
+    PyObject_HEAD
+    prepcache_t *cache;
+} FrameCacheObject;
+
+static PyObject *frame_cache_type = NULL;
+
+// Parse the optional cache argument
+// Inputs: cache_obj -> None, not given (NULL) or a wormvision.FrameCache
+// Returns: 0 on success with *cache set to the cache or NULL, -1 with a python exception set on failure
+static int parseCachePython(PyObject *cache_obj, prepcache_t **cache) {
+    *cache = NULL;
+    if(cache_obj == NULL || cache_obj == Py_None) { return 0; }
+    if(!PyObject_TypeCheck(cache_obj, (PyTypeObject *) frame_cache_type)) {
+        PyErr_SetString(PyExc_TypeError, "cache must be a wormvision.FrameCache");
+        return -1;
+    }
+    *cache = ((FrameCacheObject *) cache_obj)->cache;
+    if(*cache == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameCache is not initialised");
+        return -1;
+    }
+    return 0;
+}
+
+// Store the stage timings of an evaluation in a python dict
+// Inputs: timings -> dict, one item per stage name (see WBFE_STAGES) plus "total", in milliseconds
+// Returns: 0 on success, -1 with a python exception set on failure
+static int timingToPython(PyObject *timings, const wbfe_timing_t *timing) {
+    for(int32_t i = 0; i <= WBFE_NOF_STAGES; i++) {
+        PyObject *ms = PyFloat_FromDouble(i < WBFE_NOF_STAGES ? timing->ms[i] : timing->total_ms);
+        if(ms == NULL) { return -1; }
+        int rc = PyDict_SetItemString(timings, i < WBFE_NOF_STAGES ? WBFE_stageName(i) : "total", ms);
+        Py_DECREF(ms);
+        if(rc < 0) { return -1; }
+    }
+    return 0;
+}
+
+// Build the python return value from a pipeline result
+// Returns: Python tuple with (offset_x, offset_y) or None if no blob was found
+static PyObject *offsetToPython(int found, const int32_t offset[2]) {
+    if(!found) {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("(ii)", offset[0], offset[1]);
+}
+
+// Evaluate a wrapped frame, releases the buffer view when it is no longer needed
+// The GIL is released while the pipeline runs, so other python threads keep running. Only ctx and the frame are
+// used without the GIL, the caller must make sure no other thread uses ctx at the same time.
+// Inputs: copy_frame -> evaluate a private copy of the frame (or roi) in the context frame image, the buffer is
+//                       released before the evaluation
+//         roi -> region of interest to evaluate or NULL for the full frame, evaluated as a view into the frame
+// Returns: see WBFE_evaluateContext
+static int evaluateFrame(wbfe_context_t *ctx, Py_buffer *view, image_t *frame, int copy_frame,
+                         wbfe_roi_t *roi, const int32_t target[2], int32_t offset[2]) {
+    int found = 0;
+    wbfe_roi_t full = {0, 0, frame->cols, frame->rows};
+    if(roi == NULL) { roi = &full; }
+    int32_t roi_target[2] = {target[0], target[1]};
+    if(copy_frame) {
+        image_t *crop;
+        Py_BEGIN_ALLOW_THREADS
+        crop = WBFE_cropROI(ctx, frame, roi);
+        Py_END_ALLOW_THREADS
+        PyBuffer_Release(view);
+        if(crop == NULL) { return 0; }
+        roi_target[0] -= roi->col;
+        roi_target[1] -= roi->row;
+        Py_BEGIN_ALLOW_THREADS
+        found = WBFE_evaluateContext(ctx, crop, roi_target, offset);
+        Py_END_ALLOW_THREADS
+    } else {
+        image_t roi_view;
+        Py_BEGIN_ALLOW_THREADS
+        if(WBFE_clipROI(frame, roi)) {
+            subImage(frame, &roi_view, roi->col, roi->row, roi->cols, roi->rows);
+            roi_target[0] -= roi->col;
+            roi_target[1] -= roi->row;
+            found = WBFE_evaluateContext(ctx, &roi_view, roi_target, offset);
+        }
+        Py_END_ALLOW_THREADS
+        PyBuffer_Release(view);
+    }
+    return found;
+}
+
+// Check the evaluator parameters that newWBFEContext rejects
+// Returns: 0 on success, -1 with a python exception set on failure
+static int checkParamsPython(const wbfe_params_t *params) {
+    if(params->kernel_size <= 0 || params->kernel_size % 2 == 0) {
+        PyErr_SetString(PyExc_ValueError, "blur kernel size must be a positive odd number");
+        return -1;
+    }
+    if(params->open_size < 0) {
+        PyErr_SetString(PyExc_ValueError, "open kernel size must not be negative");
+        return -1;
+    }
+    if(params->pyramid_levels < 0 || params->pyramid_levels > WBFE_MAX_PYRAMID_LEVELS) {
+        PyErr_Format(PyExc_ValueError, "pyramid levels must be 0 to %d", WBFE_MAX_PYRAMID_LEVELS);
+        return -1;
+    }
+    return 0;
+}
+
+// Create a temporary evaluator context for the one-shot entry points
+// Returns: context or NULL with a python exception set on failure
+static wbfe_context_t *newWBFEContextPython(int32_t cols, int32_t rows, const wbfe_params_t *params) {
+    if(checkParamsPython(params) < 0) { return NULL; }
+    wbfe_context_t *ctx = newWBFEContext(cols, rows, params);
+    if(ctx == NULL) { PyErr_NoMemory(); }
+    return ctx;
+}
+
 
 // C version of well bottom features evaluate function.
 // Inputs: self -> WellBottomFeaturesEvaluator instance
@@ -43,102 +359,1290 @@ image_t *newBasicImagePython(PyObject *data, int32_t cols, int32_t rows) {
 //         gamma -> constant for gamma operation
 //         threshold_param -> threshold value: pixels above this value are selected
 //         area_threshold -> blobs smaller than this area will be ignored during classification
-// Returns: Python tuple with (offset_x, offset_y)
+//         separable -> optional, set to True to use the separable fixed point blur (within +-1 of the 2D blur)
+//         timings -> optional dict, filled with the monotonic clock time of each pipeline stage in milliseconds
+//                    (keys: WBFE_STAGES and "total")
+// Returns: Python tuple with (offset_x, offset_y) or None if no blob was found
 static PyObject *WBFE_evaluate(PyObject *self, PyObject *args) {
     PyObject *imgdata_list;
+    PyObject *timings = NULL;
+    wbfe_timing_t timing = {{0.0}, 0.0};
     int32_t imgrows;
     int32_t imgcols;
-    int32_t kernel_size;
-    double sigma;
-    basic_pixel_t threshold_param;
-    float c;
-    float g;
-    int32_t area_threshold;
+    wbfe_params_t params;
+    params.separable = 0;
+    params.open_size = 0;
+    params.pyramid_levels = 0;
 
     PyObject *target_tuple;
     int32_t target[2];
-    if(!PyArg_ParseTuple(args, "O!iiO!idffii", &PyList_Type, &imgdata_list,
+    int32_t offset[2];
+    if(!PyArg_ParseTuple(args, "O!iiO!idffii|pO", &PyList_Type, &imgdata_list,
                           &imgcols, &imgrows, &PyTuple_Type, &target_tuple,
-                          &kernel_size, &sigma, &c, &g, &threshold_param,
-                          &area_threshold)) { return NULL; }
+                          &params.kernel_size, &params.sigma, &params.c, &params.g, &params.threshold,
+                          &params.area_threshold, &params.separable, &timings)) { return NULL; }
+    if(parseTargetPython(target_tuple, target) < 0) { return NULL; }
+    if(parseTimingsPython(&timings) < 0) { return NULL; }
     // Parse args to image_t struct
-    //image_t *src = newBasicImagePython(imgdata_list, imgcols, imgrows);
-    // Create image_t struct
-    image_t *src = newBasicImage(imgcols, imgrows);
-
+    image_t *src = newBasicImagePython(imgdata_list, imgcols, imgrows);
     if(src == NULL) { return NULL; }
-    // Parse data from python list to c array
-    for(int32_t i=0; i<imgrows*imgcols; i++) {
-        src->data[i] = (basic_pixel_t) PyLong_AsLong(PyList_GetItem(imgdata_list, i));
-    }
+    wbfe_context_t *ctx = newWBFEContextPython(imgcols, imgrows, &params);
+    if(ctx == NULL) { deleteImage(src); return NULL; }
+    if(timings != NULL) { ctx->timing = &timing; }
 
-    // Parse target from python tuple to array
-    target[0] = (int32_t) PyLong_AsLong(PyTuple_GetItem(target_tuple, 0));
-    target[1] = (int32_t) PyLong_AsLong(PyTuple_GetItem(target_tuple, 1));
+    int found;
+    Py_BEGIN_ALLOW_THREADS
+    found = WBFE_evaluateContext(ctx, src, target, offset);
+    Py_END_ALLOW_THREADS
+
+    // Cleanup
+    deleteImage(src);
+    deleteWBFEContext(ctx);
+
+    if(timings != NULL && timingToPython(timings, &timing) < 0) { return NULL; }
+    return offsetToPython(found, offset);
+}
+
+// Buffer protocol version of WBFE_evaluate. The frame is read directly from the buffer memory instead of being
+// converted from a python list. The buffer is never written to.
+// Inputs: imgdata -> C-contiguous object with grayscale pixel values (8-bit) from LT to BR (numpy array, bytes...)
+//         copy -> optional, set to True to evaluate a private copy of the frame, eg. when the buffer can be
+//                 overwritten by the camera while evaluating
+//         roi -> optional (x, y, width, height) tuple, only this part of the frame is evaluated
+//         search_radius -> optional, evaluate an roi of this many pixels around target in all directions
+//         timings -> optional dict, see WBFE_evaluate
+//         open_kernelsize -> optional, size of the elliptical opening after the threshold, 0 (default) turns it off
+//         format -> optional, 'gray' (default) or 'yuv420' to evaluate the Y plane of a raw picamera yuv capture
+//         pyramid_levels -> optional, search the blobs in the frame downsampled this many times (0 to 2) and refine
+//                           the centroid of the best one at full resolution, 0 (default) turns it off
+//         other parameters -> see WBFE_evaluate
+// Returns: Python tuple with (offset_x, offset_y) or None if no blob was found
+static PyObject *WBFE_evaluate_buffer(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "imgcols", "imgrows", "target", "blur_kernelsize", "blur_sigma",
+                             "c", "gamma", "threshold", "area_threshold", "copy", "separable", "roi",
+                             "search_radius", "timings", "open_kernelsize", "format", "pyramid_levels", NULL};
+    PyObject *imgdata;
+    const char *format_name = NULL;
+    eFrameFormat format;
+    PyObject *timings = NULL;
+    wbfe_timing_t timing = {{0.0}, 0.0}; // stays 0 if the roi is empty
+    int32_t imgrows;
+    int32_t imgcols;
+    wbfe_params_t params;
+    int copy_frame = 0;
+    params.separable = 0;
+    params.open_size = 0;
+    params.pyramid_levels = 0;
+    PyObject *roi_obj = NULL;
+    int32_t search_radius = 0;
+    wbfe_roi_t roi;
+
+    PyObject *target_tuple;
+    int32_t target[2];
+    int32_t offset[2];
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "OiiO!idffii|ppOiOizi", kwlist, &imgdata,
+                                    &imgcols, &imgrows, &PyTuple_Type, &target_tuple,
+                                    &params.kernel_size, &params.sigma, &params.c, &params.g, &params.threshold,
+                                    &params.area_threshold, &copy_frame, &params.separable, &roi_obj,
+                                    &search_radius, &timings, &params.open_size, &format_name,
+                                    &params.pyramid_levels)) { return NULL; }
+    if(parseTargetPython(target_tuple, target) < 0) { return NULL; }
+    if(parseFormatPython(format_name, &format) < 0) { return NULL; }
+    if(parseTimingsPython(&timings) < 0) { return NULL; }
+    int use_roi = parseROIPython(roi_obj, search_radius, target, &roi);
+    if(use_roi < 0) { return NULL; }
+
+    Py_buffer view;
+    image_t frame;
+    if(wrapFramePython(imgdata, &view, &frame, imgcols, imgrows, format) < 0) { return NULL; }
+    wbfe_context_t *ctx = newWBFEContextPython(imgcols, imgrows, &params);
+    if(ctx == NULL) { PyBuffer_Release(&view); return NULL; }
+    if(timings != NULL) { ctx->timing = &timing; }
+
+    int found = evaluateFrame(ctx, &view, &frame, copy_frame, use_roi ? &roi : NULL, target, offset);
+
+    // Cleanup
+    deleteWBFEContext(ctx);
 
-    // 1. Gaussian blur
-    gaussianBlur(src, src, kernel_size, sigma);
-
-    // 2. Contrast stretch
-    contrastStretchFast(src, src);
-
-    // 3. Gamma
-    gamma_evdk(src, src, c, g);
-
-    // 4. Threshold
-    threshold(src, src, 0, threshold_param);
-    invert(src, src);
-
-    // 5. fill holes
-    fillHoles(src, src, EIGHT);
-
-    // 6. Labelling, feature extraction, classification to select correct blob
-    int8_t best_match = -1;
-    float best_score = 1000.0f;
-    float roundness_metric, eccentricity_metric, score;
-    float m20, m02, m11;
-    uint32_t blob_count;
-    blob_count = labelBlobs(src, src, EIGHT);
-    blobinfo_t info;
-    for(uint32_t i = 1; i <= blob_count; i++) {
-        blobAnalyse(src, i, &info);
-        if(info.nof_pixels < area_threshold) {
-            continue;
+    if(timings != NULL && timingToPython(timings, &timing) < 0) { return NULL; }
+    return offsetToPython(found, offset);
+}
+
+// Wrap the frames of a 3d nof_frames x rows x cols buffer (eg. a numpy array of logged frames) in image_t structs,
+// without copying the pixel data. The frames and rows can be padded, the pixels within a row must be adjacent.
+// Inputs: data -> 3d buffer with 8-bit pixels
+//         view -> Py_buffer struct to fill, release with PyBuffer_Release when the frames are no longer used
+//         frames -> set to an array of nof_frames images that point into the buffer memory, free with PyMem_Free
+// Returns: 0 on success, -1 with a python exception set on failure
+static int wrapStackPython(PyObject *data, Py_buffer *view, image_t **frames, uint32_t *nof_frames) {
+    if(PyObject_GetBuffer(data, view, PyBUF_STRIDES | PyBUF_FORMAT) < 0) { return -1; }
+    if(view->itemsize != 1 || (view->format != NULL && strcmp(view->format, "B") != 0 && strcmp(view->format, "b") != 0
+                                                     && strcmp(view->format, "c") != 0)) {
+        PyErr_SetString(PyExc_TypeError, "frame buffer must contain 8-bit pixels");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    if(view->ndim != 3 || view->shape[0] <= 0 || view->shape[1] <= 0 || view->shape[2] <= 0 ||
+       view->strides[2] != 1 || view->strides[1] < view->shape[2] || view->strides[0] < view->shape[1] * view->strides[1]) {
+        PyErr_SetString(PyExc_ValueError, "frame buffer must be frames x rows x cols with adjacent pixels in a row");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    *nof_frames = (uint32_t) view->shape[0];
+    *frames = (image_t *) PyMem_Malloc(*nof_frames * sizeof(image_t));
+    if(*frames == NULL) {
+        PyBuffer_Release(view);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for(uint32_t f = 0; f < *nof_frames; f++) {
+        image_t *img = &(*frames)[f];
+        img->cols = (int32_t) view->shape[2];
+        img->rows = (int32_t) view->shape[1];
+        img->stride = (int32_t) view->strides[1];
+        img->view = IMGVIEW_CLIP;
+        img->type = IMGTYPE_BASIC;
+        img->data = (uint8_t *) view->buf + f * view->strides[0];
+    }
+    return 0;
+}
+
+// Parse one axis of a parameter grid
+// Inputs: seq -> None or not given (NULL): the single value *values[0], otherwise a sequence of numbers
+//         values -> set to a PyMem_Malloc array, free with PyMem_Free
+//         as_float -> 1 for float values, 0 for int32_t values
+// Returns: number of values, -1 with a python exception set on failure
+static Py_ssize_t parseGridPython(PyObject *seq, const char *name, void *value, void **values, int as_float) {
+    size_t size = as_float ? sizeof(float) : sizeof(int32_t);
+    Py_ssize_t n = 1;
+    if(seq != NULL && seq != Py_None) {
+        n = PySequence_Size(seq);
+        if(n <= 0) {
+            if(n == 0) { PyErr_Format(PyExc_ValueError, "%s must not be empty", name); }
+            return -1;
         }
-        // Calculate roundness metric
-        roundness_metric = 4 * M_PI * info.nof_pixels / (info.perimeter * info.perimeter);
-        // Calculate eccentricity metric using moments
-        m20 = normalizedCentralMoments(src, i, 2, 0);
-        m02 = normalizedCentralMoments(src, i, 0, 2);
-        m11 = normalizedCentralMoments(src, i, 1, 1);
-        eccentricity_metric = ((m20 - m02) * (m20 - m02) + 4 * m11 * m11) / ((m20 + m02) * (m20 + m02));
-        score = (1-roundness_metric + eccentricity_metric) / 2;
-
-        if(score < best_score) {
-            best_score = score;
-            best_match = i;
+    }
+    *values = PyMem_Malloc(n * size);
+    if(*values == NULL) { PyErr_NoMemory(); return -1; }
+    if(seq == NULL || seq == Py_None) {
+        memcpy(*values, value, size);
+        return 1;
+    }
+    for(Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = PySequence_GetItem(seq, i);
+        if(item == NULL) { PyMem_Free(*values); return -1; }
+        if(as_float) { ((float *) *values)[i] = (float) PyFloat_AsDouble(item); }
+        else { ((int32_t *) *values)[i] = (int32_t) PyLong_AsLong(item); }
+        Py_DECREF(item);
+        if(PyErr_Occurred()) { PyMem_Free(*values); return -1; }
+    }
+    return n;
+}
+
+// Evaluate a stack of frames with every combination of a grid of parameters, eg. to tune the parameters on logged
+// frames. The frames are evaluated on the thread pool of the neighbourhood operators (see set_threads), the blur of
+// a frame is shared by all parameter sets. The GIL is released during the evaluation.
+// Inputs: frames -> 3d frames x rows x cols buffer with 8-bit grayscale pixels (eg. numpy.stack of the frames, or a FrameArchive)
+//         target -> tuple with target coordinates {x, y} of all frames
+//         thresholds -> optional sequence of threshold values, None (default): only threshold
+//         gammas -> optional sequence of gamma values, None (default): only gamma
+//         area_thresholds -> optional sequence of area threshold values, None (default): only area_threshold
+//         search_radius -> optional, evaluate an roi of this many pixels around target in all frames
+//         other parameters -> see WBFE_evaluate_buffer
+// Returns: (offsets, found) tuple of bytearrays. The parameter sets are the combinations of thresholds, gammas and
+//          area_thresholds in that order (the last one changes fastest, as itertools.product). offsets holds an
+//          (offset_x, offset_y) pair of native int32 values (numpy.int32) for each parameter set and frame: the
+//          result of parameter set p and frame f is pair p * frames + f. found holds one byte for each pair, 0 if no
+//          blob was found (the offset is then 0, 0).
+static PyObject *evaluate_batch(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"frames", "target", "blur_kernelsize", "blur_sigma", "c", "gamma", "threshold",
+                             "area_threshold", "separable", "search_radius", "open_kernelsize", "pyramid_levels",
+                             "thresholds", "gammas", "area_thresholds", NULL};
+    PyObject *frames_obj;
+    PyObject *target_tuple;
+    PyObject *thresholds_obj = NULL;
+    PyObject *gammas_obj = NULL;
+    PyObject *areas_obj = NULL;
+    int32_t target[2];
+    int32_t search_radius = 0;
+    wbfe_params_t params;
+    params.separable = 0;
+    params.open_size = 0;
+    params.pyramid_levels = 0;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "OO!idffii|piiiOOO", kwlist, &frames_obj,
+                                    &PyTuple_Type, &target_tuple, &params.kernel_size, &params.sigma, &params.c,
+                                    &params.g, &params.threshold, &params.area_threshold, &params.separable,
+                                    &search_radius, &params.open_size, &params.pyramid_levels, &thresholds_obj,
+                                    &gammas_obj, &areas_obj)) { return NULL; }
+    if(parseTargetPython(target_tuple, target) < 0) { return NULL; }
+    if(checkParamsPython(&params) < 0) { return NULL; }
+    wbfe_roi_t roi;
+    int use_roi = parseROIPython(NULL, search_radius, target, &roi);
+    if(use_roi < 0) { return NULL; }
+
+    int32_t *thresholds = NULL;
+    float *gammas = NULL;
+    int32_t *areas = NULL;
+    Py_ssize_t nt = parseGridPython(thresholds_obj, "thresholds", &params.threshold, (void **) &thresholds, 0);
+    Py_ssize_t ng = nt < 0 ? -1 : parseGridPython(gammas_obj, "gammas", &params.g, (void **) &gammas, 1);
+    Py_ssize_t na = ng < 0 ? -1 : parseGridPython(areas_obj, "area_thresholds", &params.area_threshold,
+                                                  (void **) &areas, 0);
+    PyObject *result = NULL;
+    PyObject *offsets_obj = NULL;
+    PyObject *found_obj = NULL;
+    wbfe_params_t *grid = NULL;
+    image_t *frames = NULL;
+    uint32_t nof_frames = 0;
+    Py_buffer view;
+    if(na < 0) { goto cleanup; }
+    Py_ssize_t nof_params = nt * ng * na;
+    grid = (wbfe_params_t *) PyMem_Malloc(nof_params * sizeof(wbfe_params_t));
+    if(grid == NULL) { PyErr_NoMemory(); goto cleanup; }
+    for(Py_ssize_t p = 0; p < nof_params; p++) {
+        grid[p] = params;
+        grid[p].threshold = thresholds[p / (ng * na)];
+        grid[p].g = gammas[p / na % ng];
+        grid[p].area_threshold = areas[p % na];
+    }
+
+    if(wrapStackPython(frames_obj, &view, &frames, &nof_frames) < 0) { goto cleanup; }
+    offsets_obj = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t) nof_params * nof_frames * 2 * sizeof(int32_t));
+    found_obj = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t) nof_params * nof_frames);
+    if(offsets_obj == NULL || found_obj == NULL) { PyBuffer_Release(&view); goto cleanup; }
+    int32_t *offsets = (int32_t *) PyByteArray_AsString(offsets_obj);
+    uint8_t *found = (uint8_t *) PyByteArray_AsString(found_obj);
+    int ok = 1;
+    Py_BEGIN_ALLOW_THREADS
+    int32_t roi_target[2] = {target[0], target[1]};
+    if(use_roi) {
+        // the same roi of every frame, evaluated as a view
+        if(WBFE_clipROI(&frames[0], &roi)) {
+            for(uint32_t f = 0; f < nof_frames; f++) {
+                image_t frame = frames[f];
+                subImage(&frame, &frames[f], roi.col, roi.row, roi.cols, roi.rows);
+            }
+            roi_target[0] -= roi.col;
+            roi_target[1] -= roi.row;
+        } else {
+            memset(offsets, 0, (size_t) nof_params * nof_frames * 2 * sizeof(int32_t));
+            memset(found, 0, (size_t) nof_params * nof_frames);
+            use_roi = -1;
         }
     }
+    if(use_roi >= 0) {
+        ok = WBFE_evaluateBatch(frames, nof_frames, grid, (uint32_t) nof_params, roi_target, offsets, found);
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    if(!ok) { PyErr_NoMemory(); goto cleanup; }
+    result = PyTuple_Pack(2, offsets_obj, found_obj);
 
-    // 7. Calculate centroid / offset
-    int32_t cc, rc;
-    int32_t offset_x, offset_y;
-    centroid(src, best_match, &cc, &rc);
-    offset_x = cc - target[0];
-    offset_y = rc - target[1];
+cleanup:
+    Py_XDECREF(offsets_obj);
+    Py_XDECREF(found_obj);
+    PyMem_Free(frames);
+    PyMem_Free(grid);
+    PyMem_Free(thresholds);
+    PyMem_Free(gammas);
+    PyMem_Free(areas);
+    return result;
+}
+
+// C version of the Hough transform evaluate function, the frame is read through the buffer protocol as in
+// WBFE_evaluate_buffer. Same pipeline as HoughTransformEvaluator: blur, contrast stretch, gamma and
+// cv2.HoughCircles(img, cv2.HOUGH_GRADIENT, 1, min_distance, ...)
+// Inputs: imgdata -> C-contiguous object with grayscale pixel values (8-bit) from LT to BR (numpy array, bytes...)
+//         imgcols -> image col count
+//         imgrows -> image row count
+//         target -> tuple with target coordinates {x, y}
+//         blur_kernelsize -> kernel size for blur
+//         blur_sigma -> sigma for blur
+//         c -> constant for gamma operation
+//         gamma -> constant for gamma operation
+//         min_radius -> smallest circle radius
+//         max_radius -> largest circle radius
+//         min_distance -> minimum distance between the centers of two circles
+//         param1 -> higher threshold passed to canny, the lower threshold is half of this
+//         param2 -> accumulator threshold
+//         separable -> optional, set to True to use the separable fixed point blur (within +-1 of the 2D blur)
+//         cache -> optional wormvision.FrameCache, the blur, stretch and gamma are shared with the other evaluations
+//                  of the frame with the same parameters
+//         format -> optional, see WBFE_evaluate_buffer
+// Returns: Python tuple with (offset_x, offset_y) floats, target - circle center, or None if no circle was found
+static PyObject *HT_evaluate(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "imgcols", "imgrows", "target", "blur_kernelsize", "blur_sigma",
+                             "c", "gamma", "min_radius", "max_radius", "min_distance", "param1", "param2",
+                             "separable", "cache", "format", NULL};
+    PyObject *imgdata;
+    const char *format_name = NULL;
+    eFrameFormat format;
+    PyObject *cache_obj = NULL;
+    prepcache_t *cache;
+    int32_t imgrows;
+    int32_t imgcols;
+    ht_params_t params;
+    params.separable = 0;
+
+    PyObject *target_tuple;
+    int32_t target[2];
+    float offset[2];
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "OiiO!idffiiiii|pOz", kwlist, &imgdata,
+                                    &imgcols, &imgrows, &PyTuple_Type, &target_tuple,
+                                    &params.kernel_size, &params.sigma, &params.c, &params.g,
+                                    &params.hough.min_radius, &params.hough.max_radius, &params.hough.min_distance,
+                                    &params.hough.canny_threshold, &params.hough.acc_threshold,
+                                    &params.separable, &cache_obj, &format_name)) { return NULL; }
+    if(parseTargetPython(target_tuple, target) < 0) { return NULL; }
+    if(parseFormatPython(format_name, &format) < 0) { return NULL; }
+    if(parseCachePython(cache_obj, &cache) < 0) { return NULL; }
+    if(params.kernel_size <= 0 || params.kernel_size % 2 == 0) {
+        PyErr_SetString(PyExc_ValueError, "blur kernel size must be a positive odd number");
+        return NULL;
+    }
+
+    Py_buffer view;
+    image_t frame;
+    if(wrapFramePython(imgdata, &view, &frame, imgcols, imgrows, format) < 0) { return NULL; }
+    ht_context_t *ctx = newHTContext(imgcols, imgrows, &params);
+    if(ctx == NULL) { PyBuffer_Release(&view); return PyErr_NoMemory(); }
+    ctx->cache = cache;
+
+    int found;
+    Py_BEGIN_ALLOW_THREADS
+    found = HT_evaluateContext(ctx, &frame, target, offset);
+    Py_END_ALLOW_THREADS
 
     // Cleanup
-    deleteImage(src);
+    PyBuffer_Release(&view);
+    deleteHTContext(ctx);
+
+    if(!found) {
+        Py_RETURN_NONE;
+    }
+    return Py_BuildValue("(ff)", offset[0], offset[1]);
+}
+
+// ----------------------------------------------------------------------------
+// wormvision.Evaluator type
+// ----------------------------------------------------------------------------
+
+// Persistent well bottom features evaluator. Created once per resolution and parameter set, it owns all working
+// images, the gaussian kernel and the gamma look up table, so evaluating a frame does not allocate memory.
+// The working images are shared by all calls, lock serialises the calls from different threads. Use one Evaluator
+// per thread to evaluate frames in parallel.
+// track is the blob of the last evaluation with track=True, see WBFE_evaluateContext.
+typedef struct {
+    PyObject_HEAD
+    wbfe_context_t *ctx;
+    PyThread_type_lock lock;
+    wbfe_track_t track;
+} EvaluatorObject;
+
+// Acquire the lock of an Evaluator, the GIL is released while waiting for another thread to finish
+static void lockEvaluator(EvaluatorObject *self) {
+    if(!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+// Evaluator(imgcols, imgrows, blur_kernelsize, blur_sigma, c, gamma, threshold, area_threshold, separable=False,
+//           open_kernelsize=0, pyramid_levels=0), see WBFE_evaluate_buffer
+static int Evaluator_init(EvaluatorObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgcols", "imgrows", "blur_kernelsize", "blur_sigma",
+                             "c", "gamma", "threshold", "area_threshold", "separable", "open_kernelsize",
+                             "pyramid_levels", NULL};
+    int32_t imgrows;
+    int32_t imgcols;
+    wbfe_params_t params;
+    params.separable = 0;
+    params.open_size = 0;
+    params.pyramid_levels = 0;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "iiidffii|pii", kwlist, &imgcols, &imgrows,
+                                    &params.kernel_size, &params.sigma, &params.c, &params.g, &params.threshold,
+                                    &params.area_threshold, &params.separable, &params.open_size,
+                                    &params.pyramid_levels)) { return -1; }
+    if(imgcols <= 0 || imgrows <= 0) {
+        PyErr_SetString(PyExc_ValueError, "image size must be positive");
+        return -1;
+    }
+    if(self->lock == NULL) {
+        self->lock = PyThread_allocate_lock();
+        if(self->lock == NULL) { PyErr_NoMemory(); return -1; }
+    }
+    wbfe_context_t *ctx = newWBFEContextPython(imgcols, imgrows, &params);
+    if(ctx == NULL) { return -1; }
+    // another thread can be evaluating with the old context
+    lockEvaluator(self);
+    deleteWBFEContext(self->ctx);
+    self->ctx = ctx;
+    memset(&self->track, 0, sizeof(self->track));
+    PyThread_release_lock(self->lock);
+    return 0;
+}
+
+static void Evaluator_dealloc(EvaluatorObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    deleteWBFEContext(self->ctx);
+    if(self->lock != NULL) { PyThread_free_lock(self->lock); }
+    freefunc tp_free = (freefunc) PyType_GetSlot(type, Py_tp_free);
+    tp_free(self);
+    Py_DECREF(type);
+}
+
+// Evaluator.evaluate(imgdata, target, copy=False, roi=None, search_radius=0, timings=None, cache=None, format='gray',
+//                    track=False)
+// Inputs: imgdata -> C-contiguous object with grayscale pixel values (8-bit), imgcols x imgrows pixels
+//         target -> tuple with target coordinates {x, y}
+//         copy, roi, search_radius, timings -> see WBFE_evaluate_buffer
+//         cache -> optional wormvision.FrameCache, the blur is shared with the other evaluations of the frame with
+//                  the same blur parameters
+//         format -> optional, see WBFE_evaluate_buffer
+//         track -> optional, set to True to search the blob of the last tracked evaluation near its expected
+//                  position first (see track_move), the whole frame is only searched if it is not found there. The
+//                  roi must be the same for all tracked evaluations.
+// Returns: Python tuple with (offset_x, offset_y) or None if no blob was found
+static PyObject *Evaluator_evaluate(EvaluatorObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "target", "copy", "roi", "search_radius", "timings", "cache", "format",
+                             "track", NULL};
+    PyObject *imgdata;
+    PyObject *timings = NULL;
+    PyObject *cache_obj = NULL;
+    const char *format_name = NULL;
+    eFrameFormat format;
+    prepcache_t *cache;
+    wbfe_timing_t timing = {{0.0}, 0.0}; // stays 0 if the roi is empty
+    PyObject *target_tuple;
+    int copy_frame = 0;
+    int track = 0;
+    PyObject *roi_obj = NULL;
+    int32_t search_radius = 0;
+    wbfe_roi_t roi;
+    int32_t target[2];
+    int32_t offset[2];
+    if(self->lock == NULL || self->ctx == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Evaluator is not initialised");
+        return NULL;
+    }
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "OO!|pOiOOzp", kwlist, &imgdata, &PyTuple_Type, &target_tuple,
+                                    &copy_frame, &roi_obj, &search_radius, &timings, &cache_obj,
+                                    &format_name, &track)) { return NULL; }
+    if(parseTargetPython(target_tuple, target) < 0) { return NULL; }
+    if(parseFormatPython(format_name, &format) < 0) { return NULL; }
+    if(parseTimingsPython(&timings) < 0) { return NULL; }
+    if(parseCachePython(cache_obj, &cache) < 0) { return NULL; }
+    int use_roi = parseROIPython(roi_obj, search_radius, target, &roi);
+    if(use_roi < 0) { return NULL; }
+
+    Py_buffer view;
+    image_t frame;
+    lockEvaluator(self);
+    if(wrapFramePython(imgdata, &view, &frame, self->ctx->cols, self->ctx->rows, format) < 0) {
+        PyThread_release_lock(self->lock);
+        return NULL;
+    }
+    self->ctx->timing = timings != NULL ? &timing : NULL;
+    self->ctx->cache = cache;
+    self->ctx->track = track ? &self->track : NULL;
+
+    int found = evaluateFrame(self->ctx, &view, &frame, copy_frame, use_roi ? &roi : NULL, target, offset);
+    self->ctx->timing = NULL;
+    self->ctx->cache = NULL;
+    self->ctx->track = NULL;
+    PyThread_release_lock(self->lock);
+
+    if(timings != NULL && timingToPython(timings, &timing) < 0) { return NULL; }
+    return offsetToPython(found, offset);
+}
+
+// Evaluator.track_move(shift)
+// Inputs: shift -> (x, y) tuple, expected move of the tracked blob in pixels since the last evaluation (eg. the
+//                  correction that was sent to the motors), added to the earlier shifts
+static PyObject *Evaluator_track_move(EvaluatorObject *self, PyObject *args) {
+    PyObject *shift_tuple;
+    int32_t shift[2];
+    if(!PyArg_ParseTuple(args, "O!", &PyTuple_Type, &shift_tuple)) { return NULL; }
+    if(parseTargetPython(shift_tuple, shift) < 0) { return NULL; }
+    lockEvaluator(self);
+    WBFE_trackMove(&self->track, shift);
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+// Evaluator.track_reset(), the next tracked evaluation searches the whole frame
+static PyObject *Evaluator_track_reset(EvaluatorObject *self, PyObject *args) {
+    lockEvaluator(self);
+    WBFE_trackReset(&self->track);
+    PyThread_release_lock(self->lock);
+    Py_RETURN_NONE;
+}
+
+// Evaluator.track_stats()
+// Returns: (hits, misses) tuple, the number of tracked evaluations that found the blob where it was expected and that
+//          had to search the whole frame
+static PyObject *Evaluator_track_stats(EvaluatorObject *self, PyObject *args) {
+    return Py_BuildValue("(II)", self->track.hits, self->track.misses);
+}
+
+static PyMethodDef Evaluator_methods[] = {
+    {"evaluate", (PyCFunction) Evaluator_evaluate, METH_VARARGS | METH_KEYWORDS,
+     "Evaluate a frame, returns the (offset_x, offset_y) tuple or None if no blob was found."},
+    {"track_move", (PyCFunction) Evaluator_track_move, METH_VARARGS,
+     "Add the expected move in pixels of the tracked blob since the last evaluation."},
+    {"track_reset", (PyCFunction) Evaluator_track_reset, METH_NOARGS,
+     "Forget the tracked blob."},
+    {"track_stats", (PyCFunction) Evaluator_track_stats, METH_NOARGS,
+     "Number of tracked evaluations with and without a full search, (hits, misses) tuple."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot Evaluator_slots[] = {
+    {Py_tp_doc, "Well bottom features evaluator with preallocated working images."},
+    {Py_tp_new, PyType_GenericNew},
+    {Py_tp_init, Evaluator_init},
+    {Py_tp_dealloc, Evaluator_dealloc},
+    {Py_tp_methods, Evaluator_methods},
+    {0, NULL}
+};
+
+static PyType_Spec Evaluator_spec = {
+    "wormvision.Evaluator",
+    sizeof(EvaluatorObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Evaluator_slots
+};
+
+// ----------------------------------------------------------------------------
+// wormvision.FrameCache type
+// ----------------------------------------------------------------------------
+
+// Preprocessing results of one frame, shared by the evaluations of that frame: evaluators with the same blur (and
+// stretch and gamma) parameters reuse the result of the first one instead of recomputing it. Call new_frame()
+// before evaluating a new frame, not while evaluations with the cache are running. The evaluations can run in
+// parallel threads.
+
+// FrameCache(imgcols, imgrows), frames of at most imgcols x imgrows pixels are cached
+// The cache can not be initialised again: evaluations in other threads may be using it without the GIL.
+static int FrameCache_init(FrameCacheObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgcols", "imgrows", NULL};
+    int32_t imgrows;
+    int32_t imgcols;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "ii", kwlist, &imgcols, &imgrows)) { return -1; }
+    if(self->cache != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameCache is already initialised");
+        return -1;
+    }
+    if(imgcols <= 0 || imgrows <= 0) {
+        PyErr_SetString(PyExc_ValueError, "image size must be positive");
+        return -1;
+    }
+    prepcache_t *cache = newPrepCache(imgcols, imgrows);
+    if(cache == NULL) { PyErr_NoMemory(); return -1; }
+    self->cache = cache;
+    return 0;
+}
+
+static void FrameCache_dealloc(FrameCacheObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    deletePrepCache(self->cache);
+    freefunc tp_free = (freefunc) PyType_GetSlot(type, Py_tp_free);
+    tp_free(self);
+    Py_DECREF(type);
+}
+
+// FrameCache.new_frame(), invalidates the cached results
+static PyObject *FrameCache_new_frame(FrameCacheObject *self, PyObject *args) {
+    if(self->cache == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameCache is not initialised");
+        return NULL;
+    }
+    prepCacheNewFrame(self->cache);
+    Py_RETURN_NONE;
+}
+
+// FrameCache.stats()
+// Returns: (hits, misses) tuple, the number of cached results that were reused and calculated
+static PyObject *FrameCache_stats(FrameCacheObject *self, PyObject *args) {
+    if(self->cache == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameCache is not initialised");
+        return NULL;
+    }
+    return Py_BuildValue("(II)", self->cache->hits, self->cache->misses);
+}
+
+static PyMethodDef FrameCache_methods[] = {
+    {"new_frame", (PyCFunction) FrameCache_new_frame, METH_NOARGS,
+     "Invalidate the cached results, call before evaluating a new frame."},
+    {"stats", (PyCFunction) FrameCache_stats, METH_NOARGS,
+     "Number of cached results that were reused and calculated, (hits, misses) tuple."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot FrameCache_slots[] = {
+    {Py_tp_doc, "Preprocessing results of one frame, shared by the evaluators of that frame."},
+    {Py_tp_new, PyType_GenericNew},
+    {Py_tp_init, FrameCache_init},
+    {Py_tp_dealloc, FrameCache_dealloc},
+    {Py_tp_methods, FrameCache_methods},
+    {0, NULL}
+};
+
+static PyType_Spec FrameCache_spec = {
+    "wormvision.FrameCache",
+    sizeof(FrameCacheObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    FrameCache_slots
+};
+
+// Wrap a camera frame in any format without copying the pixel data, see wrapRGBImagePython and wrapFramePython
+// Returns: 0 on success, -1 with a python exception set on failure
+static int wrapCameraFramePython(PyObject *data, Py_buffer *view, image_t *img, int32_t cols, int32_t rows,
+                                 eFrameFormat format) {
+    if(format == FRAME_RGB || format == FRAME_BGR) { return wrapRGBImagePython(data, view, img, cols, rows); }
+    return wrapFramePython(data, view, img, cols, rows, format);
+}
+
+// Convert a frame of wrapCameraFramePython to grayscale, does not use the python API so the GIL can be released
+static void cameraFrameToGray(const image_t *frame, image_t *gray, eFrameFormat format) {
+    if(frame->type == IMGTYPE_RGB888) {
+        rgb888ToGray(frame, gray, format == FRAME_BGR, GRAY_BT601);
+    } else {
+        copy(frame, gray);
+    }
+}
+
+// to_gray(imgdata, imgcols, imgrows, format='bgr', out=None)
+// Convert a camera frame to the grayscale frame of the evaluators in one pass, the GIL is released while converting.
+// Colour frames give the same pixels as cv2.cvtColor(img, cv2.COLOR_BGR2GRAY) (or COLOR_RGB2GRAY).
+// Inputs: imgdata -> frame in the given format, see wrapRGBImagePython and wrapFramePython
+//         imgcols -> image col count
+//         imgrows -> image row count
+//         format -> 'bgr' (default, cv2 and picamera bgr captures), 'rgb', 'yuv420' (the Y plane is copied) or 'gray'
+//                   (copied)
+//         out -> optional writable rows x cols buffer (eg. numpy.empty((rows, cols), numpy.uint8)) for the result
+// Returns: out, or a new bytearray of cols * rows pixels if out is None
+static PyObject *to_gray(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "imgcols", "imgrows", "format", "out", NULL};
+    PyObject *imgdata;
+    PyObject *out = Py_None;
+    const char *format_name = "bgr";
+    eFrameFormat format;
+    int32_t imgrows;
+    int32_t imgcols;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "Oii|zO", kwlist, &imgdata, &imgcols, &imgrows,
+                                    &format_name, &out)) { return NULL; }
+    if(parseFormatPython(format_name, &format) < 0) { return NULL; }
+    if(imgcols <= 0 || imgrows <= 0) {
+        PyErr_SetString(PyExc_ValueError, "image size must be positive");
+        return NULL;
+    }
+
+    Py_buffer view;
+    image_t frame;
+    if(wrapCameraFramePython(imgdata, &view, &frame, imgcols, imgrows, format) < 0) { return NULL; }
+
+    Py_buffer out_view;
+    image_t gray;
+    if(out == Py_None) {
+        out = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t) imgcols * imgrows);
+        if(out == NULL) { PyBuffer_Release(&view); return NULL; }
+    } else {
+        Py_INCREF(out);
+    }
+    if(wrapBufferPython(out, &out_view, &gray, imgcols, imgrows, PyBUF_WRITABLE | PyBUF_STRIDES | PyBUF_FORMAT) < 0) {
+        PyBuffer_Release(&view);
+        Py_DECREF(out);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    cameraFrameToGray(&frame, &gray, format);
+    Py_END_ALLOW_THREADS
+
+    // Cleanup
+    PyBuffer_Release(&out_view);
+    PyBuffer_Release(&view);
+    return out;
+}
+
+// distance_transform(imgdata, imgcols, imgrows)
+// Euclidean distance of every object pixel (not 0) to the nearest background pixel (0), see distanceTransform().
+// Inputs: imgdata -> grayscale image, see wrapBasicImagePython
+//         imgcols -> image col count
+//         imgrows -> image row count
+// Returns: bytearray of cols * rows native floats (eg. numpy.frombuffer(result, numpy.float32))
+static PyObject *distance_transform(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "imgcols", "imgrows", NULL};
+    PyObject *imgdata;
+    int32_t imgrows;
+    int32_t imgcols;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "Oii", kwlist, &imgdata, &imgcols, &imgrows)) { return NULL; }
+
+    Py_buffer view;
+    image_t src;
+    if(wrapBasicImagePython(imgdata, &view, &src, imgcols, imgrows) < 0) { return NULL; }
+    PyObject *out = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t) imgcols * imgrows * sizeof(float_pixel_t));
+    watershedworkspace_t *ws = newWatershedWorkspace(imgcols, imgrows);
+    if(out == NULL || ws == NULL) {
+        if(out != NULL) { PyErr_NoMemory(); }
+        Py_XDECREF(out);
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    image_t dst = {imgcols, imgrows, IMGVIEW_CLIP, IMGTYPE_FLOAT, (uint8_t *) PyByteArray_AS_STRING(out), imgcols};
+    int ok;
+    Py_BEGIN_ALLOW_THREADS
+    ok = distanceTransform(&src, &dst, ws);
+    Py_END_ALLOW_THREADS
+
+    // Cleanup
+    deleteWatershedWorkspace(ws);
+    PyBuffer_Release(&view);
+    if(!ok) {
+        Py_DECREF(out);
+        PyErr_SetString(PyExc_RuntimeError, "distance transform failed");
+        return NULL;
+    }
+    return out;
+}
+
+// watershed(imgdata, imgcols, imgrows, minh, maxh, connectivity=8)
+// Watershed transformation with the regions of pixels up to minh as markers, see waterShedFast().
+// Inputs: imgdata -> grayscale image, see wrapBasicImagePython
+//         imgcols -> image col count
+//         imgrows -> image row count
+//         minh -> the markers are the connected regions of pixels up to this level
+//         maxh -> maximum level that is flooded
+//         connectivity -> 4 or 8 connected neighbours
+// Returns: (labels, n) tuple: bytearray of cols * rows native int16 labels (0 for the watershed lines and the pixels
+//          that are not flooded), and the number of basins
+static PyObject *watershed(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "imgcols", "imgrows", "minh", "maxh", "connectivity", NULL};
+    PyObject *imgdata;
+    int32_t imgrows;
+    int32_t imgcols;
+    int minh;
+    int maxh;
+    int connectivity = 8;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "Oiiii|i", kwlist, &imgdata, &imgcols, &imgrows, &minh, &maxh,
+                                    &connectivity)) { return NULL; }
+    if(minh < 0 || minh > 255 || maxh < 0 || maxh > 255 || (connectivity != 4 && connectivity != 8)) {
+        PyErr_SetString(PyExc_ValueError, "minh and maxh must be 0..255 and connectivity 4 or 8");
+        return NULL;
+    }
+
+    Py_buffer view;
+    image_t src;
+    if(wrapBasicImagePython(imgdata, &view, &src, imgcols, imgrows) < 0) { return NULL; }
+    PyObject *out = PyByteArray_FromStringAndSize(NULL, (Py_ssize_t) imgcols * imgrows * sizeof(int16_pixel_t));
+    watershedworkspace_t *ws = newWatershedWorkspace(imgcols, imgrows);
+    if(out == NULL || ws == NULL) {
+        if(out != NULL) { PyErr_NoMemory(); }
+        Py_XDECREF(out);
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    image_t dst = {imgcols, imgrows, IMGVIEW_LABELED, IMGTYPE_INT16, (uint8_t *) PyByteArray_AS_STRING(out), imgcols};
+    uint32_t n;
+    Py_BEGIN_ALLOW_THREADS
+    n = waterShedFast(&src, &dst, connectivity == 4 ? FOUR : EIGHT, (basic_pixel_t) minh, (basic_pixel_t) maxh, ws);
+    Py_END_ALLOW_THREADS
+
+    // Cleanup
+    deleteWatershedWorkspace(ws);
+    PyBuffer_Release(&view);
+    return Py_BuildValue("NI", out, n);
+}
+
+// _check_binary_views()
+// Self check of the IMGTYPE_BINARY views for test_wormvision.py, python can not create binary images: a word aligned
+// view of a binary image is only contiguous if it has all words of its rows, and it is copied pixel by pixel.
+// Returns: None, raises AssertionError if a check fails
+static PyObject *check_binary_views(PyObject *self, PyObject *args) {
+    image_t *img = newBinaryImage(150, 6);
+    image_t *copy = newBinaryImage(86, 4);
+    image_t view;
+    image_t rows_view;
+    const char *failed = NULL;
+    int32_t row;
+    int32_t col;
+    if(img == NULL || copy == NULL) {
+        if(img != NULL) { deleteBinaryImage(img); }
+        if(copy != NULL) { deleteBinaryImage(copy); }
+        return PyErr_NoMemory();
+    }
+    for(row = 0; row < img->rows; row++) {
+        for(col = 0; col < img->cols; col++) {
+            if((col * 7 + row * 3) % 5 < 2) {
+                BINARY_ROW(img, row)[col / BINARY_WORD_BITS] |= (binary_word_t) 1 << (col % BINARY_WORD_BITS);
+            }
+        }
+    }
+    subImage(img, &view, 64, 1, 86, 4);
+    subImage(img, &rows_view, 0, 2, 150, 3);
+    if(!IMG_IS_CONTIGUOUS(img) || !IMG_IS_CONTIGUOUS(&rows_view) || !IMG_IS_CONTIGUOUS(copy)) {
+        failed = "a binary image with all words of its rows is not contiguous";
+    } else if(IMG_IS_CONTIGUOUS(&view)) {
+        failed = "a binary view of part of the words of its rows is contiguous";
+    } else {
+        copy_binary(&view, copy);
+        for(row = 0; row < copy->rows && failed == NULL; row++) {
+            for(col = 0; col < copy->cols; col++) {
+                if(BINARY_PIXEL(copy, col, row) != BINARY_PIXEL(img, col + 64, row + 1)) {
+                    failed = "copy_binary() of a binary view differs from the image";
+                    break;
+                }
+            }
+        }
+    }
+    deleteBinaryImage(img);
+    deleteBinaryImage(copy);
+    if(failed != NULL) {
+        PyErr_SetString(PyExc_AssertionError, failed);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// ----------------------------------------------------------------------------
+// wormvision.FrameRing and wormvision.Frame types
+// ----------------------------------------------------------------------------
+
+// Ring buffer of preallocated grayscale frames between the camera thread and the controller: the camera pushes every
+// frame into a free slot, the controller takes the newest frame and evaluates it while the next frames are pushed
+// into the other slots. A frame is read directly from its slot, the slot is not overwritten until the Frame (and
+// every numpy array or memoryview of it) is garbage collected.
+typedef struct {
+    PyObject_HEAD
+    framering_t *ring;
+} FrameRingObject;
+
+// Frame taken from a FrameRing, a read only 2d rows x cols buffer (numpy.asarray(frame) does not copy)
+typedef struct {
+    PyObject_HEAD
+    FrameRingObject *ring;   // NULL if the frame was not created by FrameRing.latest()
+    int32_t slot;
+    uint64_t seq;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} FrameObject;
+
+static PyObject *frame_type = NULL;
+
+// FrameRing(imgcols, imgrows, slots=3), grayscale frames of imgcols x imgrows pixels. One slot is written, one holds
+// the newest frame, the others can be held by Frame objects; add a slot for every frame that is kept while a newer
+// frame is taken.
+static int FrameRing_init(FrameRingObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgcols", "imgrows", "slots", NULL};
+    int32_t imgrows;
+    int32_t imgcols;
+    int32_t nof_slots = 3;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "ii|i", kwlist, &imgcols, &imgrows, &nof_slots)) { return -1; }
+    if(imgcols <= 0 || imgrows <= 0) {
+        PyErr_SetString(PyExc_ValueError, "image size must be positive");
+        return -1;
+    }
+    if(nof_slots < 3 || nof_slots > FRAMERING_MAX_SLOTS) {
+        PyErr_Format(PyExc_ValueError, "slots must be 3 to %d", FRAMERING_MAX_SLOTS);
+        return -1;
+    }
+    // frames of the old ring can still be read or written
+    if(self->ring != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameRing is already initialised");
+        return -1;
+    }
+    self->ring = newFrameRing(imgcols, imgrows, (uint32_t) nof_slots);
+    if(self->ring == NULL) { PyErr_NoMemory(); return -1; }
+    return 0;
+}
+
+static void FrameRing_dealloc(FrameRingObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    deleteFrameRing(self->ring);
+    freefunc tp_free = (freefunc) PyType_GetSlot(type, Py_tp_free);
+    tp_free(self);
+    Py_DECREF(type);
+}
+
+// FrameRing.push(imgdata, format='bgr'), called by the camera thread for every frame
+// Inputs: imgdata -> frame in the given format, see to_gray
+//         format -> see to_gray
+// Returns: the sequence number of the frame, or None if it was dropped because all other slots are held
+static PyObject *FrameRing_push(FrameRingObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"imgdata", "format", NULL};
+    PyObject *imgdata;
+    const char *format_name = "bgr";
+    eFrameFormat format;
+    if(self->ring == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameRing is not initialised");
+        return NULL;
+    }
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O|z", kwlist, &imgdata, &format_name)) { return NULL; }
+    if(parseFormatPython(format_name, &format) < 0) { return NULL; }
+
+    Py_buffer view;
+    image_t frame;
+    if(wrapCameraFramePython(imgdata, &view, &frame, self->ring->cols, self->ring->rows, format) < 0) {
+        return NULL;
+    }
+    image_t *slot = frameRingBeginWrite(self->ring);
+    if(slot == NULL) {
+        PyBuffer_Release(&view);
+        Py_RETURN_NONE;
+    }
+    uint64_t seq;
+    Py_BEGIN_ALLOW_THREADS
+    cameraFrameToGray(&frame, slot, format);
+    seq = frameRingEndWrite(self->ring);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    return PyLong_FromUnsignedLongLong(seq);
+}
+
+// FrameRing.latest(after=0, timeout=None)
+// Inputs: after -> sequence number, only a newer frame is returned, eg. FrameRing.seq() for a frame that is captured
+//                  after the call
+//         timeout -> seconds to wait for a newer frame, None waits forever. The GIL is released while waiting.
+// Returns: the newest wormvision.Frame, or None on a timeout
+static PyObject *FrameRing_latest(FrameRingObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"after", "timeout", NULL};
+    unsigned long long after = 0;
+    PyObject *timeout_obj = Py_None;
+    int32_t timeout_ms = -1;
+    if(self->ring == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameRing is not initialised");
+        return NULL;
+    }
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|KO", kwlist, &after, &timeout_obj)) { return NULL; }
+    if(timeout_obj != Py_None) {
+        double timeout = PyFloat_AsDouble(timeout_obj);
+        if(PyErr_Occurred()) { return NULL; }
+        if(timeout < 0.0 || timeout > 86400.0) {
+            PyErr_SetString(PyExc_ValueError, "timeout must be None or 0 to 86400 seconds");
+            return NULL;
+        }
+        timeout_ms = (int32_t) (timeout * 1000.0);
+    }
+
+    FrameObject *frame = PyObject_New(FrameObject, (PyTypeObject *) frame_type);
+    if(frame == NULL) { return NULL; }
+    frame->ring = NULL;
+    uint64_t seq = 0;
+    int32_t slot;
+    Py_BEGIN_ALLOW_THREADS
+    slot = frameRingAcquire(self->ring, (uint64_t) after, timeout_ms, &seq);
+    Py_END_ALLOW_THREADS
+    if(slot < 0) {
+        Py_DECREF(frame);
+        Py_RETURN_NONE;
+    }
+    Py_INCREF(self);
+    frame->ring = self;
+    frame->slot = slot;
+    frame->seq = seq;
+    frame->shape[0] = self->ring->rows;
+    frame->shape[1] = self->ring->cols;
+    frame->strides[0] = self->ring->slots[slot]->stride;
+    frame->strides[1] = 1;
+    return (PyObject *) frame;
+}
+
+// FrameRing.seq()
+// Returns: sequence number of the newest frame, 0 before the first frame
+static PyObject *FrameRing_seq(FrameRingObject *self, PyObject *args) {
+    if(self->ring == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameRing is not initialised");
+        return NULL;
+    }
+    acquireLock(self->ring->lock);
+    uint64_t seq = self->ring->newest;
+    releaseLock(self->ring->lock);
+    return PyLong_FromUnsignedLongLong(seq);
+}
+
+// FrameRing.stats()
+// Returns: (frames, dropped) tuple, the number of frames that were pushed and dropped
+static PyObject *FrameRing_stats(FrameRingObject *self, PyObject *args) {
+    if(self->ring == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameRing is not initialised");
+        return NULL;
+    }
+    acquireLock(self->ring->lock);
+    uint64_t frames = self->ring->newest;
+    uint64_t dropped = self->ring->dropped;
+    releaseLock(self->ring->lock);
+    return Py_BuildValue("(KK)", (unsigned long long) frames, (unsigned long long) dropped);
+}
+
+static PyMethodDef FrameRing_methods[] = {
+    {"push", (PyCFunction) FrameRing_push, METH_VARARGS | METH_KEYWORDS,
+     "Convert a camera frame to grayscale into a free slot, returns its sequence number or None if it was dropped."},
+    {"latest", (PyCFunction) FrameRing_latest, METH_VARARGS | METH_KEYWORDS,
+     "Newest frame with a sequence number larger than after, waits at most timeout seconds (None: forever)."},
+    {"seq", (PyCFunction) FrameRing_seq, METH_NOARGS, "Sequence number of the newest frame, 0 before the first frame."},
+    {"stats", (PyCFunction) FrameRing_stats, METH_NOARGS,
+     "Number of frames that were pushed and dropped, (frames, dropped) tuple."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot FrameRing_slots[] = {
+    {Py_tp_doc, "Ring buffer of preallocated grayscale frames between the camera thread and the controller."},
+    {Py_tp_new, PyType_GenericNew},
+    {Py_tp_init, FrameRing_init},
+    {Py_tp_dealloc, FrameRing_dealloc},
+    {Py_tp_methods, FrameRing_methods},
+    {0, NULL}
+};
+
+static PyType_Spec FrameRing_spec = {
+    "wormvision.FrameRing",
+    sizeof(FrameRingObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    FrameRing_slots
+};
+
+// Release the slot of the frame
+static void Frame_dealloc(FrameObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    if(self->ring != NULL) {
+        frameRingRelease(self->ring->ring, self->slot);
+        Py_DECREF(self->ring);
+    }
+    freefunc tp_free = (freefunc) PyType_GetSlot(type, Py_tp_free);
+    tp_free(self);
+    Py_DECREF(type);
+}
+
+// Buffer protocol, the pixels of the slot as a read only rows x cols buffer of unsigned bytes
+static int Frame_getbuffer(FrameObject *self, Py_buffer *view, int flags) {
+    if(self->ring == NULL) {
+        PyErr_SetString(PyExc_BufferError, "Frame is not taken from a FrameRing");
+        return -1;
+    }
+    if(flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Frame is read only");
+        return -1;
+    }
+    view->buf = self->ring->ring->slots[self->slot]->data;
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->shape[1];
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+// Frame.seq
+static PyObject *Frame_seq(FrameObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(self->ring != NULL ? self->seq : 0);
+}
+
+static PyGetSetDef Frame_getset[] = {
+    {"seq", (getter) Frame_seq, NULL, "Sequence number of the frame in its FrameRing.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyType_Slot Frame_slots[] = {
+    {Py_tp_doc, "Grayscale frame taken from a FrameRing, read through the buffer protocol (numpy.asarray(frame))."},
+    {Py_tp_dealloc, Frame_dealloc},
+    {Py_tp_getset, Frame_getset},
+    {Py_bf_getbuffer, Frame_getbuffer},
+    {0, NULL}
+};
+
+static PyType_Spec Frame_spec = {
+    "wormvision.Frame",
+    sizeof(FrameObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    Frame_slots
+};
+
+// ----------------------------------------------------------------------------
+// wormvision.FrameArchive type
+// ----------------------------------------------------------------------------
+
+// Raw frame archive of a logged run (see framearchive.h and frame_archive.py), mapped read only. The frames are a
+// read only frames x rows x cols buffer into the mapping: numpy.asarray(archive) and evaluate_batch(archive, ...) do
+// not copy the pixels. The mapping is kept until the archive and every view of it are garbage collected.
+typedef struct {
+    PyObject_HEAD
+    framearchive_t *archive;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+} FrameArchiveObject;
+
+// FrameArchive(path), frames that are appended later are not seen, open the archive again to read them
+static int FrameArchive_init(FrameArchiveObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"path", NULL};
+    PyObject *path;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "O&", kwlist, PyUnicode_FSConverter, &path)) { return -1; }
+    if(self->archive != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "FrameArchive is already open");
+        Py_DECREF(path);
+        return -1;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    self->archive = openFrameArchive(PyBytes_AsString(path));
+    Py_END_ALLOW_THREADS
+    if(self->archive == NULL) {
+        PyErr_Format(PyExc_OSError, "%s is not a frame archive or can not be mapped", PyBytes_AsString(path));
+        Py_DECREF(path);
+        return -1;
+    }
+    Py_DECREF(path);
+    if(self->archive->type != IMGTYPE_BASIC) {
+        PyErr_SetString(PyExc_ValueError, "only archives of grayscale frames are supported");
+        closeFrameArchive(self->archive);
+        self->archive = NULL;
+        return -1;
+    }
+    self->shape[0] = self->archive->nof_frames;
+    self->shape[1] = self->archive->rows;
+    self->shape[2] = self->archive->cols;
+    self->strides[0] = self->archive->record_size;
+    self->strides[1] = self->archive->cols;
+    self->strides[2] = 1;
+    return 0;
+}
+
+static void FrameArchive_dealloc(FrameArchiveObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    closeFrameArchive(self->archive);
+    freefunc tp_free = (freefunc) PyType_GetSlot(type, Py_tp_free);
+    tp_free(self);
+    Py_DECREF(type);
+}
+
+// Buffer protocol, the frames as a read only frames x rows x cols buffer of unsigned bytes
+static int FrameArchive_getbuffer(FrameArchiveObject *self, Py_buffer *view, int flags) {
+    if(self->archive == NULL) {
+        PyErr_SetString(PyExc_BufferError, "FrameArchive is not open");
+        return -1;
+    }
+    if(flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "FrameArchive is read only");
+        return -1;
+    }
+    if((flags & PyBUF_STRIDES) != PyBUF_STRIDES && self->shape[0] > 1) {
+        PyErr_SetString(PyExc_BufferError, "FrameArchive frames are padded, request a strided buffer");
+        return -1;
+    }
+    view->buf = (void *) (self->archive->map + FRAMEARCHIVE_HEADER_SIZE + FRAMEARCHIVE_META_SIZE);
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->len = self->shape[0] * self->shape[1] * self->shape[2];
+    view->readonly = 1;
+    view->itemsize = 1;
+    view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+    view->ndim = 3;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
 
-    // Return tuple (offset_x, offset_y)
-    PyObject *offset_tuple = PyTuple_New(2);
-    PyTuple_SetItem(offset_tuple, 0, PyLong_FromLong(offset_x));
-    PyTuple_SetItem(offset_tuple, 1, PyLong_FromLong(offset_y));
-    return offset_tuple;
+static Py_ssize_t FrameArchive_len(FrameArchiveObject *self) {
+    return self->archive != NULL ? (Py_ssize_t) self->archive->nof_frames : 0;
+}
+
+// FrameArchive.meta(i)
+// Returns: (timestamp, (setpoint_x, setpoint_y), (target_x, target_y), (offset_x, offset_y), (offset_x_mm,
+//          offset_y_mm), passed) of frame i, the timestamp in seconds since the epoch and the offsets the total
+//          weighted offset of the evaluators
+static PyObject *FrameArchive_meta(FrameArchiveObject *self, PyObject *args) {
+    Py_ssize_t i;
+    if(!PyArg_ParseTuple(args, "n", &i)) { return NULL; }
+    const framearchive_meta_t *meta = NULL;
+    if(self->archive != NULL && i >= 0 && i < (Py_ssize_t) self->archive->nof_frames) {
+        meta = frameArchiveMeta(self->archive, (uint32_t) i);
+    }
+    if(meta == NULL) {
+        PyErr_SetString(PyExc_IndexError, "frame index out of range");
+        return NULL;
+    }
+    return Py_BuildValue("d(dd)(ii)(dd)(dd)O", meta->timestamp, (double) meta->setpoint[0],
+                         (double) meta->setpoint[1], meta->target[0], meta->target[1], (double) meta->offset[0],
+                         (double) meta->offset[1], (double) meta->offset_mm[0], (double) meta->offset_mm[1],
+                         meta->passed ? Py_True : Py_False);
+}
+
+static PyMethodDef FrameArchive_methods[] = {
+    {"meta", (PyCFunction) FrameArchive_meta, METH_VARARGS,
+     "Metadata of frame i: (timestamp, setpoint, target, offset, offset_mm, passed)."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyType_Slot FrameArchive_slots[] = {
+    {Py_tp_doc, "Memory mapped raw frame archive of a logged run, the frames are read through the buffer protocol."},
+    {Py_tp_new, PyType_GenericNew},
+    {Py_tp_init, FrameArchive_init},
+    {Py_tp_dealloc, FrameArchive_dealloc},
+    {Py_tp_methods, FrameArchive_methods},
+    {Py_sq_length, FrameArchive_len},
+    {Py_bf_getbuffer, FrameArchive_getbuffer},
+    {0, NULL}
+};
+
+static PyType_Spec FrameArchive_spec = {
+    "wormvision.FrameArchive",
+    sizeof(FrameArchiveObject),
+    0,
+    Py_TPFLAGS_DEFAULT,
+    FrameArchive_slots
+};
+
+// set_threads(n)
+// Inputs: n -> number of threads for the neighbourhood operators (convolution, nonlinear filters, morphology, edge
+//              detection), 1 runs everything in the calling thread
+// Returns: the number of threads that is used
+static PyObject *set_threads(PyObject *self, PyObject *args) {
+    int nof_threads;
+    if(!PyArg_ParseTuple(args, "i", &nof_threads)) { return NULL; }
+    if(nof_threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "thread count must be at least 1");
+        return NULL;
+    }
+    uint32_t n;
+    Py_BEGIN_ALLOW_THREADS
+    n = setThreadCount((uint32_t) nof_threads);
+    Py_END_ALLOW_THREADS
+    return PyLong_FromUnsignedLong(n);
+}
+
+static PyObject *get_threads(PyObject *self, PyObject *args) {
+    return PyLong_FromUnsignedLong(getThreadCount());
 }
 
 static PyMethodDef functions[] = {
     {"WBFE_evaluate", WBFE_evaluate, METH_VARARGS, "Vision algorithm implementation for the well bottom features evaluator."},
+    {"WBFE_evaluate_buffer", (PyCFunction) WBFE_evaluate_buffer, METH_VARARGS | METH_KEYWORDS,
+     "Well bottom features evaluator that reads the frame through the buffer protocol (numpy array, bytes, memoryview)."},
+    {"evaluate_batch", (PyCFunction) evaluate_batch, METH_VARARGS | METH_KEYWORDS,
+     "Evaluate a stack of frames with every combination of a grid of well bottom features parameters."},
+    {"HT_evaluate", (PyCFunction) HT_evaluate, METH_VARARGS | METH_KEYWORDS,
+     "Hough transform evaluator that reads the frame through the buffer protocol (numpy array, bytes, memoryview)."},
+    {"to_gray", (PyCFunction) to_gray, METH_VARARGS | METH_KEYWORDS,
+     "Convert an rgb, bgr or yuv420 camera frame to a grayscale frame for the evaluators."},
+    {"distance_transform", (PyCFunction) distance_transform, METH_VARARGS | METH_KEYWORDS,
+     "Euclidean distance of every object pixel to the nearest background pixel, as native floats."},
+    {"watershed", (PyCFunction) watershed, METH_VARARGS | METH_KEYWORDS,
+     "Watershed transformation flooded from the regions up to minh, returns (int16 labels, number of basins)."},
+    {"_check_binary_views", check_binary_views, METH_NOARGS, "Self check of the binary image views for the tests."},
+    {"set_threads", set_threads, METH_VARARGS,
+     "Set the number of threads of the neighbourhood operators, returns the number of threads that is used."},
+    {"get_threads", get_threads, METH_NOARGS, "Number of threads of the neighbourhood operators."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -151,5 +1655,69 @@ static struct PyModuleDef wormvision = {
 };
 
 PyMODINIT_FUNC PyInit_wormvision(void) {
-    return PyModule_Create(&wormvision);
+    PyObject *module = PyModule_Create(&wormvision);
+    if(module == NULL) { return NULL; }
+
+    // Thread pool of the neighbourhood operators, one thread per core unless WORMVISION_THREADS is set
+    const char *threads_env = getenv("WORMVISION_THREADS");
+    int nof_threads = threads_env != NULL ? atoi(threads_env) : (int) processorCount();
+    setThreadCount(nof_threads > 0 ? (uint32_t) nof_threads : 1);
+
+    // Names of the timed pipeline stages, in pipeline order
+    PyObject *stages = PyTuple_New(WBFE_NOF_STAGES);
+    if(stages == NULL) { Py_DECREF(module); return NULL; }
+    for(int32_t i = 0; i < WBFE_NOF_STAGES; i++) {
+        PyTuple_SetItem(stages, i, PyUnicode_FromString(WBFE_stageName(i)));
+    }
+    if(PyErr_Occurred() || PyModule_AddObject(module, "WBFE_STAGES", stages) < 0) {
+        Py_DECREF(stages);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    PyObject *evaluator_type = PyType_FromSpec(&Evaluator_spec);
+    if(evaluator_type == NULL || PyModule_AddObject(module, "Evaluator", evaluator_type) < 0) {
+        Py_XDECREF(evaluator_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    // the module keeps a reference for the type checks of the cache arguments
+    frame_cache_type = PyType_FromSpec(&FrameCache_spec);
+    if(frame_cache_type == NULL) { Py_DECREF(module); return NULL; }
+    Py_INCREF(frame_cache_type);
+    if(PyModule_AddObject(module, "FrameCache", frame_cache_type) < 0) {
+        Py_DECREF(frame_cache_type);
+        Py_DECREF(frame_cache_type);
+        frame_cache_type = NULL;
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    PyObject *frame_ring_type = PyType_FromSpec(&FrameRing_spec);
+    if(frame_ring_type == NULL || PyModule_AddObject(module, "FrameRing", frame_ring_type) < 0) {
+        Py_XDECREF(frame_ring_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    PyObject *frame_archive_type = PyType_FromSpec(&FrameArchive_spec);
+    if(frame_archive_type == NULL || PyModule_AddObject(module, "FrameArchive", frame_archive_type) < 0) {
+        Py_XDECREF(frame_archive_type);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    // the module keeps a reference to create the frames of FrameRing.latest()
+    frame_type = PyType_FromSpec(&Frame_spec);
+    if(frame_type == NULL) { Py_DECREF(module); return NULL; }
+    Py_INCREF(frame_type);
+    if(PyModule_AddObject(module, "Frame", frame_type) < 0) {
+        Py_DECREF(frame_type);
+        Py_DECREF(frame_type);
+        frame_type = NULL;
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
 }